@@ -24,21 +24,98 @@
 
 #include "docwordscompletion-plugin.h"
 
+#include <string.h>
+#include <time.h>
 #include <gdk/gdk.h>
 #include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
 #include <gedit/gedit-debug.h>
 #include <gconf/gconf-client.h>
 #include <gtksourcecompletion/gsc-completion.h>
 #include "gsc-provider-words.h"
+#include "gsc-provider-quickopen.h"
+#include "gsc-geditopendoc-provider.h"
+#include "gsc-geditrecent-provider.h"
+#include "gsc-words-index.h"
+#include "gsc-words-project.h"
+#include "gsc-project-crawler.h"
 
 #define WINDOW_DATA_KEY	"DocwordscompletionPluginWindowData"
+#define VIEW_DATA_KEY	"DocwordscompletionPluginViewData"
+#define SCHEDULER_DATA_KEY	"DocwordscompletionPluginScheduler"
+#define WORDS_DATA_KEY		"DocwordscompletionPluginWords"
+#define QUICKOPEN_DATA_KEY	"DocwordscompletionPluginQuickopen"
+#define OPENDOC_DATA_KEY	"DocwordscompletionPluginOpendoc"
+#define RECENT_DATA_KEY		"DocwordscompletionPluginRecent"
+
+/* State of a view, stored in VIEW_DATA_KEY */
+#define VIEW_WAITING GINT_TO_POINTER (1)
+#define VIEW_ATTACHED GINT_TO_POINTER (2)
+
+/* Proposals shown when they are sorted by proximity or frequency */
+#define RANKED_MAX_PROPOSALS 50
+
+/* Lines around the cursor indexed before the rest of a document */
+#define WARM_LINES 100
+
+/* Limits of the autocompletion delay, in milliseconds */
+#define MIN_AC_DELAY 50
+#define MAX_AC_DELAY 1000
+
+/* A keystroke this long (ms) after the previous one ends a typing burst */
+#define TYPING_PAUSE 1000
+
+/* Default memory for the words of all the documents, in MB */
+#define MEMORY_BUDGET 256
+
+/* Default number of recent files proposed */
+#define MAX_RECENT 10
+
+/* Defaults of the index of the words of the project files: MB, threads
+   reading the files and files read */
+#define PROJECT_MEMORY_BUDGET 64
+#define PROJECT_THREADS 1
+#define PROJECT_MAX_FILES 20000
+
+/* Seconds between two checks of the memory used by the indexes */
+#define MEMORY_CHECK_INTERVAL 5
+
+/* Seconds without focus before the words of a document are compressed */
+#define FREEZE_DELAY 300
+
+/* Where the words of the documents are saved, under the user cache
+   directory */
+#define CACHE_DIR "gedit" G_DIR_SEPARATOR_S "docwordscompletion"
+#define CACHE_SUFFIX ".words"
+
+/* The saved words not used for this many seconds are removed, and the
+   least recently used ones while they take more than this many bytes */
+#define CACHE_MAX_AGE (30 * 24 * 60 * 60)
+#define CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+/* A temporary file of g_file_set_contents not renamed after this many
+   seconds was left by a crash */
+#define CACHE_TMP_AGE (60 * 60)
+
+/* Linux pressure stall information. Above these percentages of time
+   waiting for memory the budget is halved or quartered. */
+#define PSI_MEMORY_FILE "/proc/pressure/memory"
+#define PSI_LOW 1.0
+#define PSI_HIGH 10.0
 
 #define GCONF_BASE_KEY "/apps/gedit-2/plugins/docwordscompletion"
 #define GCONF_AUTOCOMPLETION_ENABLED GCONF_BASE_KEY "/enable_autocompletion"
 #define GCONF_OPEN_ENABLED GCONF_BASE_KEY "/enable_open_documents"
 #define GCONF_RECENT_ENABLED GCONF_BASE_KEY "/enable_recent_documents"
+#define GCONF_MAX_RECENT GCONF_BASE_KEY "/max_recent_documents"
 #define GCONF_AUTOSELECT_ENABLED GCONF_BASE_KEY "/enable_autoselect_documents"
+#define GCONF_QUICK_OPEN_ENABLED GCONF_BASE_KEY "/enable_quick_open"
 #define GCONF_AUTOCOMPLETION_DELAY GCONF_BASE_KEY "/autocompletion_delay"
+#define GCONF_MEMORY_BUDGET GCONF_BASE_KEY "/memory_budget"
+#define GCONF_PROJECT_ENABLED GCONF_BASE_KEY "/enable_project_words"
+#define GCONF_PROJECT_MEMORY_BUDGET GCONF_BASE_KEY "/project_memory_budget"
+#define GCONF_PROJECT_THREADS GCONF_BASE_KEY "/project_threads"
+#define GCONF_PROJECT_MAX_FILES GCONF_BASE_KEY "/project_max_files"
 #define GCONF_USER_REQUEST_EVENT_KEYS GCONF_BASE_KEY "/user_request_event_keys"
 #define GCONF_OPEN_DOCUMENTS_EVENT_KEYS GCONF_BASE_KEY "/open_documents_event_keys"
 #define GCONF_SHOW_INFO_KEYS GCONF_BASE_KEY "/show_info_keys"
@@ -51,7 +128,14 @@ struct _ConfData
 	gboolean open_enabled;
 	gboolean recent_enabled;
 	gboolean autoselect_enabled;
+	gboolean quick_open_enabled;
+	gboolean project_enabled;
+	guint max_recent;
 	guint ac_delay;
+	guint memory_budget;
+	guint project_memory_budget;
+	guint project_threads;
+	guint project_max_files;
 	gchar* ure_keys;
 	gchar* od_keys;
 	gchar* si_keys;
@@ -66,22 +150,71 @@ struct _DocwordscompletionPluginPrivate
 	GtkWidget *check_auto;
 	GConfClient *gconf_cli;
 	ConfData *conf;
+	GThreadPool *scan_pool;
+	/* Buffers to index when gedit is idle */
+	GQueue *pending_buffers;
+	guint index_idle_id;
+	guint memory_check_id;
+	/* The words of the files of the project of the focused document */
+	GscWordsProject *project;
+	/* Directory of the focused document when the project was looked
+	   for, and the project found */
+	gchar *project_dir;
+	gchar *project_root;
+	/* GeditDocument -> its file, whose words are not counted in the
+	   project */
+	GHashTable *open_files;
 };
 
 typedef struct _ViewAndCompletion ViewAndCompletion;
 
+static gboolean memory_check_cb (DocwordscompletionPlugin *dw_plugin);
+static gboolean prune_cache_idle (gpointer data);
+
+/*
+ * Adapts the autocompletion delay of a view to the typing pace and to the
+ * time the provider takes
+ */
+typedef struct
+{
+	GscCompletion *completion;
+	GscProviderWords *provider;
+	/* The configured delay */
+	guint base_delay;
+	guint delay;
+	/* Moving mean of the time between keystrokes, in ms */
+	guint key_interval;
+	gint64 last_key;
+} Scheduler;
+
 GEDIT_PLUGIN_REGISTER_TYPE (DocwordscompletionPlugin, docwordscompletion_plugin)
 
 static void
 docwordscompletion_plugin_init (DocwordscompletionPlugin *plugin)
 {
 	plugin->priv = DOCWORDSCOMPLETION_PLUGIN_GET_PRIVATE (plugin);
+	
+	/* Scans the big documents out of the main loop, one thread per CPU */
+	plugin->priv->scan_pool = gsc_words_index_pool_new (0);
+	plugin->priv->pending_buffers = g_queue_new ();
+	plugin->priv->open_files = g_hash_table_new_full (g_direct_hash,
+							  g_direct_equal,
+							  NULL,
+							  g_free);
+	
 	plugin->priv->gconf_cli = gconf_client_get_default ();
 	plugin->priv->conf = g_malloc0(sizeof(ConfData));
 	plugin->priv->conf->ac_enabled = TRUE;
 	plugin->priv->conf->open_enabled = TRUE;
 	plugin->priv->conf->recent_enabled = TRUE;
+	plugin->priv->conf->quick_open_enabled = TRUE;
+	plugin->priv->conf->project_enabled = TRUE;
+	plugin->priv->conf->max_recent = MAX_RECENT;
 	plugin->priv->conf->ac_delay = 300;
+	plugin->priv->conf->memory_budget = MEMORY_BUDGET;
+	plugin->priv->conf->project_memory_budget = PROJECT_MEMORY_BUDGET;
+	plugin->priv->conf->project_threads = PROJECT_THREADS;
+	plugin->priv->conf->project_max_files = PROJECT_MAX_FILES;
 	plugin->priv->conf->ure_keys = g_strdup("<Control>Return");
 	plugin->priv->conf->od_keys = g_strdup("<Control>d");
 	plugin->priv->conf->si_keys = g_strdup("<Control>i");
@@ -107,19 +240,76 @@ docwordscompletion_plugin_init (DocwordscompletionPlugin *plugin)
 		gconf_value_free(value);
 	}
 	
+	value = gconf_client_get(plugin->priv->gconf_cli,GCONF_MAX_RECENT,NULL);
+	if (value!=NULL)
+	{
+		plugin->priv->conf->max_recent = gconf_value_get_int(value);
+		gconf_value_free(value);
+	}
+	
 	value = gconf_client_get(plugin->priv->gconf_cli,GCONF_AUTOSELECT_ENABLED,NULL);
 	if (value!=NULL)
 	{
 		plugin->priv->conf->autoselect_enabled =  gconf_value_get_bool(value);
 		gconf_value_free(value);
 	}
+	
+	value = gconf_client_get(plugin->priv->gconf_cli,GCONF_QUICK_OPEN_ENABLED,NULL);
+	if (value!=NULL)
+	{
+		plugin->priv->conf->quick_open_enabled =  gconf_value_get_bool(value);
+		gconf_value_free(value);
+	}
 
+	value = gconf_client_get(plugin->priv->gconf_cli,GCONF_PROJECT_ENABLED,NULL);
+	if (value!=NULL)
+	{
+		plugin->priv->conf->project_enabled =  gconf_value_get_bool(value);
+		gconf_value_free(value);
+	}
+	
 	value = gconf_client_get(plugin->priv->gconf_cli,GCONF_AUTOCOMPLETION_DELAY,NULL);
 	if (value!=NULL)
 	{
 		plugin->priv->conf->ac_delay = gconf_value_get_int(value);
 		gconf_value_free(value);
 	}
+
+	value = gconf_client_get(plugin->priv->gconf_cli,GCONF_MEMORY_BUDGET,NULL);
+	if (value!=NULL)
+	{
+		plugin->priv->conf->memory_budget = gconf_value_get_int(value);
+		gconf_value_free(value);
+	}
+
+	value = gconf_client_get(plugin->priv->gconf_cli,GCONF_PROJECT_MEMORY_BUDGET,NULL);
+	if (value!=NULL)
+	{
+		plugin->priv->conf->project_memory_budget = gconf_value_get_int(value);
+		gconf_value_free(value);
+	}
+
+	value = gconf_client_get(plugin->priv->gconf_cli,GCONF_PROJECT_THREADS,NULL);
+	if (value!=NULL)
+	{
+		plugin->priv->conf->project_threads = gconf_value_get_int(value);
+		gconf_value_free(value);
+	}
+
+	value = gconf_client_get(plugin->priv->gconf_cli,GCONF_PROJECT_MAX_FILES,NULL);
+	if (value!=NULL)
+	{
+		plugin->priv->conf->project_max_files = gconf_value_get_int(value);
+		gconf_value_free(value);
+	}
+
+	plugin->priv->memory_check_id =
+		g_timeout_add_seconds (MEMORY_CHECK_INTERVAL,
+				       (GSourceFunc) memory_check_cb,
+				       plugin);
+
+	/* Once gedit has started */
+	g_idle_add_full (G_PRIORITY_LOW, (GSourceFunc) prune_cache_idle, NULL, NULL);
 	
 	value = gconf_client_get(plugin->priv->gconf_cli,GCONF_USER_REQUEST_EVENT_KEYS,NULL);
 	if (value!=NULL)
@@ -152,6 +342,20 @@ docwordscompletion_plugin_finalize (GObject *object)
 	gedit_debug_message (DEBUG_PLUGINS,
 			     "DocwordscompletionPlugin finalizing");
 	DocwordscompletionPlugin * dw_plugin = (DocwordscompletionPlugin*)object;
+	if (dw_plugin->priv->index_idle_id != 0)
+		g_source_remove (dw_plugin->priv->index_idle_id);
+	g_source_remove (dw_plugin->priv->memory_check_id);
+	if (dw_plugin->priv->project != NULL)
+		gsc_words_project_free (dw_plugin->priv->project);
+	g_free (dw_plugin->priv->project_dir);
+	g_free (dw_plugin->priv->project_root);
+	g_hash_table_destroy (dw_plugin->priv->open_files);
+	g_queue_foreach (dw_plugin->priv->pending_buffers, (GFunc) g_object_unref, NULL);
+	g_queue_free (dw_plugin->priv->pending_buffers);
+	/* No index may push a scan to the pool once it is freed. The
+	   running scans finish, they hold their own data. */
+	gsc_words_index_remove_all ();
+	g_thread_pool_free (dw_plugin->priv->scan_pool, FALSE, TRUE);
 	g_object_unref(dw_plugin->priv->gconf_cli);
 	g_free(dw_plugin->priv->conf->ure_keys);
 	g_free(dw_plugin->priv->conf->od_keys);
@@ -160,33 +364,772 @@ docwordscompletion_plugin_finalize (GObject *object)
 	G_OBJECT_CLASS (docwordscompletion_plugin_parent_class)->finalize (object);
 }
 
+/*
+ * Returns the share of time (in %) some task waited for memory in the last
+ * 10 seconds, 0 if the kernel does not tell it
+ */
+static gdouble
+get_memory_pressure (void)
+{
+        gchar *contents;
+        gchar *avg;
+        gdouble pressure = 0;
+        
+        if (!g_file_get_contents (PSI_MEMORY_FILE, &contents, NULL, NULL))
+                return 0;
+        
+        /* some avg10=0.00 avg60=0.00 avg300=0.00 total=0 */
+        avg = strstr (contents, "some avg10=");
+        if (avg != NULL)
+                pressure = g_ascii_strtod (avg + strlen ("some avg10="), NULL);
+        
+        g_free (contents);
+        
+        return pressure;
+}
+
+/*
+ * Keeps the words of the least recently focused documents under the
+ * memory budget, which shrinks when the system is short of memory
+ */
+static gboolean
+memory_check_cb (DocwordscompletionPlugin *dw_plugin)
+{
+        gsize budget = (gsize) dw_plugin->priv->conf->memory_budget * 1024 * 1024;
+        gdouble pressure = get_memory_pressure ();
+        
+        if (pressure >= PSI_HIGH)
+                budget /= 4;
+        else if (pressure >= PSI_LOW)
+                budget /= 2;
+        
+        gsc_words_index_freeze_unused (FREEZE_DELAY);
+        gsc_words_index_trim (budget);
+        
+        return TRUE;
+}
+
+/*
+ * Only the newer completion libraries have a delay property. Without it
+ * the delay of the library is kept, said once.
+ */
+static gboolean
+has_delay_property (GscCompletion *completion)
+{
+        static gboolean warned = FALSE;
+        
+        if (g_object_class_find_property (G_OBJECT_GET_CLASS (completion),
+                                          "auto-complete-delay") != NULL)
+                return TRUE;
+        
+        if (!warned)
+        {
+                g_warning ("GscCompletion has no auto-complete-delay property: "
+                           "the autocompletion delay is not adapted");
+                warned = TRUE;
+        }
+        
+        return FALSE;
+}
+
 static void
-tab_added_cb (GeditWindow *geditwindow,
-              GeditTab    *tab,
-              gpointer     user_data)
+scheduler_set_delay (Scheduler *scheduler,
+                     guint delay)
 {
-        GeditView *view = gedit_tab_get_view (tab);
-        GscCompletion *comp = gsc_completion_new (GTK_TEXT_VIEW (view));
+        delay = CLAMP (delay, MIN_AC_DELAY, MAX_AC_DELAY);
+        if (delay == scheduler->delay)
+                return;
+        
+        scheduler->delay = delay;
+        g_object_set (scheduler->completion,
+                      "auto-complete-delay", delay,
+                      NULL);
+}
+
+static void
+scheduler_free (Scheduler *scheduler)
+{
+        g_object_unref (scheduler->provider);
+        g_slice_free (Scheduler, scheduler);
+}
+
+/*
+ * Computes the delay for the next proposals. A fast typist waits more so
+ * the words are not looked for while typing past them, a slow populate
+ * makes everybody wait a bit more and a pause brings the proposals sooner.
+ */
+static gboolean
+scheduler_key_press_cb (GtkWidget *view,
+                        GdkEventKey *event,
+                        Scheduler *scheduler)
+{
+        gint64 now = g_get_monotonic_time () / 1000;
+        guint interval = MIN (now - scheduler->last_key, TYPING_PAUSE);
+        guint delay = scheduler->base_delay;
+        
+        scheduler->last_key = now;
+        
+        if (interval >= TYPING_PAUSE)
+        {
+                scheduler->key_interval = TYPING_PAUSE;
+                delay /= 2;
+        }
+        else
+        {
+                scheduler->key_interval = (3 * scheduler->key_interval + interval) / 4;
+                
+                if (scheduler->key_interval < scheduler->base_delay)
+                        delay += scheduler->base_delay - scheduler->key_interval;
+        }
+        
+        /* The latency is in microseconds */
+        delay += gsc_provider_words_get_latency (scheduler->provider) * 4 / 1000;
+        
+        scheduler_set_delay (scheduler, delay);
+        
+        return FALSE;
+}
+
+static void
+attach_completion (DocwordscompletionPlugin *dw_plugin,
+                   GtkTextView *view)
+{
+        GscCompletion *comp = gsc_completion_get_from_view (view);
+        ConfData *conf = dw_plugin->priv->conf;
+        GscProviderQuickopen *quickopen;
+        GscGeditopendocProvider *opendoc;
+        GscGeditrecentProvider *recent;
+        GtkWidget *window;
+        Scheduler *scheduler;
+        
+        /* A view used before the plugin was deactivated keeps its
+           completion */
+        if (comp == NULL)
+                comp = gsc_completion_new (view);
+        
         g_debug ("Adding Words provider");
         GscProviderWords *dw  = gsc_provider_words_new();
+        gsc_provider_words_set_thread_pool (dw, dw_plugin->priv->scan_pool);
+        /* The nearest (then the most used) words are the best ones, a few
+           are enough */
+        gsc_provider_words_set_sort_type (dw, GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_PROXIMITY);
+        gsc_provider_words_set_max_proposals (dw, RANKED_MAX_PROPOSALS);
+        gsc_provider_words_set_interactive (dw, conf->ac_enabled);
         gsc_completion_add_provider(comp,GSC_PROVIDER(dw), NULL);
+        g_object_set_data_full (G_OBJECT (view),
+                                WORDS_DATA_KEY,
+                                g_object_ref (dw),
+                                g_object_unref);
+        
+        if (conf->ac_enabled && has_delay_property (comp))
+        {
+                scheduler = g_slice_new0 (Scheduler);
+                scheduler->completion = comp;
+                scheduler->provider = g_object_ref (dw);
+                scheduler->base_delay = conf->ac_delay;
+                scheduler->key_interval = TYPING_PAUSE;
+                scheduler_set_delay (scheduler, conf->ac_delay);
+                
+                g_object_set_data_full (G_OBJECT (view),
+                                        SCHEDULER_DATA_KEY,
+                                        scheduler,
+                                        (GDestroyNotify) scheduler_free);
+                g_signal_connect (view, "key-press-event",
+                                  G_CALLBACK (scheduler_key_press_cb), scheduler);
+        }
 	
         g_object_unref(dw);
+        
+        /* The window indexes the files once for all its views */
+        window = gtk_widget_get_toplevel (GTK_WIDGET (view));
+        quickopen = g_object_get_data (G_OBJECT (window), QUICKOPEN_DATA_KEY);
+        if (quickopen != NULL)
+                gsc_completion_add_provider (comp, GSC_PROVIDER (quickopen), NULL);
+        
+        opendoc = g_object_get_data (G_OBJECT (window), OPENDOC_DATA_KEY);
+        if (opendoc != NULL)
+                gsc_completion_add_provider (comp, GSC_PROVIDER (opendoc), NULL);
+        
+        recent = g_object_get_data (G_OBJECT (window), RECENT_DATA_KEY);
+        if (recent != NULL)
+                gsc_completion_add_provider (comp, GSC_PROVIDER (recent), NULL);
+        
         g_debug ("provider registered");
 }
 
+/*
+ * Takes the providers of the plugin out of the completion of a view. The
+ * words provider must not scan in the pool of the plugin once it is freed.
+ */
+static void
+detach_completion (GtkTextView *view)
+{
+        GscCompletion *comp = gsc_completion_get_from_view (view);
+        GscProviderWords *dw;
+        Scheduler *scheduler;
+        GtkWidget *window;
+        GObject *provider;
+        const gchar *keys[] = { QUICKOPEN_DATA_KEY, OPENDOC_DATA_KEY, RECENT_DATA_KEY };
+        guint i;
+        
+        scheduler = g_object_get_data (G_OBJECT (view), SCHEDULER_DATA_KEY);
+        if (scheduler != NULL)
+        {
+                g_signal_handlers_disconnect_by_func (view,
+                                                      scheduler_key_press_cb,
+                                                      scheduler);
+                g_object_set_data (G_OBJECT (view), SCHEDULER_DATA_KEY, NULL);
+        }
+        
+        dw = g_object_get_data (G_OBJECT (view), WORDS_DATA_KEY);
+        if (dw != NULL)
+        {
+                gsc_provider_words_set_thread_pool (dw, NULL);
+                if (comp != NULL)
+                        gsc_completion_remove_provider (comp, GSC_PROVIDER (dw), NULL);
+                g_object_set_data (G_OBJECT (view), WORDS_DATA_KEY, NULL);
+        }
+        
+        window = gtk_widget_get_toplevel (GTK_WIDGET (view));
+        for (i = 0; i < G_N_ELEMENTS (keys) && comp != NULL; i++)
+        {
+                provider = g_object_get_data (G_OBJECT (window), keys[i]);
+                if (provider != NULL)
+                        gsc_completion_remove_provider (comp, GSC_PROVIDER (provider), NULL);
+        }
+}
+
+/*
+ * The completion is only built when the view is used for the first time
+ */
+static gboolean
+view_first_use_cb (GtkWidget *view,
+                   GdkEvent *event,
+                   DocwordscompletionPlugin *dw_plugin)
+{
+        g_signal_handlers_disconnect_by_func (view, view_first_use_cb, dw_plugin);
+        g_object_set_data (G_OBJECT (view), VIEW_DATA_KEY, VIEW_ATTACHED);
+        
+        attach_completion (dw_plugin, GTK_TEXT_VIEW (view));
+        
+        return FALSE;
+}
+
+/*
+ * Returns the file where the words of a local document are saved, named
+ * by the hash of its URI, and the information of the document file
+ */
+static gchar *
+get_cache_file (GeditDocument *doc,
+                struct stat *info)
+{
+        gchar *uri;
+        gchar *filename;
+        gchar *hash;
+        gchar *name;
+        gchar *cache_file = NULL;
+        
+        if (!gedit_document_is_local (doc))
+                return NULL;
+        
+        uri = gedit_document_get_uri (doc);
+        if (uri == NULL)
+                return NULL;
+        
+        filename = g_filename_from_uri (uri, NULL, NULL);
+        
+        if (filename != NULL && g_stat (filename, info) == 0)
+        {
+                hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+                name = g_strconcat (hash, CACHE_SUFFIX, NULL);
+                cache_file = g_build_filename (g_get_user_cache_dir (),
+                                               CACHE_DIR,
+                                               name,
+                                               NULL);
+                g_free (name);
+                g_free (hash);
+        }
+        
+        g_free (filename);
+        g_free (uri);
+        
+        return cache_file;
+}
+
+typedef struct
+{
+        gchar *path;
+        time_t mtime;
+        goffset size;
+} CacheEntry;
+
+/* Most recently used first */
+static gint
+cache_entry_compare (const CacheEntry *a,
+                     const CacheEntry *b)
+{
+        if (a->mtime != b->mtime)
+                return a->mtime > b->mtime ? -1 : 1;
+        
+        return 0;
+}
+
+/*
+ * Removes the words saved for documents not opened for a long time, and
+ * the least recently used ones while the directory is too big. The index
+ * touches a file every time it loads it. The temporary files a crash left
+ * behind while saving are removed too.
+ */
+static gboolean
+prune_cache_idle (gpointer data)
+{
+        GArray *entries;
+        CacheEntry entry;
+        CacheEntry *e;
+        struct stat info;
+        const gchar *name;
+        gchar *dir_path;
+        GDir *dir;
+        time_t now = time (NULL);
+        goffset total = 0;
+        guint i;
+        
+        dir_path = g_build_filename (g_get_user_cache_dir (), CACHE_DIR, NULL);
+        dir = g_dir_open (dir_path, 0, NULL);
+        if (dir == NULL)
+        {
+                g_free (dir_path);
+                return FALSE;
+        }
+        
+        entries = g_array_new (FALSE, FALSE, sizeof (CacheEntry));
+        
+        while ((name = g_dir_read_name (dir)) != NULL)
+        {
+                entry.path = g_build_filename (dir_path, name, NULL);
+                
+                if (g_stat (entry.path, &info) != 0 || !S_ISREG (info.st_mode))
+                {
+                        g_free (entry.path);
+                        continue;
+                }
+                
+                /* Saved as name.XXXXXX before the rename to name */
+                if (!g_str_has_suffix (name, CACHE_SUFFIX))
+                {
+                        if (now - info.st_mtime > CACHE_TMP_AGE)
+                                g_unlink (entry.path);
+                        
+                        g_free (entry.path);
+                        continue;
+                }
+                
+                entry.mtime = info.st_mtime;
+                entry.size = info.st_size;
+                g_array_append_val (entries, entry);
+        }
+        
+        g_dir_close (dir);
+        g_free (dir_path);
+        
+        g_array_sort (entries, (GCompareFunc) cache_entry_compare);
+        
+        for (i = 0; i < entries->len; i++)
+        {
+                e = &g_array_index (entries, CacheEntry, i);
+                total += e->size;
+                
+                if (total > CACHE_MAX_SIZE || now - e->mtime > CACHE_MAX_AGE)
+                        g_unlink (e->path);
+                
+                g_free (e->path);
+        }
+        
+        g_array_free (entries, TRUE);
+        
+        return FALSE;
+}
+
+/*
+ * Indexes the buffer beginning with the lines around the cursor, which
+ * gedit keeps visible. The rest is scanned in idle slices.
+ */
+static void
+warm_buffer (DocwordscompletionPlugin *dw_plugin,
+             GtkTextBuffer *buffer)
+{
+        GtkTextIter first;
+        GtkTextIter last;
+        gchar *cache_file = NULL;
+        struct stat info;
+        
+        gtk_text_buffer_get_iter_at_mark (buffer, &first,
+                                          gtk_text_buffer_get_insert (buffer));
+        last = first;
+        gtk_text_iter_backward_lines (&first, WARM_LINES / 2);
+        gtk_text_iter_forward_lines (&last, WARM_LINES / 2);
+        
+        if (GEDIT_IS_DOCUMENT (buffer))
+                cache_file = get_cache_file (GEDIT_DOCUMENT (buffer), &info);
+        
+        gsc_words_index_warm (buffer, dw_plugin->priv->scan_pool,
+                              &first, &last,
+                              cache_file,
+                              cache_file != NULL ? info.st_mtime : 0,
+                              cache_file != NULL ? info.st_size : 0);
+        g_free (cache_file);
+}
+
+/*
+ * Returns the local file of the document, NULL if it has none
+ */
+static gchar *
+get_document_file (GeditDocument *doc)
+{
+        gchar *uri;
+        gchar *filename;
+        
+        if (!gedit_document_is_local (doc))
+                return NULL;
+        
+        uri = gedit_document_get_uri (doc);
+        if (uri == NULL)
+                return NULL;
+        
+        filename = g_filename_from_uri (uri, NULL, NULL);
+        g_free (uri);
+        
+        return filename;
+}
+
+/*
+ * The words of an open document are in the index of its buffer, the
+ * project does not count them again
+ */
+static void
+set_open_file (DocwordscompletionPlugin *dw_plugin,
+               GeditDocument *doc)
+{
+        GscWordsProject *project = dw_plugin->priv->project;
+        gchar *filename = get_document_file (doc);
+        const gchar *old = g_hash_table_lookup (dw_plugin->priv->open_files, doc);
+        
+        if (old != NULL && filename != NULL && strcmp (old, filename) == 0)
+        {
+                g_free (filename);
+                return;
+        }
+        
+        if (old != NULL && project != NULL)
+                gsc_words_project_close_file (project, old);
+        
+        if (filename == NULL)
+        {
+                g_hash_table_remove (dw_plugin->priv->open_files, doc);
+                return;
+        }
+        
+        if (project != NULL)
+                gsc_words_project_open_file (project, filename);
+        
+        g_hash_table_replace (dw_plugin->priv->open_files, doc, filename);
+}
+
+/*
+ * The project reads the file of a closed document again
+ */
+static void
+forget_open_file (DocwordscompletionPlugin *dw_plugin,
+                  GeditDocument *doc)
+{
+        const gchar *old = g_hash_table_lookup (dw_plugin->priv->open_files, doc);
+        
+        if (old == NULL)
+                return;
+        
+        if (dw_plugin->priv->project != NULL)
+                gsc_words_project_close_file (dw_plugin->priv->project, old);
+        
+        g_hash_table_remove (dw_plugin->priv->open_files, doc);
+}
+
+/*
+ * Lists the project of the focused document for the quick open of its
+ * window and indexes its words. Both share the crawler of the project,
+ * which is only looked for when the document is in another directory.
+ */
+static void
+update_project (DocwordscompletionPlugin *dw_plugin,
+                GtkWidget *view)
+{
+        ConfData *conf = dw_plugin->priv->conf;
+        GeditDocument *doc;
+        GscProviderQuickopen *quickopen;
+        GHashTableIter iter;
+        gpointer open_file;
+        gchar *filename;
+        gchar *dir;
+        const gchar *root;
+        
+        doc = GEDIT_DOCUMENT (gtk_text_view_get_buffer (GTK_TEXT_VIEW (view)));
+        filename = get_document_file (doc);
+        if (filename == NULL)
+                return;
+        
+        dir = g_path_get_dirname (filename);
+        if (dw_plugin->priv->project_dir == NULL ||
+            strcmp (dir, dw_plugin->priv->project_dir) != 0)
+        {
+                g_free (dw_plugin->priv->project_dir);
+                g_free (dw_plugin->priv->project_root);
+                dw_plugin->priv->project_dir = dir;
+                dw_plugin->priv->project_root = gsc_project_crawler_find_root (filename);
+        }
+        else
+        {
+                g_free (dir);
+        }
+        g_free (filename);
+        
+        root = dw_plugin->priv->project_root;
+        
+        quickopen = g_object_get_data (G_OBJECT (gtk_widget_get_toplevel (view)),
+                                       QUICKOPEN_DATA_KEY);
+        if (quickopen != NULL)
+                gsc_provider_quickopen_set_project (quickopen, root);
+        
+        if (!conf->project_enabled)
+                return;
+        
+        /* A file out of any checkout has no project, its directory may be
+           the whole home */
+        if (root == NULL)
+        {
+                if (dw_plugin->priv->project != NULL)
+                        gsc_words_project_free (dw_plugin->priv->project);
+                dw_plugin->priv->project = NULL;
+                return;
+        }
+        
+        if (dw_plugin->priv->project == NULL ||
+            strcmp (root, gsc_words_project_get_root (dw_plugin->priv->project)) != 0)
+        {
+                if (dw_plugin->priv->project != NULL)
+                        gsc_words_project_free (dw_plugin->priv->project);
+                
+                dw_plugin->priv->project =
+                        gsc_words_project_new (root,
+                                               conf->project_max_files,
+                                               conf->project_threads,
+                                               (gsize) conf->project_memory_budget * 1024 * 1024);
+                
+                g_hash_table_iter_init (&iter, dw_plugin->priv->open_files);
+                while (g_hash_table_iter_next (&iter, NULL, &open_file))
+                        gsc_words_project_open_file (dw_plugin->priv->project,
+                                                     open_file);
+        }
+}
+
+/*
+ * The focused document is the last one evicted, and its words are scanned
+ * again if they were
+ */
+static gboolean
+view_focus_in_cb (GtkWidget *view,
+                  GdkEvent *event,
+                  DocwordscompletionPlugin *dw_plugin)
+{
+        GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+        
+        gsc_words_index_touch (buffer, dw_plugin->priv->scan_pool);
+        update_project (dw_plugin, view);
+        
+        return FALSE;
+}
+
+/*
+ * Indexes one pending buffer per call, so the words of every document are
+ * proposed in all the tabs without slowing down the startup
+ */
+static gboolean
+index_pending_buffers_idle (DocwordscompletionPlugin *dw_plugin)
+{
+        GtkTextBuffer *buffer;
+        
+        buffer = g_queue_pop_head (dw_plugin->priv->pending_buffers);
+        if (buffer != NULL)
+        {
+                warm_buffer (dw_plugin, buffer);
+                g_object_unref (buffer);
+        }
+        
+        if (g_queue_is_empty (dw_plugin->priv->pending_buffers))
+        {
+                dw_plugin->priv->index_idle_id = 0;
+                return FALSE;
+        }
+        
+        return TRUE;
+}
+
+/*
+ * Indexes the buffer in a low priority idle, after the pending ones. Even
+ * the small buffers scanned at once wait there: the tab shows the loaded
+ * text before its words are counted.
+ */
+static void
+queue_buffer (DocwordscompletionPlugin *dw_plugin,
+              GtkTextBuffer *buffer)
+{
+        if (g_queue_find (dw_plugin->priv->pending_buffers, buffer) != NULL)
+                return;
+        
+        g_queue_push_tail (dw_plugin->priv->pending_buffers,
+                           g_object_ref (buffer));
+        
+        if (dw_plugin->priv->index_idle_id == 0)
+        {
+                dw_plugin->priv->index_idle_id =
+                        g_idle_add_full (G_PRIORITY_LOW,
+                                         (GSourceFunc) index_pending_buffers_idle,
+                                         dw_plugin,
+                                         NULL);
+        }
+}
+
+static void
+document_loaded_cb (GeditDocument *doc,
+                    const GError *error,
+                    DocwordscompletionPlugin *dw_plugin)
+{
+        if (error == NULL)
+        {
+                set_open_file (dw_plugin, doc);
+                queue_buffer (dw_plugin, GTK_TEXT_BUFFER (doc));
+        }
+}
+
+/*
+ * A document saved with another name
+ */
+static void
+document_saved_cb (GeditDocument *doc,
+                   const GError *error,
+                   DocwordscompletionPlugin *dw_plugin)
+{
+        if (error == NULL)
+                set_open_file (dw_plugin, doc);
+}
+
+static void
+setup_view (DocwordscompletionPlugin *dw_plugin,
+            GeditView *view)
+{
+        GtkTextBuffer *buffer;
+        GeditTabState state;
+        
+        if (g_object_get_data (G_OBJECT (view), VIEW_DATA_KEY) != NULL)
+                return;
+        
+        g_object_set_data (G_OBJECT (view), VIEW_DATA_KEY, VIEW_WAITING);
+        g_signal_connect (view, "focus-in-event",
+                          G_CALLBACK (view_first_use_cb), dw_plugin);
+        g_signal_connect (view, "key-press-event",
+                          G_CALLBACK (view_first_use_cb), dw_plugin);
+        g_signal_connect (view, "focus-in-event",
+                          G_CALLBACK (view_focus_in_cb), dw_plugin);
+        
+        /* A document is indexed when it has been loaded, not while the
+           loader fills it */
+        buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+        g_signal_connect (buffer, "loaded",
+                          G_CALLBACK (document_loaded_cb), dw_plugin);
+        g_signal_connect (buffer, "saved",
+                          G_CALLBACK (document_saved_cb), dw_plugin);
+        set_open_file (dw_plugin, GEDIT_DOCUMENT (buffer));
+        
+        state = gedit_tab_get_state (gedit_tab_get_from_document (GEDIT_DOCUMENT (buffer)));
+        if (state == GEDIT_TAB_STATE_LOADING || state == GEDIT_TAB_STATE_REVERTING)
+                return;
+        
+        queue_buffer (dw_plugin, buffer);
+}
+
+static void
+tab_added_cb (GeditWindow *geditwindow,
+              GeditTab    *tab,
+              gpointer     user_data)
+{
+        setup_view ((DocwordscompletionPlugin*)user_data,
+                    gedit_tab_get_view (tab));
+}
+
+
+static void
+tab_removed_cb (GeditWindow *geditwindow,
+                GeditTab    *tab,
+                gpointer     user_data)
+{
+        DocwordscompletionPlugin *dw_plugin = (DocwordscompletionPlugin*)user_data;
+        GeditDocument *doc = gedit_tab_get_document (tab);
+        
+        forget_open_file (dw_plugin, doc);
+        
+        /* A closed document is not indexed */
+        if (g_queue_remove (dw_plugin->priv->pending_buffers, doc))
+                g_object_unref (doc);
+}
 
 static void
 impl_activate (GeditPlugin *plugin,
 	       GeditWindow *window)
 {
 	DocwordscompletionPlugin * dw_plugin = (DocwordscompletionPlugin*)plugin;
+	GscGeditrecentProvider *recent;
+	GList *views;
+	GList *l;
 	dw_plugin->priv->gedit_window = window;
 	gedit_debug (DEBUG_PLUGINS);
 
+	if (dw_plugin->priv->conf->quick_open_enabled)
+	{
+		g_object_set_data_full (G_OBJECT (window),
+					QUICKOPEN_DATA_KEY,
+					gsc_provider_quickopen_new (window),
+					g_object_unref);
+	}
+
+	if (dw_plugin->priv->conf->open_enabled)
+	{
+		g_object_set_data_full (G_OBJECT (window),
+					OPENDOC_DATA_KEY,
+					gsc_geditopendoc_provider_new (window),
+					g_object_unref);
+	}
+
+	if (dw_plugin->priv->conf->recent_enabled)
+	{
+		recent = gsc_geditrecent_provider_new (window);
+		gsc_geditrecent_provider_set_max_recent (recent,
+							 dw_plugin->priv->conf->max_recent);
+		g_object_set_data_full (G_OBJECT (window),
+					RECENT_DATA_KEY,
+					recent,
+					g_object_unref);
+	}
+
+	/* The tabs opened before the plugin was activated */
+	views = gedit_window_get_views (window);
+	for (l = views; l != NULL; l = g_list_next (l))
+		setup_view (dw_plugin, GEDIT_VIEW (l->data));
+	g_list_free (views);
+
 	g_signal_connect (window, "tab-added",
                           G_CALLBACK (tab_added_cb),
-                          NULL);
+                          dw_plugin);
+	g_signal_connect (window, "tab-removed",
+                          G_CALLBACK (tab_removed_cb),
+                          dw_plugin);
 
 
 }
@@ -195,7 +1138,48 @@ static void
 impl_deactivate (GeditPlugin *plugin,
 		 GeditWindow *window)
 {
+	DocwordscompletionPlugin * dw_plugin = (DocwordscompletionPlugin*)plugin;
+	GtkTextBuffer *buffer;
+	GList *views;
+	GList *l;
 	gedit_debug (DEBUG_PLUGINS);
+
+	g_signal_handlers_disconnect_by_func (window, tab_added_cb, plugin);
+	g_signal_handlers_disconnect_by_func (window, tab_removed_cb, plugin);
+
+	/* The views already used lose the providers, the views never used
+	   do not wait for the plugin any more */
+	views = gedit_window_get_views (window);
+	for (l = views; l != NULL; l = g_list_next (l))
+	{
+		buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (l->data));
+		g_signal_handlers_disconnect_by_func (buffer,
+						      document_loaded_cb,
+						      plugin);
+		g_signal_handlers_disconnect_by_func (buffer,
+						      document_saved_cb,
+						      plugin);
+		forget_open_file (dw_plugin, GEDIT_DOCUMENT (buffer));
+
+		/* The indexes stop following the edits */
+		gsc_words_index_remove (buffer);
+		if (g_queue_remove (dw_plugin->priv->pending_buffers, buffer))
+			g_object_unref (buffer);
+
+		g_signal_handlers_disconnect_by_func (l->data, view_focus_in_cb, plugin);
+
+		if (g_object_get_data (G_OBJECT (l->data), VIEW_DATA_KEY) == VIEW_ATTACHED)
+			detach_completion (GTK_TEXT_VIEW (l->data));
+		else
+			g_signal_handlers_disconnect_by_func (l->data, view_first_use_cb, plugin);
+
+		g_object_set_data (G_OBJECT (l->data), VIEW_DATA_KEY, NULL);
+	}
+	g_list_free (views);
+
+	g_object_set_data (G_OBJECT (window), QUICKOPEN_DATA_KEY, NULL);
+	g_object_set_data (G_OBJECT (window), OPENDOC_DATA_KEY, NULL);
+	g_object_set_data (G_OBJECT (window), RECENT_DATA_KEY, NULL);
 }
 
 static void
@@ -26,119 +26,229 @@
 struct _GscGeditopendocProviderPrivate {
 	GeditWindow *window;
 	GdkPixbuf *icon;
+	/* A proposal for every document, in the order of the tabs. They are
+	   kept up to date by the window and document signals. */
+	GQueue proposals;
+	/* GeditDocument -> its link in proposals */
+	GHashTable *links;
 };
 
 #define GSC_GEDITOPENDOC_PROVIDER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), TYPE_GSC_GEDITOPENDOC_PROVIDER, GscGeditopendocProviderPrivate))
 
-static const gchar* gsc_geditopendoc_provider_real_get_name (GscProvider* self);
-static GList* gsc_geditopendoc_provider_real_get_proposals (GscProvider* base, GscTrigger *trigger);
-static void gsc_geditopendoc_provider_real_end_completion (GscProvider* base);
-static gpointer gsc_geditopendoc_provider_parent_class = NULL;
-static GscProviderIface* gsc_geditopendoc_provider_parent_iface = NULL;
+static void gsc_geditopendoc_provider_iface_init (GscProviderIface *iface);
 
-static const gchar* gsc_geditopendoc_provider_real_get_name (GscProvider* self)
+G_DEFINE_TYPE_WITH_CODE (GscGeditopendocProvider,
+			 gsc_geditopendoc_provider,
+			 G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (GSC_TYPE_PROVIDER,
+						gsc_geditopendoc_provider_iface_init))
+
+static const gchar* gsc_geditopendoc_provider_get_name (GscProvider* self)
 {
 	return GSC_GEDITOPENDOC_PROVIDER_NAME;
 }
 
-static GList* gsc_geditopendoc_provider_real_get_proposals (GscProvider* base, GscTrigger *trigger)
+static GdkPixbuf* gsc_geditopendoc_provider_get_icon (GscProvider* self)
 {
-
-	GList *item_list = NULL;
-	GList *wins,*temp;
-	GeditDocument *doc, *current_doc;
-	GscProposal *item;
-	GscGeditopendocProvider *self = GSC_GEDITOPENDOC_PROVIDER (base);
-	wins = gedit_window_get_documents(self->priv->window);
-	current_doc = gedit_window_get_active_document(self->priv->window);
-	temp = wins;
-	while(temp!=NULL)
-	{
-		doc = GEDIT_DOCUMENT(temp->data);
-		if (doc != current_doc)
-		{
-			item = gsc_proposal_open_new (self->priv->window,
-						      doc,
-						      self->priv->icon);
-			item_list = g_list_append(item_list,item);
-			
-		}
-		temp = g_list_next(temp);
-	}
-
-	g_list_free(wins);
-	return item_list;
+	return GSC_GEDITOPENDOC_PROVIDER (self)->priv->icon;
 }
 
-static void gsc_geditopendoc_provider_real_end_completion (GscProvider* base)
+static void document_name_changed_cb (GeditDocument *doc, GParamSpec *pspec, GscGeditopendocProvider *self)
 {
+	GList *link = g_hash_table_lookup (self->priv->links, doc);
+	
+	if (link == NULL)
+		return;
+	
+	/* The label and the info are only set when a proposal is created */
+	g_object_unref (link->data);
+	link->data = gsc_proposal_open_new (self->priv->window,
+					    doc,
+					    self->priv->icon);
+}
 
+static void add_document (GscGeditopendocProvider *self, GeditDocument *doc)
+{
+	GscProposal *item;
+	
+	if (g_hash_table_lookup (self->priv->links, doc) != NULL)
+		return;
+	
+	item = gsc_proposal_open_new (self->priv->window,
+				      doc,
+				      self->priv->icon);
+	g_queue_push_tail (&self->priv->proposals, item);
+	g_hash_table_insert (self->priv->links, doc, self->priv->proposals.tail);
+	
+	g_signal_connect (doc, "notify::shortname",
+			  G_CALLBACK (document_name_changed_cb), self);
+	g_signal_connect (doc, "notify::uri",
+			  G_CALLBACK (document_name_changed_cb), self);
 }
 
-static void gsc_geditopendoc_provider_get_property (GObject * object, guint property_id, GValue * value, GParamSpec * pspec)
+static void remove_document (GscGeditopendocProvider *self, GeditDocument *doc)
 {
+	GList *link = g_hash_table_lookup (self->priv->links, doc);
+	
+	if (link == NULL)
+		return;
+	
+	g_signal_handlers_disconnect_by_func (doc, document_name_changed_cb, self);
+	
+	g_object_unref (link->data);
+	g_queue_delete_link (&self->priv->proposals, link);
+	g_hash_table_remove (self->priv->links, doc);
 }
 
+static void tab_added_cb (GeditWindow *window, GeditTab *tab, GscGeditopendocProvider *self)
+{
+	add_document (self, gedit_tab_get_document (tab));
+}
 
-static void gsc_geditopendoc_provider_set_property (GObject * object, guint property_id, const GValue * value, GParamSpec * pspec)
+static void tab_removed_cb (GeditWindow *window, GeditTab *tab, GscGeditopendocProvider *self)
 {
+	remove_document (self, gedit_tab_get_document (tab));
 }
 
-static void gsc_geditopendoc_provider_finalize(GObject *object)
+/* Moves the proposals to the new order of the tabs */
+static void tabs_reordered_cb (GeditWindow *window, GscGeditopendocProvider *self)
 {
-	GscGeditopendocProvider *self;
+	GList *docs, *temp, *link;
 	
-	self = GSC_GEDITOPENDOC_PROVIDER(object);
+	docs = gedit_window_get_documents (window);
+	for (temp = docs; temp != NULL; temp = g_list_next (temp))
+	{
+		link = g_hash_table_lookup (self->priv->links, temp->data);
+		if (link == NULL)
+			continue;
+		
+		g_queue_unlink (&self->priv->proposals, link);
+		g_queue_push_tail_link (&self->priv->proposals, link);
+	}
+	g_list_free (docs);
+}
+
+static void gsc_geditopendoc_provider_populate_completion (GscProvider* base, GscContext *context)
+{
+	GList *item_list = NULL;
+	GList *temp;
+	GeditDocument *current_doc = NULL;
+	GscGeditopendocProvider *self = GSC_GEDITOPENDOC_PROVIDER (base);
 	
-	g_object_unref(self->priv->icon);
+	if (self->priv->window != NULL)
+		current_doc = gedit_window_get_active_document (self->priv->window);
 	
-	G_OBJECT_CLASS(gsc_geditopendoc_provider_parent_class)->finalize(object);
-}
+	/* GscManager frees the proposals it gets, the cache keeps its own
+	   references */
+	for (temp = self->priv->proposals.tail; temp != NULL; temp = temp->prev)
+	{
+		if (gsc_proposal_open_get_document (GSC_PROPOSAL_OPEN (temp->data)) != current_doc)
+			item_list = g_list_prepend (item_list, g_object_ref (temp->data));
+	}
 
+	gsc_context_add_proposals (context, base, item_list);
+}
 
-static void gsc_geditopendoc_provider_class_init (GscGeditopendocProviderClass * klass)
+/*
+ * The documents are only proposed when the completion is requested with the
+ * user request keys (AUTOMATIC), never while typing (INTERACTIVE)
+ */
+static const gchar* gsc_geditopendoc_provider_get_capabilities (GscProvider* base)
 {
-	gsc_geditopendoc_provider_parent_class = g_type_class_peek_parent (klass);
-	G_OBJECT_CLASS (klass)->get_property = gsc_geditopendoc_provider_get_property;
-	G_OBJECT_CLASS (klass)->set_property = gsc_geditopendoc_provider_set_property;
-	G_OBJECT_CLASS (klass)->finalize = gsc_geditopendoc_provider_finalize;
+	return GSC_COMPLETION_CAPABILITY_AUTOMATIC;
 }
 
+static void window_finalized_cb (GscGeditopendocProvider *self, GObject *window)
+{
+	self->priv->window = NULL;
+}
 
-static void gsc_geditopendoc_provider_interface_init (GscProviderIface * iface)
+static void gsc_geditopendoc_provider_dispose (GObject *object)
 {
-	gsc_geditopendoc_provider_parent_iface = g_type_interface_peek_parent (iface);
-	iface->get_proposals = gsc_geditopendoc_provider_real_get_proposals;
-	iface->get_name = gsc_geditopendoc_provider_real_get_name;
-	iface->finish = gsc_geditopendoc_provider_real_end_completion;
+	GscGeditopendocProvider *self = GSC_GEDITOPENDOC_PROVIDER (object);
+	
+	if (self->priv->window != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (self->priv->window, tab_added_cb, self);
+		g_signal_handlers_disconnect_by_func (self->priv->window, tab_removed_cb, self);
+		g_signal_handlers_disconnect_by_func (self->priv->window, tabs_reordered_cb, self);
+		g_object_weak_unref (G_OBJECT (self->priv->window),
+				     (GWeakNotify) window_finalized_cb,
+				     self);
+		self->priv->window = NULL;
+	}
+	
+	while (!g_queue_is_empty (&self->priv->proposals))
+		remove_document (self, gsc_proposal_open_get_document (GSC_PROPOSAL_OPEN (g_queue_peek_head (&self->priv->proposals))));
+	
+	G_OBJECT_CLASS (gsc_geditopendoc_provider_parent_class)->dispose (object);
 }
 
+static void gsc_geditopendoc_provider_finalize (GObject *object)
+{
+	GscGeditopendocProvider *self = GSC_GEDITOPENDOC_PROVIDER (object);
+	
+	g_hash_table_destroy (self->priv->links);
+	
+	if (self->priv->icon != NULL)
+		g_object_unref (self->priv->icon);
+	
+	G_OBJECT_CLASS (gsc_geditopendoc_provider_parent_class)->finalize (object);
+}
 
-static void gsc_geditopendoc_provider_init (GscGeditopendocProvider * self)
+static void gsc_geditopendoc_provider_class_init (GscGeditopendocProviderClass *klass)
 {
-	self->priv = g_new0(GscGeditopendocProviderPrivate, 1);
-	GtkIconTheme *theme = gtk_icon_theme_get_default();
-	self->priv->icon = gtk_icon_theme_load_icon(theme,GTK_STOCK_FILE,16,0,NULL);
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	
+	object_class->dispose = gsc_geditopendoc_provider_dispose;
+	object_class->finalize = gsc_geditopendoc_provider_finalize;
+	
+	g_type_class_add_private (object_class, sizeof (GscGeditopendocProviderPrivate));
 }
 
-GType gsc_geditopendoc_provider_get_type ()
+static void gsc_geditopendoc_provider_iface_init (GscProviderIface *iface)
 {
-	static GType g_define_type_id = 0;
-	if (G_UNLIKELY (g_define_type_id == 0)) {
-		static const GTypeInfo g_define_type_info = { sizeof (GscGeditopendocProviderClass), (GBaseInitFunc) NULL, (GBaseFinalizeFunc) NULL, (GClassInitFunc) gsc_geditopendoc_provider_class_init, (GClassFinalizeFunc) NULL, NULL, sizeof (GscGeditopendocProvider), 0, (GInstanceInitFunc) gsc_geditopendoc_provider_init };
-		g_define_type_id = g_type_register_static (G_TYPE_OBJECT, "GscGeditopendocProvider", &g_define_type_info, 0);
-		static const GInterfaceInfo gsc_manager_provider_info = { (GInterfaceInitFunc) gsc_geditopendoc_provider_interface_init, (GInterfaceFinalizeFunc) NULL, NULL};
-		g_type_add_interface_static (g_define_type_id, GSC_TYPE_PROVIDER, &gsc_manager_provider_info);
-	}
-	return g_define_type_id;
+	iface->get_name = gsc_geditopendoc_provider_get_name;
+	iface->get_icon = gsc_geditopendoc_provider_get_icon;
+	
+	iface->populate_completion = gsc_geditopendoc_provider_populate_completion;
+	iface->get_capabilities = gsc_geditopendoc_provider_get_capabilities;
 }
 
+static void gsc_geditopendoc_provider_init (GscGeditopendocProvider *self)
+{
+	GtkIconTheme *theme = gtk_icon_theme_get_default ();
+	
+	self->priv = GSC_GEDITOPENDOC_PROVIDER_GET_PRIVATE (self);
+	g_queue_init (&self->priv->proposals);
+	self->priv->links = g_hash_table_new (g_direct_hash, g_direct_equal);
+	self->priv->icon = gtk_icon_theme_load_icon (theme, GTK_STOCK_FILE, 16, 0, NULL);
+}
 
 GscGeditopendocProvider*
-gsc_geditopendoc_provider_new(GeditWindow *window)
+gsc_geditopendoc_provider_new (GeditWindow *window)
 {
-	GscGeditopendocProvider *self = GSC_GEDITOPENDOC_PROVIDER (g_object_new (TYPE_GSC_GEDITOPENDOC_PROVIDER, NULL));
+	GscGeditopendocProvider *self;
+	GList *docs, *temp;
+	
+	g_return_val_if_fail (GEDIT_IS_WINDOW (window), NULL);
+	
+	self = g_object_new (TYPE_GSC_GEDITOPENDOC_PROVIDER, NULL);
 	self->priv->window = window;
+	g_object_weak_ref (G_OBJECT (window),
+			   (GWeakNotify) window_finalized_cb,
+			   self);
+	
+	docs = gedit_window_get_documents (window);
+	for (temp = docs; temp != NULL; temp = g_list_next (temp))
+		add_document (self, GEDIT_DOCUMENT (temp->data));
+	g_list_free (docs);
+	
+	g_signal_connect (window, "tab-added",
+			  G_CALLBACK (tab_added_cb), self);
+	g_signal_connect (window, "tab-removed",
+			  G_CALLBACK (tab_removed_cb), self);
+	g_signal_connect (window, "tabs-reordered",
+			  G_CALLBACK (tabs_reordered_cb), self);
 	return self;
 }
-
@@ -52,7 +52,7 @@ struct _GscGeditopendocProviderClass {
 	GObjectClass parent;
 };
 
-GType gsc_geditopendoc_provider_get_type ();
+GType gsc_geditopendoc_provider_get_type (void) G_GNUC_CONST;
 
 GscGeditopendocProvider*
 gsc_geditopendoc_provider_new(GeditWindow *window);
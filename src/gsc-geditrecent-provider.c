@@ -24,144 +24,420 @@
 
 #define ICON_FILE ICON_DIR"/locals.png"
 
+#define DEFAULT_MAX_RECENT 10
+
 struct _GscGeditrecentProviderPrivate {
 	GeditWindow *window;
 	GdkPixbuf *icon;
+	GtkRecentManager *manager;
+	guint max_recent;
+	/* The max_recent gedit items modified last, in a min-heap by
+	   modification time. Each holds a reference. */
+	GtkRecentInfo **heap;
+	guint heap_size;
+	/* Newest modification time of the gedit items last walked */
+	time_t last_modified;
+	/* Proposals of the heap, newest first */
+	GList *proposals;
+	/* The heap is a selection of all the items */
+	gboolean valid;
+	/* The manager has changed since the items were last walked */
+	gboolean changed;
 };
 
 #define GSC_GEDITRECENT_PROVIDER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), TYPE_GSC_GEDITRECENT_PROVIDER, GscGeditrecentProviderPrivate))
 
 enum  {
 	GSC_GEDITRECENT_PROVIDER_DUMMY_PROPERTY,
+	GSC_GEDITRECENT_PROVIDER_MAX_RECENT
 };
-static const gchar* gsc_geditrecent_provider_real_get_name (GscProvider* self);
-static GList* gsc_geditrecent_provider_real_get_proposals (GscProvider* base, GscTrigger *trigger);
-static void gsc_geditrecent_provider_real_end_completion (GscProvider* base);
-static gpointer gsc_geditrecent_provider_parent_class = NULL;
-static GscProviderIface* gsc_geditrecent_provider_gsc_manager_provider_parent_iface = NULL;
 
+static void gsc_geditrecent_provider_iface_init (GscProviderIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (GscGeditrecentProvider,
+			 gsc_geditrecent_provider,
+			 G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (GSC_TYPE_PROVIDER,
+						gsc_geditrecent_provider_iface_init))
 
-static const gchar* gsc_geditrecent_provider_real_get_name (GscProvider* self)
+static const gchar* gsc_geditrecent_provider_get_name (GscProvider* self)
 {
 	return GSC_GEDITRECENT_PROVIDER_NAME;
 }
 
+static GdkPixbuf* gsc_geditrecent_provider_get_icon (GscProvider* self)
+{
+	return GSC_GEDITRECENT_PROVIDER (self)->priv->icon;
+}
+
+/*
+ * Min-heap by modification time: the root is the oldest item kept
+ */
+static void
+heap_sift_up (GtkRecentInfo **heap, guint i)
+{
+	GtkRecentInfo *tmp = heap[i];
+	guint parent;
+
+	while (i > 0)
+	{
+		parent = (i - 1) / 2;
+		if (gtk_recent_info_get_modified (heap[parent]) <= gtk_recent_info_get_modified (tmp))
+			break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = tmp;
+}
+
+static void
+heap_sift_down (GtkRecentInfo **heap, guint size, guint i)
+{
+	GtkRecentInfo *tmp = heap[i];
+	guint child;
+
+	while ((child = 2 * i + 1) < size)
+	{
+		if (child + 1 < size &&
+		    gtk_recent_info_get_modified (heap[child + 1]) < gtk_recent_info_get_modified (heap[child]))
+			child++;
+		if (gtk_recent_info_get_modified (heap[child]) >= gtk_recent_info_get_modified (tmp))
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = tmp;
+}
+
+static void
+clear_proposals (GscGeditrecentProvider *self)
+{
+	g_list_foreach (self->priv->proposals, (GFunc) g_object_unref, NULL);
+	g_list_free (self->priv->proposals);
+	self->priv->proposals = NULL;
+}
+
+static void
+clear_heap (GscGeditrecentProvider *self)
+{
+	guint i;
+
+	for (i = 0; i < self->priv->heap_size; i++)
+		gtk_recent_info_unref (self->priv->heap[i]);
+	self->priv->heap_size = 0;
+	self->priv->valid = FALSE;
+}
+
+/*
+ * Adds an item while the heap is not full, or in place of the oldest one
+ * if it is newer. Returns TRUE if it was added.
+ */
+static gboolean
+heap_add (GscGeditrecentProvider *self, GtkRecentInfo *info)
+{
+	GtkRecentInfo **heap = self->priv->heap;
+
+	if (self->priv->heap_size < self->priv->max_recent)
+	{
+		heap[self->priv->heap_size] = gtk_recent_info_ref (info);
+		heap_sift_up (heap, self->priv->heap_size++);
+		return TRUE;
+	}
+
+	if (gtk_recent_info_get_modified (info) > gtk_recent_info_get_modified (heap[0]))
+	{
+		gtk_recent_info_unref (heap[0]);
+		heap[0] = gtk_recent_info_ref (info);
+		heap_sift_down (heap, self->priv->heap_size, 0);
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
 static gint
-sort_recents_mru (GtkRecentInfo *a, GtkRecentInfo *b)
+heap_find (GscGeditrecentProvider *self, GtkRecentInfo *info)
+{
+	guint i;
+
+	for (i = 0; i < self->priv->heap_size; i++)
+	{
+		if (gtk_recent_info_match (self->priv->heap[i], info))
+			return i;
+	}
+
+	return -1;
+}
+
+static void
+build_proposals (GscGeditrecentProvider *self)
+{
+	GtkRecentInfo **heap;
+	GtkRecentInfo *info;
+	guint size = self->priv->heap_size;
+
+	clear_proposals (self);
+	heap = g_memdup (self->priv->heap, MAX (size, 1) * sizeof (GtkRecentInfo *));
+
+	/* The oldest comes out first */
+	while (size > 0)
+	{
+		info = heap[0];
+		heap[0] = heap[--size];
+		heap_sift_down (heap, size, 0);
+
+		self->priv->proposals = g_list_prepend (self->priv->proposals,
+							gsc_proposal_recent_new (self->priv->window,
+										 info,
+										 self->priv->icon));
+	}
+
+	g_free (heap);
+}
+
+/*
+ * GtkRecentManager does not say what changed, so the items are walked
+ * again, but only the ones modified since the last walk update the heap.
+ * The heap is only selected again from all the items when one it kept
+ * is gone, since the next newest one is not known.
+ *
+ * Returns: TRUE if the heap changed
+ */
+static gboolean
+select_recents (GscGeditrecentProvider *self)
+{
+	GList *items = gtk_recent_manager_get_items (self->priv->manager);
+	GList *fresh = NULL;
+	GtkRecentInfo *info;
+	GList *l;
+	time_t last_modified = self->priv->last_modified;
+	time_t modified;
+	gboolean changed = FALSE;
+	gboolean incremental;
+	guint n_kept = 0;
+	gint i;
+
+	for (l = items; l != NULL; l = l->next)
+	{
+		info = l->data;
+		if (!gtk_recent_info_has_group (info, "gedit"))
+			continue;
+
+		modified = gtk_recent_info_get_modified (info);
+		last_modified = MAX (last_modified, modified);
+
+		if (!self->priv->valid || modified >= self->priv->last_modified)
+			fresh = g_list_prepend (fresh, info);
+
+		if (self->priv->valid && heap_find (self, info) >= 0)
+			n_kept++;
+	}
+
+	if (n_kept < self->priv->heap_size)
+	{
+		clear_heap (self);
+		changed = TRUE;
+		g_list_free (fresh);
+		fresh = NULL;
+
+		for (l = items; l != NULL; l = l->next)
+		{
+			if (gtk_recent_info_has_group (l->data, "gedit"))
+				fresh = g_list_prepend (fresh, l->data);
+		}
+	}
+
+	incremental = self->priv->valid;
+
+	for (l = fresh; l != NULL && self->priv->max_recent > 0; l = l->next)
+	{
+		info = l->data;
+
+		/* Modified again: it can only move away from the root */
+		i = incremental ? heap_find (self, info) : -1;
+		if (i < 0)
+		{
+			changed |= heap_add (self, info);
+		}
+		else if (gtk_recent_info_get_modified (info) !=
+			 gtk_recent_info_get_modified (self->priv->heap[i]))
+		{
+			gtk_recent_info_unref (self->priv->heap[i]);
+			self->priv->heap[i] = gtk_recent_info_ref (info);
+			heap_sift_down (self->priv->heap, self->priv->heap_size, i);
+			changed = TRUE;
+		}
+	}
+
+	self->priv->last_modified = last_modified;
+	self->priv->valid = TRUE;
+	self->priv->changed = FALSE;
+
+	g_list_free (fresh);
+	g_list_foreach (items, (GFunc) gtk_recent_info_unref, NULL);
+	g_list_free (items);
+
+	return changed;
+}
+
+static void
+recent_changed_cb (GtkRecentManager *manager, GscGeditrecentProvider *self)
 {
-        return (gtk_recent_info_get_modified (b) - gtk_recent_info_get_modified (a));
+	/* Walked on the next request: the manager changes many times
+	   while gedit opens and saves files */
+	self->priv->changed = TRUE;
 }
 
-static GList* gsc_geditrecent_provider_real_get_proposals (GscProvider* base, GscTrigger *trigger)
+static void gsc_geditrecent_provider_populate_completion (GscProvider* base, GscContext *context)
 {
 	GscGeditrecentProvider *self = GSC_GEDITRECENT_PROVIDER(base);
-	GscProposal *item;
 	GList *item_list = NULL;
-	gint max_recent = 10;
-	GtkRecentManager *recent_manager =  gtk_recent_manager_get_default ();
-	GList *items = gtk_recent_manager_get_items (recent_manager);
-	GList *filtered_items = NULL, *l;
-	/* filter */
-        for (l = items; l != NULL; l = l->next)
-        {
-                GtkRecentInfo *info = l->data;
-                if (!gtk_recent_info_has_group (info, "gedit"))
-                        continue;
-                filtered_items = g_list_prepend (filtered_items, info);
-        }
-
-        /* sort */
-        filtered_items = g_list_sort (filtered_items,
-                                      (GCompareFunc) sort_recents_mru);
-	gint i = 0;
-        for (l = filtered_items; l != NULL; l = l->next)
-        {
-        	GtkRecentInfo *info = l->data;
-		
-		item = gsc_proposal_recent_new (self->priv->window,
-						info,
-						self->priv->icon);
-
-		item_list = g_list_append(item_list,item);
-        	++i;
-        	if (i>=max_recent)
-        		break;
-        }
-        g_list_free(filtered_items);
-        g_list_foreach (items, (GFunc) gtk_recent_info_unref, NULL);
-        g_list_free (items);
-        
-	return item_list;
-}
-
-static void gsc_geditrecent_provider_real_end_completion (GscProvider* base)
+	GList *l;
+
+	if ((!self->priv->valid || self->priv->changed) && select_recents (self))
+		build_proposals (self);
+
+	/* GscManager frees the proposals it gets */
+	for (l = g_list_last (self->priv->proposals); l != NULL; l = l->prev)
+		item_list = g_list_prepend (item_list, g_object_ref (l->data));
+
+	gsc_context_add_proposals (context, base, item_list);
+}
+
+/*
+ * The recent files are only proposed when the completion is requested with the
+ * user request keys (AUTOMATIC), never while typing (INTERACTIVE)
+ */
+static const gchar* gsc_geditrecent_provider_get_capabilities (GscProvider* base)
 {
+	return GSC_COMPLETION_CAPABILITY_AUTOMATIC;
 }
 
 static void gsc_geditrecent_provider_get_property (GObject * object, guint property_id, GValue * value, GParamSpec * pspec)
 {
+	GscGeditrecentProvider *self = GSC_GEDITRECENT_PROVIDER (object);
+
+	switch (property_id)
+	{
+		case GSC_GEDITRECENT_PROVIDER_MAX_RECENT:
+			g_value_set_uint (value, self->priv->max_recent);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+			break;
+	}
 }
 
 
 static void gsc_geditrecent_provider_set_property (GObject * object, guint property_id, const GValue * value, GParamSpec * pspec)
 {
+	GscGeditrecentProvider *self = GSC_GEDITRECENT_PROVIDER (object);
+
+	switch (property_id)
+	{
+		case GSC_GEDITRECENT_PROVIDER_MAX_RECENT:
+			gsc_geditrecent_provider_set_max_recent (self, g_value_get_uint (value));
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+			break;
+	}
 }
 
-static void gsc_geditrecent_provider_finalize(GObject *object)
+static void gsc_geditrecent_provider_dispose (GObject *object)
 {
-	GscGeditrecentProvider *self;
+	GscGeditrecentProvider *self = GSC_GEDITRECENT_PROVIDER (object);
 	
-	self = GSC_GEDITRECENT_PROVIDER(object);
+	if (self->priv->manager != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (self->priv->manager, recent_changed_cb, self);
+		self->priv->manager = NULL;
+	}
+	clear_proposals (self);
+	clear_heap (self);
+	
+	G_OBJECT_CLASS (gsc_geditrecent_provider_parent_class)->dispose (object);
+}
+
+static void gsc_geditrecent_provider_finalize (GObject *object)
+{
+	GscGeditrecentProvider *self = GSC_GEDITRECENT_PROVIDER (object);
 	
-	g_object_unref(self->priv->icon);
+	if (self->priv->icon != NULL)
+		g_object_unref (self->priv->icon);
+	g_free (self->priv->heap);
 	
-	G_OBJECT_CLASS(gsc_geditrecent_provider_parent_class)->finalize(object);
+	G_OBJECT_CLASS (gsc_geditrecent_provider_parent_class)->finalize (object);
 }
 
 
 static void gsc_geditrecent_provider_class_init (GscGeditrecentProviderClass * klass)
 {
-	gsc_geditrecent_provider_parent_class = g_type_class_peek_parent (klass);
-	G_OBJECT_CLASS (klass)->get_property = gsc_geditrecent_provider_get_property;
-	G_OBJECT_CLASS (klass)->set_property = gsc_geditrecent_provider_set_property;
-	G_OBJECT_CLASS (klass)->finalize = gsc_geditrecent_provider_finalize;
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	
+	object_class->get_property = gsc_geditrecent_provider_get_property;
+	object_class->set_property = gsc_geditrecent_provider_set_property;
+	object_class->dispose = gsc_geditrecent_provider_dispose;
+	object_class->finalize = gsc_geditrecent_provider_finalize;
+	
+	g_type_class_add_private (object_class, sizeof (GscGeditrecentProviderPrivate));
+
+	g_object_class_install_property (G_OBJECT_CLASS (klass),
+					 GSC_GEDITRECENT_PROVIDER_MAX_RECENT,
+					 g_param_spec_uint ("max-recent",
+							    "Max recent",
+							    "Number of recent files proposed",
+							    0,
+							    G_MAXUINT,
+							    DEFAULT_MAX_RECENT,
+							    G_PARAM_READWRITE));
 }
 
 
-static void gsc_geditrecent_provider_gsc_manager_provider_interface_init (GscProviderIface * iface)
+static void gsc_geditrecent_provider_iface_init (GscProviderIface *iface)
 {
-	gsc_geditrecent_provider_gsc_manager_provider_parent_iface = g_type_interface_peek_parent (iface);
-	iface->get_proposals = gsc_geditrecent_provider_real_get_proposals;
-	iface->get_name = gsc_geditrecent_provider_real_get_name;
-	iface->finish = gsc_geditrecent_provider_real_end_completion;
+	iface->get_name = gsc_geditrecent_provider_get_name;
+	iface->get_icon = gsc_geditrecent_provider_get_icon;
+	
+	iface->populate_completion = gsc_geditrecent_provider_populate_completion;
+	iface->get_capabilities = gsc_geditrecent_provider_get_capabilities;
 }
 
 
 static void gsc_geditrecent_provider_init (GscGeditrecentProvider * self)
 {
-	self->priv = g_new0(GscGeditrecentProviderPrivate, 1);
 	GtkIconTheme *theme = gtk_icon_theme_get_default();
+	
+	self->priv = GSC_GEDITRECENT_PROVIDER_GET_PRIVATE (self);
 	self->priv->icon = gtk_icon_theme_load_icon(theme,GTK_STOCK_FILE,16,0,NULL);
+	self->priv->max_recent = DEFAULT_MAX_RECENT;
+	self->priv->heap = g_new (GtkRecentInfo *, DEFAULT_MAX_RECENT);
+	self->priv->manager = gtk_recent_manager_get_default ();
+	g_signal_connect (self->priv->manager, "changed",
+			  G_CALLBACK (recent_changed_cb), self);
 }
 
-GType gsc_geditrecent_provider_get_type ()
-{
-	static GType g_define_type_id = 0;
-	if (G_UNLIKELY (g_define_type_id == 0)) {
-		static const GTypeInfo g_define_type_info = { sizeof (GscGeditrecentProviderClass), (GBaseInitFunc) NULL, (GBaseFinalizeFunc) NULL, (GClassInitFunc) gsc_geditrecent_provider_class_init, (GClassFinalizeFunc) NULL, NULL, sizeof (GscGeditrecentProvider), 0, (GInstanceInitFunc) gsc_geditrecent_provider_init };
-		g_define_type_id = g_type_register_static (G_TYPE_OBJECT, "GscGeditrecentProvider", &g_define_type_info, 0);
-		static const GInterfaceInfo gsc_manager_provider_info = { (GInterfaceInitFunc) gsc_geditrecent_provider_gsc_manager_provider_interface_init, (GInterfaceFinalizeFunc) NULL, NULL};
-		g_type_add_interface_static (g_define_type_id, GSC_TYPE_PROVIDER, &gsc_manager_provider_info);
-	}
-	return g_define_type_id;
-}
-
-
 GscGeditrecentProvider*
 gsc_geditrecent_provider_new(GeditWindow *window)
 {
-	GscGeditrecentProvider *self = GSC_GEDITRECENT_PROVIDER (g_object_new (TYPE_GSC_GEDITRECENT_PROVIDER, NULL));
+	GscGeditrecentProvider *self;
+	
+	g_return_val_if_fail (GEDIT_IS_WINDOW (window), NULL);
+	
+	self = g_object_new (TYPE_GSC_GEDITRECENT_PROVIDER, NULL);
 	self->priv->window = window;
 	return self;
 }
 
+void
+gsc_geditrecent_provider_set_max_recent(GscGeditrecentProvider *self, guint max_recent)
+{
+	if (self->priv->max_recent == max_recent)
+		return;
+
+	clear_heap (self);
+	clear_proposals (self);
+	self->priv->max_recent = max_recent;
+	self->priv->heap = g_renew (GtkRecentInfo *, self->priv->heap, MAX (max_recent, 1));
+	g_object_notify (G_OBJECT (self), "max-recent");
+}
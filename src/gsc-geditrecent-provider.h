@@ -52,11 +52,15 @@ struct _GscGeditrecentProviderClass {
 	GObjectClass parent;
 };
 
-GType gsc_geditrecent_provider_get_type ();
+GType gsc_geditrecent_provider_get_type (void) G_GNUC_CONST;
 
 GscGeditrecentProvider* 
 gsc_geditrecent_provider_new(GeditWindow *window);
 
+/* Sets how many recent files are proposed, the "max-recent" property */
+void
+gsc_geditrecent_provider_set_max_recent(GscGeditrecentProvider *self, guint max_recent);
+
 G_END_DECLS
 
 #endif
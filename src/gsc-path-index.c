@@ -0,0 +1,750 @@
+/*
+ *  gsc-path-index.c - Trigram index of file paths
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "gsc-path-index.h"
+
+/* The index is rebuilt once this many paths (and half of them) are removed */
+#define COMPACT_PATHS 1024
+
+/* The longest query compared with the paths */
+#define MAX_QUERY 64
+
+/* Query separators, ignored by the match */
+#define QUERY_SEPARATORS "/ \t"
+
+typedef struct _PathEntry PathEntry;
+typedef struct _PostingList PostingList;
+
+struct _PathEntry
+{
+	/* In the string chunk */
+	const gchar *path;
+	/* Offset of the file name in path */
+	guint32 basename;
+	/* GscPathSource flags, 0 once removed */
+	guint32 sources;
+	/* Characters in the path, see get_char_mask */
+	guint64 chars;
+};
+
+struct _PostingList
+{
+	const guint32 *ids;
+	guint len;
+	/* First id not checked yet */
+	guint pos;
+};
+
+struct _GscPathIndex
+{
+	GStringChunk *strings;
+	/* PathEntry. The id of a path is its position. */
+	GArray *entries;
+	/* Entries removed but still in the arrays */
+	guint n_dead;
+	/* Path -> id + 1 */
+	GHashTable *ids;
+	/* Packed lowercase trigram -> GArray of ids, ascending */
+	GHashTable *postings;
+	/* Trigrams of the path or query being processed */
+	GArray *trigrams;
+};
+
+static void
+free_ids (gpointer data)
+{
+	g_array_free ((GArray *) data, TRUE);
+}
+
+static gint
+compare_trigrams (gconstpointer a,
+		  gconstpointer b)
+{
+	guint32 ta = *(const guint32 *) a;
+	guint32 tb = *(const guint32 *) b;
+
+	return ta < tb ? -1 : ta > tb;
+}
+
+/*
+ * Stores in index->trigrams the sorted distinct trigrams of text. The
+ * trigrams with a separator are skipped.
+ */
+static void
+get_trigrams (GscPathIndex *index,
+	      const gchar *text,
+	      const gchar *separators)
+{
+	guint32 tri;
+	guint32 *values;
+	guint len = strlen (text);
+	guint i;
+	guint j;
+
+	g_array_set_size (index->trigrams, 0);
+
+	for (i = 0; i + 2 < len; i++)
+	{
+		if (strchr (separators, text[i]) ||
+		    strchr (separators, text[i + 1]) ||
+		    strchr (separators, text[i + 2]))
+			continue;
+
+		tri = (guint32) (guint8) g_ascii_tolower (text[i]) << 16 |
+		      (guint32) (guint8) g_ascii_tolower (text[i + 1]) << 8 |
+		      (guint32) (guint8) g_ascii_tolower (text[i + 2]);
+		g_array_append_val (index->trigrams, tri);
+	}
+
+	if (index->trigrams->len < 2)
+		return;
+
+	g_array_sort (index->trigrams, compare_trigrams);
+
+	values = (guint32 *) index->trigrams->data;
+	for (i = 1, j = 1; i < index->trigrams->len; i++)
+	{
+		if (values[i] != values[j - 1])
+			values[j++] = values[i];
+	}
+	g_array_set_size (index->trigrams, j);
+}
+
+/*
+ * One bit per letter or digit, ignoring the case, and one for the rest.
+ * A path can only match the queries whose mask is in its own.
+ */
+static guint64
+get_char_mask (const gchar *text)
+{
+	guint64 mask = 0;
+	gchar c;
+
+	for (; *text != '\0'; text++)
+	{
+		c = g_ascii_tolower (*text);
+
+		if (c >= 'a' && c <= 'z')
+			mask |= G_GUINT64_CONSTANT (1) << (c - 'a');
+		else if (c >= '0' && c <= '9')
+			mask |= G_GUINT64_CONSTANT (1) << (26 + c - '0');
+		else
+			mask |= G_GUINT64_CONSTANT (1) << 36;
+	}
+
+	return mask;
+}
+
+/*
+ * Only the file name and its directory are indexed: the upper
+ * directories are shared by many paths and would make long lists
+ */
+static const gchar *
+get_indexed_part (const gchar *path,
+		  guint basename)
+{
+	const gchar *p = path + basename;
+
+	if (p > path)
+		p--;
+
+	while (p > path && p[-1] != '/')
+		p--;
+
+	return p;
+}
+
+/*
+ * The last two components of a query, which can be in the indexed part of
+ * a path. The upper directories are only checked by score_path.
+ */
+static const gchar *
+get_query_part (const gchar *query)
+{
+	const gchar *p = query + strlen (query);
+	guint n_slashes = 0;
+
+	while (p > query)
+	{
+		if (p[-1] == '/' && ++n_slashes == 2)
+			break;
+		p--;
+	}
+
+	return p;
+}
+
+static void
+index_path (GscPathIndex *index,
+	    guint32 id)
+{
+	PathEntry *entry = &g_array_index (index->entries, PathEntry, id);
+	GArray *ids;
+	guint32 tri;
+	guint i;
+
+	get_trigrams (index,
+		      get_indexed_part (entry->path, entry->basename),
+		      "/");
+
+	for (i = 0; i < index->trigrams->len; i++)
+	{
+		tri = g_array_index (index->trigrams, guint32, i);
+		ids = g_hash_table_lookup (index->postings, GUINT_TO_POINTER (tri));
+
+		if (ids == NULL)
+		{
+			ids = g_array_new (FALSE, FALSE, sizeof (guint32));
+			g_hash_table_insert (index->postings,
+					     GUINT_TO_POINTER (tri),
+					     ids);
+		}
+
+		/* The ids grow, the lists stay sorted */
+		g_array_append_val (ids, id);
+	}
+}
+
+static void
+insert_path (GscPathIndex *index,
+	     const gchar *path,
+	     guint sources)
+{
+	PathEntry entry;
+	const gchar *slash;
+	guint32 id;
+
+	entry.path = g_string_chunk_insert (index->strings, path);
+	slash = strrchr (entry.path, '/');
+	entry.basename = slash != NULL ? slash - entry.path + 1 : 0;
+	entry.sources = sources;
+	entry.chars = get_char_mask (entry.path);
+
+	id = index->entries->len;
+	g_array_append_val (index->entries, entry);
+	g_hash_table_insert (index->ids,
+			     (gpointer) entry.path,
+			     GUINT_TO_POINTER (id + 1));
+
+	index_path (index, id);
+}
+
+/*
+ * Moves the live paths to new arrays. The removed ones stay in the
+ * posting lists and in the strings until then.
+ */
+static void
+compact (GscPathIndex *index)
+{
+	GStringChunk *strings = index->strings;
+	GArray *entries = index->entries;
+	PathEntry *entry;
+	guint i;
+
+	index->strings = g_string_chunk_new (64 * 1024);
+	index->entries = g_array_new (FALSE, FALSE, sizeof (PathEntry));
+	index->n_dead = 0;
+	g_hash_table_remove_all (index->ids);
+	g_hash_table_remove_all (index->postings);
+
+	for (i = 0; i < entries->len; i++)
+	{
+		entry = &g_array_index (entries, PathEntry, i);
+		if (entry->sources != 0)
+			insert_path (index, entry->path, entry->sources);
+	}
+
+	g_array_free (entries, TRUE);
+	g_string_chunk_free (strings);
+}
+
+static void
+remove_source (GscPathIndex *index,
+	       PathEntry *entry,
+	       guint source)
+{
+	if ((entry->sources & source) == 0)
+		return;
+
+	entry->sources &= ~source;
+
+	if (entry->sources == 0)
+	{
+		g_hash_table_remove (index->ids, entry->path);
+		index->n_dead++;
+	}
+}
+
+static void
+check_compact (GscPathIndex *index)
+{
+	if (index->n_dead > COMPACT_PATHS &&
+	    index->n_dead > index->entries->len / 2)
+		compact (index);
+}
+
+static gboolean
+is_word_start (const gchar *path,
+	       guint pos)
+{
+	gchar prev;
+
+	if (pos == 0)
+		return TRUE;
+
+	prev = path[pos - 1];
+
+	return prev == '/' || prev == '_' || prev == '-' || prev == '.' ||
+	       prev == ' ' ||
+	       (g_ascii_islower (prev) && g_ascii_isupper (path[pos]));
+}
+
+/*
+ * Matches the lowercase pattern as a subsequence of the path, from its
+ * end so the file name is preferred. Returns FALSE if it does not match.
+ */
+static gboolean
+score_path (const PathEntry *entry,
+	    const gchar *pattern,
+	    guint pattern_len,
+	    gint *result)
+{
+	const gchar *path = entry->path;
+	gint path_len = strlen (path);
+	gint pos = path_len;
+	gint last = -1;
+	gint score = 0;
+	gint i;
+
+	for (i = pattern_len - 1; i >= 0; i--)
+	{
+		do
+			pos--;
+		while (pos >= 0 && g_ascii_tolower (path[pos]) != pattern[i]);
+
+		if (pos < 0)
+			return FALSE;
+
+		score += 1;
+
+		if (pos + 1 == last)
+			score += 4;
+
+		if (is_word_start (path, pos))
+			score += 6;
+
+		if ((guint) pos >= entry->basename)
+			score += 2;
+
+		last = pos;
+	}
+
+	/* The shorter file names and paths first */
+	score -= (path_len - (gint) entry->basename - (gint) pattern_len) / 2;
+	score -= path_len / 16;
+
+	if (entry->sources & GSC_PATH_SOURCE_OPEN)
+		score += 8;
+	if (entry->sources & GSC_PATH_SOURCE_RECENT)
+		score += 4;
+
+	*result = score;
+	return TRUE;
+}
+
+/* The worst match is kept in matches[0] */
+static void
+heap_sift_down (GscPathMatch *matches,
+		guint n,
+		guint i)
+{
+	GscPathMatch tmp;
+	guint child;
+
+	while ((child = 2 * i + 1) < n)
+	{
+		if (child + 1 < n && matches[child + 1].score < matches[child].score)
+			child++;
+
+		if (matches[i].score <= matches[child].score)
+			break;
+
+		tmp = matches[i];
+		matches[i] = matches[child];
+		matches[child] = tmp;
+		i = child;
+	}
+}
+
+static void
+heap_sift_up (GscPathMatch *matches,
+	      guint i)
+{
+	GscPathMatch tmp;
+	guint parent;
+
+	while (i > 0)
+	{
+		parent = (i - 1) / 2;
+
+		if (matches[parent].score <= matches[i].score)
+			break;
+
+		tmp = matches[i];
+		matches[i] = matches[parent];
+		matches[parent] = tmp;
+		i = parent;
+	}
+}
+
+static gint
+compare_matches (gconstpointer a,
+		 gconstpointer b)
+{
+	const GscPathMatch *ma = a;
+	const GscPathMatch *mb = b;
+
+	if (ma->score != mb->score)
+		return mb->score - ma->score;
+
+	return strcmp (ma->path, mb->path);
+}
+
+static gint
+compare_lists (gconstpointer a,
+	       gconstpointer b)
+{
+	const PostingList *la = a;
+	const PostingList *lb = b;
+
+	return la->len < lb->len ? -1 : la->len > lb->len;
+}
+
+/*
+ * Moves the list to the first id greater than or equal to id. Returns
+ * TRUE if it is id.
+ */
+static gboolean
+list_seek (PostingList *list,
+	   guint32 id)
+{
+	guint lo = list->pos;
+	guint hi = list->len;
+	guint step = 1;
+	guint mid;
+
+	/* Gallop, the ids looked for grow */
+	while (lo + step < hi && list->ids[lo + step] < id)
+	{
+		lo += step;
+		step *= 2;
+	}
+	hi = MIN (hi, lo + step + 1);
+
+	while (lo < hi)
+	{
+		mid = (lo + hi) / 2;
+
+		if (list->ids[mid] < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	list->pos = lo;
+
+	return lo < list->len && list->ids[lo] == id;
+}
+
+static void
+add_match (GscPathMatch *matches,
+	   guint *n_matches,
+	   guint max_matches,
+	   const PathEntry *entry,
+	   gint score)
+{
+	GscPathMatch *match;
+
+	if (*n_matches < max_matches)
+	{
+		match = &matches[*n_matches];
+		match->path = entry->path;
+		match->sources = entry->sources;
+		match->score = score;
+		heap_sift_up (matches, (*n_matches)++);
+	}
+	else if (score > matches[0].score)
+	{
+		matches[0].path = entry->path;
+		matches[0].sources = entry->sources;
+		matches[0].score = score;
+		heap_sift_down (matches, max_matches, 0);
+	}
+}
+
+GscPathIndex *
+gsc_path_index_new (void)
+{
+	GscPathIndex *index = g_slice_new (GscPathIndex);
+
+	index->strings = g_string_chunk_new (64 * 1024);
+	index->entries = g_array_new (FALSE, FALSE, sizeof (PathEntry));
+	index->n_dead = 0;
+	index->ids = g_hash_table_new (g_str_hash, g_str_equal);
+	index->postings = g_hash_table_new_full (g_direct_hash,
+						 g_direct_equal,
+						 NULL,
+						 free_ids);
+	index->trigrams = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	return index;
+}
+
+void
+gsc_path_index_free (GscPathIndex *index)
+{
+	g_hash_table_destroy (index->postings);
+	g_hash_table_destroy (index->ids);
+	g_array_free (index->entries, TRUE);
+	g_array_free (index->trigrams, TRUE);
+	g_string_chunk_free (index->strings);
+	g_slice_free (GscPathIndex, index);
+}
+
+void
+gsc_path_index_add (GscPathIndex *index,
+		    const gchar *path,
+		    GscPathSource source)
+{
+	guint id;
+
+	g_return_if_fail (path != NULL);
+
+	id = GPOINTER_TO_UINT (g_hash_table_lookup (index->ids, path));
+
+	if (id != 0)
+		g_array_index (index->entries, PathEntry, id - 1).sources |= source;
+	else
+		insert_path (index, path, source);
+}
+
+void
+gsc_path_index_remove (GscPathIndex *index,
+		       const gchar *path,
+		       GscPathSource source)
+{
+	guint id;
+
+	id = GPOINTER_TO_UINT (g_hash_table_lookup (index->ids, path));
+	if (id == 0)
+		return;
+
+	remove_source (index,
+		       &g_array_index (index->entries, PathEntry, id - 1),
+		       source);
+	check_compact (index);
+}
+
+void
+gsc_path_index_remove_dir (GscPathIndex *index,
+			   const gchar *dir,
+			   GscPathSource source)
+{
+	PathEntry *entry;
+	guint len = strlen (dir);
+	guint i;
+
+	while (len > 0 && dir[len - 1] == '/')
+		len--;
+
+	for (i = 0; i < index->entries->len; i++)
+	{
+		entry = &g_array_index (index->entries, PathEntry, i);
+
+		if (strncmp (entry->path, dir, len) == 0 &&
+		    entry->path[len] == '/')
+			remove_source (index, entry, source);
+	}
+
+	check_compact (index);
+}
+
+void
+gsc_path_index_clear_source (GscPathIndex *index,
+			     GscPathSource source)
+{
+	guint i;
+
+	for (i = 0; i < index->entries->len; i++)
+		remove_source (index,
+			       &g_array_index (index->entries, PathEntry, i),
+			       source);
+
+	check_compact (index);
+}
+
+guint
+gsc_path_index_get_n_paths (GscPathIndex *index)
+{
+	return index->entries->len - index->n_dead;
+}
+
+/*
+ * Compares every path with the pattern. The trigrams are skipped, so the
+ * letters of the pattern may be anywhere in the path.
+ */
+static guint
+query_all (GscPathIndex *index,
+	   const gchar *pattern,
+	   guint len,
+	   GscPathMatch *matches,
+	   guint max_matches)
+{
+	PathEntry *entry;
+	guint64 mask = get_char_mask (pattern);
+	guint n_matches = 0;
+	guint32 id;
+	gint score;
+
+	for (id = 0; id < index->entries->len; id++)
+	{
+		entry = &g_array_index (index->entries, PathEntry, id);
+
+		if (entry->sources == 0 || (entry->chars & mask) != mask)
+			continue;
+
+		if (score_path (entry, pattern, len, &score))
+			add_match (matches, &n_matches, max_matches, entry, score);
+	}
+
+	return n_matches;
+}
+
+/*
+ * Compares the pattern with the paths having all the trigrams of the
+ * query, intersecting their lists from the shortest one
+ */
+static guint
+query_trigrams (GscPathIndex *index,
+		const gchar *pattern,
+		guint len,
+		GscPathMatch *matches,
+		guint max_matches)
+{
+	PostingList *lists;
+	PathEntry *entry;
+	GArray *ids;
+	guint n_lists = index->trigrams->len;
+	guint n_matches = 0;
+	guint32 id;
+	guint i;
+	guint j;
+	gint score;
+
+	lists = g_new (PostingList, n_lists);
+
+	for (i = 0; i < n_lists; i++)
+	{
+		ids = g_hash_table_lookup (index->postings,
+					   GUINT_TO_POINTER (g_array_index (index->trigrams, guint32, i)));
+
+		/* No path has this trigram */
+		if (ids == NULL)
+		{
+			g_free (lists);
+			return 0;
+		}
+
+		lists[i].ids = (const guint32 *) ids->data;
+		lists[i].len = ids->len;
+		lists[i].pos = 0;
+	}
+
+	qsort (lists, n_lists, sizeof (PostingList), compare_lists);
+
+	for (i = 0; i < lists[0].len; i++)
+	{
+		id = lists[0].ids[i];
+
+		for (j = 1; j < n_lists; j++)
+		{
+			if (!list_seek (&lists[j], id))
+				break;
+		}
+
+		if (j < n_lists)
+			continue;
+
+		entry = &g_array_index (index->entries, PathEntry, id);
+		if (entry->sources == 0)
+			continue;
+
+		if (score_path (entry, pattern, len, &score))
+			add_match (matches, &n_matches, max_matches, entry, score);
+	}
+
+	g_free (lists);
+
+	return n_matches;
+}
+
+guint
+gsc_path_index_query (GscPathIndex *index,
+		      const gchar *query,
+		      GscPathMatch *matches,
+		      guint max_matches)
+{
+	gchar pattern[MAX_QUERY + 1];
+	guint n_matches = 0;
+	guint len = 0;
+	guint i;
+
+	if (max_matches == 0)
+		return 0;
+
+	for (i = 0; query[i] != '\0' && len < MAX_QUERY; i++)
+	{
+		if (strchr (QUERY_SEPARATORS, query[i]) == NULL)
+			pattern[len++] = g_ascii_tolower (query[i]);
+	}
+	pattern[len] = '\0';
+
+	if (len == 0)
+		return 0;
+
+	get_trigrams (index, get_query_part (query), QUERY_SEPARATORS);
+
+	if (index->trigrams->len > 0)
+		n_matches = query_trigrams (index, pattern, len,
+					    matches, max_matches);
+
+	/*
+	 * The query may be an abbreviation (its trigrams are not in the
+	 * paths) or too short for the trigrams
+	 */
+	if (n_matches == 0)
+		n_matches = query_all (index, pattern, len,
+				       matches, max_matches);
+
+	qsort (matches, n_matches, sizeof (GscPathMatch), compare_matches);
+
+	return n_matches;
+}
@@ -0,0 +1,112 @@
+/*
+ *  gsc-path-index.h - Trigram index of file paths
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __PATH_INDEX_H__
+#define __PATH_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GscPathSource:
+ * @GSC_PATH_SOURCE_OPEN: The file is open in a tab
+ * @GSC_PATH_SOURCE_RECENT: The file is in the gedit recent files
+ * @GSC_PATH_SOURCE_PROJECT: The file has been found in the project
+ * directory
+ *
+ * Where a path comes from. A path stays in the index while it has a
+ * source.
+ */
+typedef enum
+{
+	GSC_PATH_SOURCE_OPEN = 1 << 0,
+	GSC_PATH_SOURCE_RECENT = 1 << 1,
+	GSC_PATH_SOURCE_PROJECT = 1 << 2
+} GscPathSource;
+
+typedef struct _GscPathIndex GscPathIndex;
+typedef struct _GscPathMatch GscPathMatch;
+
+/*
+ * A path found by gsc_path_index_query. The path is valid until the
+ * index is modified.
+ */
+struct _GscPathMatch
+{
+	const gchar *path;
+	guint sources;
+	gint score;
+};
+
+/**
+ * gsc_path_index_new:
+ *
+ * Creates an empty index. The trigrams of the file name and of the
+ * directory of every path are indexed, so a query is only compared with
+ * the paths having all its trigrams.
+ *
+ * Returns: A new #GscPathIndex
+ */
+GscPathIndex	*gsc_path_index_new		(void);
+
+void		 gsc_path_index_free		(GscPathIndex *index);
+
+void		 gsc_path_index_add		(GscPathIndex *index,
+						 const gchar *path,
+						 GscPathSource source);
+
+void		 gsc_path_index_remove		(GscPathIndex *index,
+						 const gchar *path,
+						 GscPathSource source);
+
+/* Removes source from the paths inside dir */
+void		 gsc_path_index_remove_dir	(GscPathIndex *index,
+						 const gchar *dir,
+						 GscPathSource source);
+
+/* Removes source from all the paths */
+void		 gsc_path_index_clear_source	(GscPathIndex *index,
+						 GscPathSource source);
+
+guint		 gsc_path_index_get_n_paths	(GscPathIndex *index);
+
+/**
+ * gsc_path_index_query:
+ * @index: The #GscPathIndex
+ * @query: What the user typed
+ * @matches: Where the best matches are stored
+ * @max_matches: Size of @matches
+ *
+ * Finds the paths where the characters of @query appear in order,
+ * ignoring the case. The paths with every trigram of @query in their
+ * file name or directory name are compared first, all the paths only
+ * when none of them matches. The matches in the file name, at the
+ * beginning of the words and consecutive ones score more, the long paths
+ * less.
+ *
+ * Returns: The number of matches stored, best first
+ */
+guint		 gsc_path_index_query		(GscPathIndex *index,
+						 const gchar *query,
+						 GscPathMatch *matches,
+						 guint max_matches);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,877 @@
+/*
+ *  gsc-project-crawler.c - Lists and watches the files of a project
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+#include "gsc-project-crawler.h"
+
+/* Paths sent to the main loop at once */
+#define BATCH_SIZE 512
+
+/* Milliseconds between two looks at the paths found by the thread */
+#define DRAIN_INTERVAL 20
+
+/* Milliseconds the main loop may spend on them every time */
+#define DRAIN_BUDGET 8
+
+/* Directories deeper under the root are not listed */
+#define MAX_DEPTH 24
+
+#ifdef HAVE_SYS_INOTIFY_H
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+		      IN_CLOSE_WRITE | IN_ONLYDIR | IN_DONT_FOLLOW)
+#endif
+
+typedef struct _Batch Batch;
+typedef struct _Listener Listener;
+
+/*
+ * Found by the thread. A directory is crawled by a job: its last batch
+ * tells the job is over.
+ */
+struct _Batch
+{
+	GPtrArray *files;
+	/* To watch */
+	GPtrArray *dirs;
+	gboolean last;
+};
+
+struct _Listener
+{
+	GscProjectCrawlerFunc func;
+	gpointer user_data;
+	/* Files listed before the listener was added, given to it by the
+	   drain. NULL once they all have been. */
+	GPtrArray *replay;
+};
+
+struct _GscProjectCrawler
+{
+	gchar *root;
+	guint max_files;
+	guint ref_count;
+	/* Listener */
+	GList *listeners;
+	/* The files listed and not removed since, to tell the listeners
+	   added late */
+	GHashTable *files;
+
+	GThread *thread;
+	/* Directories to crawl. The crawler itself stops the thread. */
+	GAsyncQueue *jobs;
+	/* Batches found by the thread */
+	GAsyncQueue *results;
+	gint cancelled;
+	/* Only used by the thread */
+	guint n_files;
+
+	/* Jobs not finished yet */
+	guint n_jobs;
+	guint drain_id;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	gint inotify_fd;
+	GIOChannel *channel;
+	guint watch_id;
+	/* Watch descriptor -> directory */
+	GHashTable *watches;
+	/* No more watches can be added */
+	gboolean watches_full;
+#endif
+};
+
+/* Root -> its GscProjectCrawler, shared by all the listeners */
+static GHashTable *crawlers = NULL;
+
+static Batch *
+batch_new (void)
+{
+	Batch *batch = g_slice_new (Batch);
+
+	batch->files = g_ptr_array_new ();
+	batch->dirs = g_ptr_array_new ();
+	batch->last = FALSE;
+
+	return batch;
+}
+
+static void
+batch_free (Batch *batch)
+{
+	g_ptr_array_foreach (batch->files, (GFunc) g_free, NULL);
+	g_ptr_array_foreach (batch->dirs, (GFunc) g_free, NULL);
+	g_ptr_array_free (batch->files, TRUE);
+	g_ptr_array_free (batch->dirs, TRUE);
+	g_slice_free (Batch, batch);
+}
+
+static gboolean
+is_hidden (const gchar *name)
+{
+	return name[0] == '.';
+}
+
+/*
+ * Returns the type of a directory entry, without following the links to
+ * directories
+ */
+static gint
+get_entry_type (const gchar *path,
+		struct dirent *entry)
+{
+	struct stat info;
+
+#ifdef _DIRENT_HAVE_D_TYPE
+	if (entry->d_type == DT_DIR || entry->d_type == DT_REG)
+		return entry->d_type;
+
+	if (entry->d_type == DT_LNK)
+	{
+		/* A link to a file is listed as the file */
+		if (stat (path, &info) == 0 && S_ISREG (info.st_mode))
+			return DT_REG;
+		return DT_UNKNOWN;
+	}
+#endif
+
+	if (lstat (path, &info) != 0)
+		return DT_UNKNOWN;
+
+	if (S_ISDIR (info.st_mode))
+		return DT_DIR;
+
+	if (S_ISREG (info.st_mode) ||
+	    (S_ISLNK (info.st_mode) && stat (path, &info) == 0 &&
+	     S_ISREG (info.st_mode)))
+		return DT_REG;
+
+	return DT_UNKNOWN;
+}
+
+/*
+ * Number of directories between the root and path
+ */
+static guint
+get_depth (GscProjectCrawler *crawler,
+	   const gchar *path)
+{
+	const gchar *p = path + strlen (crawler->root);
+	guint depth = 0;
+
+	for (; *p != '\0'; p++)
+	{
+		if (*p == G_DIR_SEPARATOR)
+			depth++;
+	}
+
+	return depth;
+}
+
+static void
+send_batch (GscProjectCrawler *crawler,
+	    Batch **batch)
+{
+	g_async_queue_push (crawler->results, *batch);
+	*batch = batch_new ();
+}
+
+/*
+ * Lists dir and the directories under it, depth first with a stack
+ */
+static void
+crawl (GscProjectCrawler *crawler,
+       gchar *dir)
+{
+	GPtrArray *stack = g_ptr_array_new ();
+	Batch *batch = batch_new ();
+	struct dirent *entry;
+	gchar *path;
+	DIR *handle;
+
+	g_ptr_array_add (stack, dir);
+
+	while (stack->len > 0 && !g_atomic_int_get (&crawler->cancelled))
+	{
+		dir = g_ptr_array_remove_index (stack, stack->len - 1);
+		handle = opendir (dir);
+
+		if (handle == NULL)
+		{
+			g_free (dir);
+			continue;
+		}
+
+		g_ptr_array_add (batch->dirs, dir);
+
+		while ((entry = readdir (handle)) != NULL)
+		{
+			if (is_hidden (entry->d_name))
+				continue;
+
+			if (crawler->n_files >= crawler->max_files)
+				break;
+
+			path = g_build_filename (dir, entry->d_name, NULL);
+
+			switch (get_entry_type (path, entry))
+			{
+				case DT_DIR:
+					if (get_depth (crawler, path) <= MAX_DEPTH)
+						g_ptr_array_add (stack, path);
+					else
+						g_free (path);
+					break;
+				case DT_REG:
+					g_ptr_array_add (batch->files, path);
+					crawler->n_files++;
+					break;
+				default:
+					g_free (path);
+			}
+
+			if (batch->files->len >= BATCH_SIZE)
+				send_batch (crawler, &batch);
+		}
+
+		closedir (handle);
+
+		if (batch->dirs->len >= BATCH_SIZE)
+			send_batch (crawler, &batch);
+	}
+
+	g_ptr_array_foreach (stack, (GFunc) g_free, NULL);
+	g_ptr_array_free (stack, TRUE);
+
+	batch->last = TRUE;
+	g_async_queue_push (crawler->results, batch);
+}
+
+static gpointer
+crawler_thread (gpointer data)
+{
+	GscProjectCrawler *crawler = data;
+	gchar *dir;
+
+	/* The crawler pushes itself to stop the thread */
+	while ((dir = g_async_queue_pop (crawler->jobs)) != (gpointer) crawler)
+	{
+		if (g_atomic_int_get (&crawler->cancelled))
+		{
+			g_free (dir);
+			continue;
+		}
+
+		/* The whole tree is listed again */
+		if (strcmp (dir, crawler->root) == 0)
+			crawler->n_files = 0;
+
+		crawl (crawler, dir);
+	}
+
+	return NULL;
+}
+
+static gboolean
+is_inside (const gchar *path,
+	   const gchar *dir)
+{
+	gsize len = strlen (dir);
+
+	return strncmp (path, dir, len) == 0 &&
+	       (path[len] == '\0' || path[len] == G_DIR_SEPARATOR);
+}
+
+/*
+ * Keeps the files listed up to date and tells all the listeners
+ */
+static void
+emit (GscProjectCrawler *crawler,
+      GscProjectCrawlerEvent event,
+      const gchar *path)
+{
+	GHashTableIter iter;
+	gpointer file;
+	Listener *listener;
+	GList *l;
+
+	switch (event)
+	{
+		case GSC_PROJECT_CRAWLER_FILE_ADDED:
+			file = g_strdup (path);
+			g_hash_table_replace (crawler->files, file, file);
+			break;
+		case GSC_PROJECT_CRAWLER_FILE_REMOVED:
+			g_hash_table_remove (crawler->files, path);
+			break;
+		case GSC_PROJECT_CRAWLER_DIR_REMOVED:
+			g_hash_table_iter_init (&iter, crawler->files);
+			while (g_hash_table_iter_next (&iter, &file, NULL))
+			{
+				if (is_inside (file, path))
+					g_hash_table_iter_remove (&iter);
+			}
+			break;
+		case GSC_PROJECT_CRAWLER_FILE_CHANGED:
+			break;
+	}
+
+	for (l = crawler->listeners; l != NULL; l = l->next)
+	{
+		listener = l->data;
+		listener->func (event, path, listener->user_data);
+	}
+}
+
+/*
+ * Gives the files listed before the listener was added, until end.
+ * Returns TRUE when they have all been given.
+ */
+static gboolean
+replay_files (GscProjectCrawler *crawler,
+	      Listener *listener,
+	      gint64 end)
+{
+	gchar *path;
+
+	while (listener->replay->len > 0 && g_get_monotonic_time () < end)
+	{
+		path = g_ptr_array_remove_index_fast (listener->replay,
+						      listener->replay->len - 1);
+
+		/* Removed since */
+		if (g_hash_table_lookup (crawler->files, path) != NULL)
+			listener->func (GSC_PROJECT_CRAWLER_FILE_ADDED,
+					path,
+					listener->user_data);
+		g_free (path);
+	}
+
+	if (listener->replay->len > 0)
+		return FALSE;
+
+	g_ptr_array_free (listener->replay, TRUE);
+	listener->replay = NULL;
+
+	return TRUE;
+}
+
+static void
+listener_free (Listener *listener)
+{
+	if (listener->replay != NULL)
+	{
+		g_ptr_array_foreach (listener->replay, (GFunc) g_free, NULL);
+		g_ptr_array_free (listener->replay, TRUE);
+	}
+
+	g_slice_free (Listener, listener);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+static void
+add_watch (GscProjectCrawler *crawler,
+	   const gchar *dir)
+{
+	gint wd;
+
+	if (crawler->inotify_fd < 0 || crawler->watches_full)
+		return;
+
+	wd = inotify_add_watch (crawler->inotify_fd, dir, WATCH_EVENTS);
+
+	if (wd >= 0)
+	{
+		g_hash_table_replace (crawler->watches,
+				      GINT_TO_POINTER (wd),
+				      g_strdup (dir));
+	}
+	else if (errno == ENOSPC)
+	{
+		/* Out of watches (fs.inotify.max_user_watches) */
+		crawler->watches_full = TRUE;
+	}
+}
+
+/*
+ * The watches of a directory moved away would report wrong paths
+ */
+static void
+remove_watches (GscProjectCrawler *crawler,
+		const gchar *dir)
+{
+	GHashTableIter iter;
+	gpointer wd;
+	gpointer path;
+
+	g_hash_table_iter_init (&iter, crawler->watches);
+
+	while (g_hash_table_iter_next (&iter, &wd, &path))
+	{
+		if (is_inside (path, dir))
+		{
+			inotify_rm_watch (crawler->inotify_fd, GPOINTER_TO_INT (wd));
+			g_hash_table_iter_remove (&iter);
+		}
+	}
+}
+#endif
+
+static gboolean
+drain_cb (GscProjectCrawler *crawler)
+{
+	gint64 end = g_get_monotonic_time () + DRAIN_BUDGET * 1000;
+	gboolean replayed = TRUE;
+	Listener *listener;
+	Batch *batch;
+	GList *l;
+	guint i;
+
+	for (l = crawler->listeners; l != NULL; l = l->next)
+	{
+		listener = l->data;
+		if (listener->replay != NULL &&
+		    !replay_files (crawler, listener, end))
+			replayed = FALSE;
+	}
+
+	while (g_get_monotonic_time () < end &&
+	       (batch = g_async_queue_try_pop (crawler->results)) != NULL)
+	{
+		for (i = 0; i < batch->files->len; i++)
+			emit (crawler,
+			      GSC_PROJECT_CRAWLER_FILE_ADDED,
+			      g_ptr_array_index (batch->files, i));
+
+#ifdef HAVE_SYS_INOTIFY_H
+		for (i = 0; i < batch->dirs->len; i++)
+			add_watch (crawler, g_ptr_array_index (batch->dirs, i));
+#endif
+
+		if (batch->last)
+			crawler->n_jobs--;
+
+		batch_free (batch);
+	}
+
+	if (crawler->n_jobs > 0 || g_async_queue_length (crawler->results) > 0 ||
+	    !replayed)
+		return TRUE;
+
+	crawler->drain_id = 0;
+	return FALSE;
+}
+
+static void
+start_drain (GscProjectCrawler *crawler)
+{
+	if (crawler->drain_id == 0)
+	{
+		crawler->drain_id = g_timeout_add (DRAIN_INTERVAL,
+						   (GSourceFunc) drain_cb,
+						   crawler);
+	}
+}
+
+static void
+start_job (GscProjectCrawler *crawler,
+	   const gchar *dir)
+{
+	crawler->n_jobs++;
+	g_async_queue_push (crawler->jobs, g_strdup (dir));
+	start_drain (crawler);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+static void
+handle_event (GscProjectCrawler *crawler,
+	      struct inotify_event *event)
+{
+	const gchar *dir;
+	gchar *path;
+
+	if (event->mask & IN_Q_OVERFLOW)
+	{
+		/* Events have been lost, the whole tree is listed again */
+		emit (crawler, GSC_PROJECT_CRAWLER_DIR_REMOVED, crawler->root);
+		start_job (crawler, crawler->root);
+		return;
+	}
+
+	if (event->mask & IN_IGNORED)
+	{
+		g_hash_table_remove (crawler->watches, GINT_TO_POINTER (event->wd));
+		return;
+	}
+
+	dir = g_hash_table_lookup (crawler->watches, GINT_TO_POINTER (event->wd));
+	if (dir == NULL || event->len == 0 || is_hidden (event->name))
+		return;
+
+	path = g_build_filename (dir, event->name, NULL);
+
+	if (event->mask & IN_ISDIR)
+	{
+		if (event->mask & (IN_CREATE | IN_MOVED_TO))
+		{
+			start_job (crawler, path);
+		}
+		else
+		{
+			remove_watches (crawler, path);
+			emit (crawler, GSC_PROJECT_CRAWLER_DIR_REMOVED, path);
+		}
+	}
+	else if (event->mask & (IN_CREATE | IN_MOVED_TO))
+	{
+		emit (crawler, GSC_PROJECT_CRAWLER_FILE_ADDED, path);
+	}
+	else if (event->mask & IN_CLOSE_WRITE)
+	{
+		emit (crawler, GSC_PROJECT_CRAWLER_FILE_CHANGED, path);
+	}
+	else
+	{
+		emit (crawler, GSC_PROJECT_CRAWLER_FILE_REMOVED, path);
+	}
+
+	g_free (path);
+}
+
+static gboolean
+inotify_cb (GIOChannel *channel,
+	    GIOCondition condition,
+	    GscProjectCrawler *crawler)
+{
+	/* Aligned for the events */
+	union
+	{
+		struct inotify_event event;
+		gchar data[16 * 1024];
+	} buffer;
+	struct inotify_event *event;
+	gssize len;
+	gssize i;
+
+	while ((len = read (crawler->inotify_fd, buffer.data, sizeof (buffer))) > 0)
+	{
+		for (i = 0; i < len; i += sizeof (struct inotify_event) + event->len)
+		{
+			event = (struct inotify_event *) (buffer.data + i);
+			handle_event (crawler, event);
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+init_inotify (GscProjectCrawler *crawler)
+{
+	crawler->watches = g_hash_table_new_full (g_direct_hash,
+						  g_direct_equal,
+						  NULL,
+						  g_free);
+	crawler->watches_full = FALSE;
+	crawler->channel = NULL;
+	crawler->watch_id = 0;
+	crawler->inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+
+	if (crawler->inotify_fd < 0)
+		return;
+
+	crawler->channel = g_io_channel_unix_new (crawler->inotify_fd);
+	crawler->watch_id = g_io_add_watch (crawler->channel,
+					    G_IO_IN,
+					    (GIOFunc) inotify_cb,
+					    crawler);
+}
+
+static void
+free_inotify (GscProjectCrawler *crawler)
+{
+	if (crawler->watch_id != 0)
+		g_source_remove (crawler->watch_id);
+
+	if (crawler->channel != NULL)
+		g_io_channel_unref (crawler->channel);
+
+	/* Closing it removes all the watches */
+	if (crawler->inotify_fd >= 0)
+		close (crawler->inotify_fd);
+
+	g_hash_table_destroy (crawler->watches);
+}
+#endif
+
+static GscProjectCrawler *
+crawler_new (const gchar *root,
+	     guint max_files)
+{
+	GscProjectCrawler *crawler;
+
+	crawler = g_slice_new0 (GscProjectCrawler);
+	crawler->root = g_strdup (root);
+	crawler->max_files = max_files;
+	crawler->ref_count = 1;
+	crawler->files = g_hash_table_new_full (g_str_hash,
+						g_str_equal,
+						g_free,
+						NULL);
+	crawler->jobs = g_async_queue_new ();
+	crawler->results = g_async_queue_new ();
+
+#ifdef HAVE_SYS_INOTIFY_H
+	init_inotify (crawler);
+#endif
+
+	crawler->thread = g_thread_new ("gsc-project-crawler",
+					crawler_thread,
+					crawler);
+	start_job (crawler, root);
+
+	return crawler;
+}
+
+static void
+crawler_free (GscProjectCrawler *crawler)
+{
+	Batch *batch;
+	gchar *dir;
+
+	g_atomic_int_set (&crawler->cancelled, TRUE);
+	g_async_queue_push (crawler->jobs, crawler);
+	g_thread_join (crawler->thread);
+
+	while ((dir = g_async_queue_try_pop (crawler->jobs)) != NULL)
+		g_free (dir);
+
+	while ((batch = g_async_queue_try_pop (crawler->results)) != NULL)
+		batch_free (batch);
+
+	if (crawler->drain_id != 0)
+		g_source_remove (crawler->drain_id);
+
+#ifdef HAVE_SYS_INOTIFY_H
+	free_inotify (crawler);
+#endif
+
+	g_list_foreach (crawler->listeners, (GFunc) listener_free, NULL);
+	g_list_free (crawler->listeners);
+	g_hash_table_destroy (crawler->files);
+
+	g_async_queue_unref (crawler->jobs);
+	g_async_queue_unref (crawler->results);
+	g_free (crawler->root);
+	g_slice_free (GscProjectCrawler, crawler);
+}
+
+GscProjectCrawler *
+gsc_project_crawler_get_for_root (const gchar *root,
+				  guint max_files)
+{
+	GscProjectCrawler *crawler;
+
+	g_return_val_if_fail (root != NULL, NULL);
+
+	if (crawlers == NULL)
+		crawlers = g_hash_table_new (g_str_hash, g_str_equal);
+
+	crawler = g_hash_table_lookup (crawlers, root);
+	if (crawler != NULL)
+	{
+		crawler->ref_count++;
+		return crawler;
+	}
+
+	crawler = crawler_new (root, max_files);
+	g_hash_table_insert (crawlers, crawler->root, crawler);
+
+	return crawler;
+}
+
+void
+gsc_project_crawler_unref (GscProjectCrawler *crawler)
+{
+	g_return_if_fail (crawler != NULL && crawler->ref_count > 0);
+
+	if (--crawler->ref_count > 0)
+		return;
+
+	g_hash_table_remove (crawlers, crawler->root);
+	crawler_free (crawler);
+}
+
+void
+gsc_project_crawler_add_func (GscProjectCrawler *crawler,
+			      GscProjectCrawlerFunc func,
+			      gpointer user_data)
+{
+	Listener *listener;
+	GHashTableIter iter;
+	gpointer file;
+
+	g_return_if_fail (crawler != NULL);
+	g_return_if_fail (func != NULL);
+
+	listener = g_slice_new0 (Listener);
+	listener->func = func;
+	listener->user_data = user_data;
+
+	if (g_hash_table_size (crawler->files) > 0)
+	{
+		listener->replay = g_ptr_array_sized_new (g_hash_table_size (crawler->files));
+
+		g_hash_table_iter_init (&iter, crawler->files);
+		while (g_hash_table_iter_next (&iter, &file, NULL))
+			g_ptr_array_add (listener->replay, g_strdup (file));
+
+		start_drain (crawler);
+	}
+
+	crawler->listeners = g_list_append (crawler->listeners, listener);
+}
+
+void
+gsc_project_crawler_remove_func (GscProjectCrawler *crawler,
+				 GscProjectCrawlerFunc func,
+				 gpointer user_data)
+{
+	Listener *listener;
+	GList *l;
+
+	g_return_if_fail (crawler != NULL);
+
+	for (l = crawler->listeners; l != NULL; l = l->next)
+	{
+		listener = l->data;
+		if (listener->func == func && listener->user_data == user_data)
+		{
+			crawler->listeners = g_list_delete_link (crawler->listeners, l);
+			listener_free (listener);
+			return;
+		}
+	}
+}
+
+const gchar *
+gsc_project_crawler_get_root (GscProjectCrawler *crawler)
+{
+	return crawler->root;
+}
+
+static gboolean
+has_marker (const gchar *dir,
+	    const gchar *marker)
+{
+	gchar *path = g_build_filename (dir, marker, NULL);
+	gboolean found = g_file_test (path, G_FILE_TEST_IS_DIR);
+
+	g_free (path);
+
+	return found;
+}
+
+/*
+ * Looks for the version control directory above dir. Returns NULL if
+ * there is none.
+ */
+static gchar *
+find_checkout (const gchar *dir)
+{
+	static const gchar *markers[] = { ".git", ".hg", ".bzr", NULL };
+	gchar *current = g_strdup (dir);
+	gchar *parent;
+	guint i;
+
+	while (TRUE)
+	{
+		for (i = 0; markers[i] != NULL; i++)
+		{
+			if (has_marker (current, markers[i]))
+				return current;
+		}
+
+		/* Subversion keeps a .svn in every directory of old
+		   checkouts, the top one is the project */
+		if (has_marker (current, ".svn"))
+		{
+			parent = g_path_get_dirname (current);
+			while (strcmp (parent, current) != 0 && has_marker (parent, ".svn"))
+			{
+				g_free (current);
+				current = parent;
+				parent = g_path_get_dirname (current);
+			}
+			g_free (parent);
+			return current;
+		}
+
+		parent = g_path_get_dirname (current);
+		if (strcmp (parent, current) == 0)
+		{
+			g_free (parent);
+			break;
+		}
+
+		g_free (current);
+		current = parent;
+	}
+
+	g_free (current);
+
+	return NULL;
+}
+
+gchar *
+gsc_project_crawler_find_root (const gchar *filename)
+{
+	gchar *dir = g_path_get_dirname (filename);
+	gchar *root = find_checkout (dir);
+	gchar *parent;
+
+	g_free (dir);
+
+	if (root == NULL)
+		return NULL;
+
+	/* The whole disk or the home under version control (dot files kept
+	   in git) would be listed with everything under them */
+	parent = g_path_get_dirname (root);
+	if (strcmp (parent, root) == 0 ||
+	    strcmp (root, g_get_home_dir ()) == 0)
+	{
+		g_free (root);
+		root = NULL;
+	}
+	g_free (parent);
+
+	return root;
+}
@@ -0,0 +1,110 @@
+/*
+ *  gsc-project-crawler.h - Lists and watches the files of a project
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __PROJECT_CRAWLER_H__
+#define __PROJECT_CRAWLER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GscProjectCrawlerEvent:
+ * @GSC_PROJECT_CRAWLER_FILE_ADDED: A file has been found or created
+ * @GSC_PROJECT_CRAWLER_FILE_REMOVED: A file has been deleted or moved
+ * away
+ * @GSC_PROJECT_CRAWLER_FILE_CHANGED: A file has been written
+ * @GSC_PROJECT_CRAWLER_DIR_REMOVED: A directory and all its files have
+ * been deleted or moved away
+ */
+typedef enum
+{
+	GSC_PROJECT_CRAWLER_FILE_ADDED,
+	GSC_PROJECT_CRAWLER_FILE_REMOVED,
+	GSC_PROJECT_CRAWLER_FILE_CHANGED,
+	GSC_PROJECT_CRAWLER_DIR_REMOVED
+} GscProjectCrawlerEvent;
+
+typedef struct _GscProjectCrawler GscProjectCrawler;
+
+/* Called in the main loop, path is only valid during the call */
+typedef void (*GscProjectCrawlerFunc) (GscProjectCrawlerEvent event,
+				       const gchar *path,
+				       gpointer user_data);
+
+/**
+ * gsc_project_crawler_get_for_root:
+ * @root: The project directory
+ * @max_files: Files listed at most
+ *
+ * Lists the files under @root in a thread. The hidden files and
+ * directories are skipped, the links to directories are not followed and
+ * the directories too deep under @root are not listed.
+ * The files are given to the functions added with
+ * gsc_project_crawler_add_func in the main loop, a few at a time. Where
+ * inotify is available the directories are watched afterwards and the
+ * functions are called for the files created, written and deleted.
+ *
+ * There is one crawler for every root: the callers listing the same
+ * project share it, and @max_files is the one of the first caller.
+ *
+ * Returns: A reference to the crawler of @root, drop it with
+ * gsc_project_crawler_unref
+ */
+GscProjectCrawler *gsc_project_crawler_get_for_root (const gchar *root,
+						   guint max_files);
+
+/* Stops the thread and the watches when the last reference is dropped */
+void		 gsc_project_crawler_unref	(GscProjectCrawler *crawler);
+
+/**
+ * gsc_project_crawler_add_func:
+ * @crawler: The #GscProjectCrawler
+ * @func: Called for every change
+ * @user_data: Data for @func
+ *
+ * The files already listed are given to @func first, in the main loop,
+ * as if they had just been found.
+ */
+void		 gsc_project_crawler_add_func	(GscProjectCrawler *crawler,
+						 GscProjectCrawlerFunc func,
+						 gpointer user_data);
+
+/* func is not called any more */
+void		 gsc_project_crawler_remove_func (GscProjectCrawler *crawler,
+						 GscProjectCrawlerFunc func,
+						 gpointer user_data);
+
+const gchar	*gsc_project_crawler_get_root	(GscProjectCrawler *crawler);
+
+/**
+ * gsc_project_crawler_find_root:
+ * @filename: A local file
+ *
+ * Looks for the nearest directory above @filename kept under version
+ * control (git, mercurial, bazaar or subversion). The home directory and
+ * the root directory are never projects, even under version control.
+ *
+ * Returns: The project directory, or %NULL if @filename is in no project.
+ * Free it with g_free.
+ */
+gchar		*gsc_project_crawler_find_root	(const gchar *filename);
+
+G_END_DECLS
+
+#endif
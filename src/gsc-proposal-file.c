@@ -0,0 +1,177 @@
+/*
+ *  gsc-proposal-file.c - Proposal opening a file
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gedit/gedit-commands.h>
+#include "gsc-proposal-file.h"
+
+struct _GscProposalFilePrivate
+{
+	GeditWindow *window;
+	gchar *uri;
+	gchar *query;
+};
+
+G_DEFINE_TYPE(GscProposalFile, gsc_proposal_file, GSC_TYPE_PROPOSAL);
+
+#define GSC_PROPOSAL_FILE_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), GSC_TYPE_PROPOSAL_FILE, GscProposalFilePrivate))
+
+/*
+ * Returns the tab of the window where uri is open, if any
+ */
+static GeditTab *
+find_tab (GeditWindow *window,
+	  const gchar *uri)
+{
+	GList *docs = gedit_window_get_documents (window);
+	GeditTab *tab = NULL;
+	gchar *doc_uri;
+	GList *l;
+
+	for (l = docs; l != NULL && tab == NULL; l = g_list_next (l))
+	{
+		doc_uri = gedit_document_get_uri (GEDIT_DOCUMENT (l->data));
+
+		if (doc_uri != NULL && g_str_equal (doc_uri, uri))
+			tab = gedit_tab_get_from_document (GEDIT_DOCUMENT (l->data));
+
+		g_free (doc_uri);
+	}
+
+	g_list_free (docs);
+
+	return tab;
+}
+
+/*
+ * The query is not part of the text, it is removed if it is still there
+ */
+static void
+remove_query (GscProposalFile *self,
+	      GtkTextView *view)
+{
+	GtkTextBuffer *buffer = gtk_text_view_get_buffer (view);
+	GtkTextIter start;
+	GtkTextIter end;
+	gchar *text;
+
+	gtk_text_buffer_get_iter_at_mark (buffer, &end,
+					  gtk_text_buffer_get_insert (buffer));
+	start = end;
+
+	if (!gtk_text_iter_backward_chars (&start, g_utf8_strlen (self->priv->query, -1)))
+		return;
+
+	text = gtk_text_iter_get_slice (&start, &end);
+
+	if (g_str_equal (text, self->priv->query))
+		gtk_text_buffer_delete (buffer, &start, &end);
+
+	g_free (text);
+}
+
+static gboolean
+gsc_proposal_file_apply (GscProposal *proposal,
+			 GtkTextView *view)
+{
+	GscProposalFile *self = GSC_PROPOSAL_FILE (proposal);
+	GeditTab *tab;
+
+	if (self->priv->query != NULL && view != NULL)
+		remove_query (self, view);
+
+	if (self->priv->window == NULL)
+		return TRUE;
+
+	tab = find_tab (self->priv->window, self->priv->uri);
+
+	if (tab != NULL)
+		gedit_window_set_active_tab (self->priv->window, tab);
+	else
+		gedit_commands_load_uri (self->priv->window,
+					 self->priv->uri,
+					 NULL,
+					 1);
+	return TRUE;
+}
+
+static void
+gsc_proposal_file_finalize (GObject *object)
+{
+	GscProposalFile *self = GSC_PROPOSAL_FILE (object);
+
+	if (self->priv->window != NULL)
+		g_object_remove_weak_pointer (G_OBJECT (self->priv->window),
+					      (gpointer *) &self->priv->window);
+	g_free (self->priv->uri);
+	g_free (self->priv->query);
+
+	G_OBJECT_CLASS (gsc_proposal_file_parent_class)->finalize (object);
+}
+
+static void
+gsc_proposal_file_class_init (GscProposalFileClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	GscProposalClass *proposal_class = GSC_PROPOSAL_CLASS (klass);
+
+	g_type_class_add_private (object_class, sizeof (GscProposalFilePrivate));
+
+	proposal_class->apply = gsc_proposal_file_apply;
+	object_class->finalize = gsc_proposal_file_finalize;
+}
+
+static void
+gsc_proposal_file_init (GscProposalFile *self)
+{
+	self->priv = GSC_PROPOSAL_FILE_GET_PRIVATE (self);
+}
+
+GscProposal *
+gsc_proposal_file_new (GeditWindow *window,
+		       const gchar *filename,
+		       const gchar *query,
+		       GdkPixbuf *icon)
+{
+	GscProposalFile *self;
+	gchar *name;
+	gchar *info;
+
+	g_return_val_if_fail (GEDIT_IS_WINDOW (window), NULL);
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	name = g_filename_display_basename (filename);
+	info = g_filename_display_name (filename);
+
+	self = GSC_PROPOSAL_FILE (g_object_new (GSC_TYPE_PROPOSAL_FILE,
+						"label", name,
+						"info", info,
+						"icon", icon,
+						"page-name", "Quick Open",
+						NULL));
+	self->priv->window = window;
+	g_object_add_weak_pointer (G_OBJECT (window),
+				   (gpointer *) &self->priv->window);
+	self->priv->uri = g_filename_to_uri (filename, NULL, NULL);
+	self->priv->query = g_strdup (query);
+
+	g_free (name);
+	g_free (info);
+
+	return GSC_PROPOSAL (self);
+}
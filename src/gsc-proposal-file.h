@@ -0,0 +1,74 @@
+/*
+ *  gsc-proposal-file.h - Proposal opening a file
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GSC_PROPOSAL_FILE_H__
+#define __GSC_PROPOSAL_FILE_H__
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gedit/gedit-plugin.h>
+#include <gtksourcecompletion/gsc-proposal.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GscProposalFilePrivate GscProposalFilePrivate;
+typedef struct _GscProposalFile GscProposalFile;
+typedef struct _GscProposalFileClass GscProposalFileClass;
+
+struct _GscProposalFile
+{
+	GscProposal parent;
+	GscProposalFilePrivate *priv;
+};
+
+struct _GscProposalFileClass
+{
+	GscProposalClass parent_class;
+};
+
+#define GSC_TYPE_PROPOSAL_FILE (gsc_proposal_file_get_type ())
+#define GSC_PROPOSAL_FILE(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), GSC_TYPE_PROPOSAL_FILE, GscProposalFile))
+#define GSC_PROPOSAL_FILE_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST ((klass), GSC_TYPE_PROPOSAL_FILE, GscProposalFileClass))
+#define GSC_IS_PROPOSAL_FILE(obj) (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GSC_TYPE_PROPOSAL_FILE))
+#define GSC_IS_PROPOSAL_FILE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GSC_TYPE_PROPOSAL_FILE))
+#define GSC_PROPOSAL_FILE_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), GSC_TYPE_PROPOSAL_FILE, GscProposalFileClass))
+
+GType		 gsc_proposal_file_get_type	(void) G_GNUC_CONST;
+
+/**
+ * gsc_proposal_file_new:
+ * @window: The window where the file is opened
+ * @filename: A local file
+ * @query: The text typed to find the file or %NULL
+ * @icon: The icon of the proposal or %NULL
+ *
+ * Creates a proposal labeled with the file name, showing the full path
+ * as its information. Applying it removes @query from before the cursor
+ * and opens the file, or shows its tab if it is already open.
+ *
+ * Returns: A new #GscProposal
+ */
+GscProposal	*gsc_proposal_file_new		(GeditWindow *window,
+						 const gchar *filename,
+						 const gchar *query,
+						 GdkPixbuf *icon);
+
+G_END_DECLS
+
+#endif
@@ -74,5 +74,11 @@ gsc_proposal_open_new (GeditWindow *window,
 	return GSC_PROPOSAL (self);
 }
 
+GeditDocument*
+gsc_proposal_open_get_document (GscProposalOpen *self)
+{
+	return self->priv->doc;
+}
+
 
 
@@ -56,6 +56,8 @@ GscProposal	*gsc_proposal_open_new		(GeditWindow *window,
 						 GeditDocument *doc,
 						 GdkPixbuf *icon);
 
+GeditDocument	*gsc_proposal_open_get_document	(GscProposalOpen *self);
+
 
 
 G_END_DECLS
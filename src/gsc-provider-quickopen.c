@@ -0,0 +1,572 @@
+/*
+ *  gsc-provider-quickopen.c - Proposes the files whose path matches the text
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "gsc-provider-quickopen.h"
+#include "gsc-path-index.h"
+#include "gsc-project-crawler.h"
+#include "gsc-proposal-file.h"
+#include <gtksourcecompletion/gsc-completion.h>
+#include <gtksourcecompletion/gsc-utils.h>
+
+/* Maximum number of proposals shown */
+#define MAX_PROPOSALS 50
+
+/* Shorter queries match most of the paths */
+#define MIN_QUERY_CHARS 3
+
+/* Characters looked at before the cursor for the query */
+#define MAX_QUERY_CHARS 256
+
+/* Default maximum number of files listed in a project */
+#define MAX_PROJECT_FILES 500000
+
+#define GSC_PROVIDER_QUICKOPEN_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GSC_TYPE_PROVIDER_QUICKOPEN, GscProviderQuickopenPrivate))
+
+static void	 gsc_provider_quickopen_iface_init	(GscProviderIface *iface);
+
+struct _GscProviderQuickopenPrivate
+{
+	gchar *name;
+	GdkPixbuf *icon;
+	GeditWindow *window;
+	GscPathIndex *index;
+	/* GeditDocument -> file indexed for it */
+	GHashTable *documents;
+	GtkRecentManager *recent_manager;
+	/* The recent files have changed since they were indexed */
+	gboolean recent_dirty;
+	/* Shared with the words of the project */
+	GscProjectCrawler *crawler;
+	guint max_files;
+	GscPathMatch matches[MAX_PROPOSALS];
+};
+
+G_DEFINE_TYPE_WITH_CODE (GscProviderQuickopen,
+			 gsc_provider_quickopen,
+			 G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (GSC_TYPE_PROVIDER,
+				 		gsc_provider_quickopen_iface_init))
+
+static void	 document_finalized_cb	(GscProviderQuickopen *self,
+					 GObject *doc);
+
+/*
+ * Returns the local file of the document, NULL if it has none
+ */
+static gchar *
+get_document_file (GeditDocument *doc)
+{
+	gchar *uri;
+	gchar *filename;
+
+	if (doc == NULL || !gedit_document_is_local (doc))
+		return NULL;
+
+	uri = gedit_document_get_uri (doc);
+	if (uri == NULL)
+		return NULL;
+
+	filename = g_filename_from_uri (uri, NULL, NULL);
+	g_free (uri);
+
+	return filename;
+}
+
+/*
+ * Indexes filename (owned) as the file of doc instead of the old one
+ */
+static void
+set_document_file (GscProviderQuickopen *self,
+		   GeditDocument *doc,
+		   gchar *filename)
+{
+	const gchar *old = g_hash_table_lookup (self->priv->documents, doc);
+
+	if (old != NULL && filename != NULL && strcmp (old, filename) == 0)
+	{
+		g_free (filename);
+		return;
+	}
+
+	if (old != NULL)
+		gsc_path_index_remove (self->priv->index, old, GSC_PATH_SOURCE_OPEN);
+
+	if (filename != NULL)
+		gsc_path_index_add (self->priv->index, filename, GSC_PATH_SOURCE_OPEN);
+
+	g_hash_table_replace (self->priv->documents, doc, filename);
+}
+
+/*
+ * A document saved with another name
+ */
+static void
+document_uri_cb (GeditDocument *doc,
+		 GParamSpec *pspec,
+		 GscProviderQuickopen *self)
+{
+	set_document_file (self, doc, get_document_file (doc));
+}
+
+static void
+add_document (GscProviderQuickopen *self,
+	      GeditDocument *doc)
+{
+	if (g_hash_table_lookup_extended (self->priv->documents, doc, NULL, NULL))
+		return;
+
+	/* An untitled document is kept without file */
+	g_hash_table_insert (self->priv->documents, doc, NULL);
+	g_object_weak_ref (G_OBJECT (doc),
+			   (GWeakNotify) document_finalized_cb,
+			   self);
+	g_signal_connect (doc, "notify::uri",
+			  G_CALLBACK (document_uri_cb), self);
+
+	set_document_file (self, doc, get_document_file (doc));
+}
+
+static void
+forget_document (GscProviderQuickopen *self,
+		 GeditDocument *doc)
+{
+	const gchar *filename = g_hash_table_lookup (self->priv->documents, doc);
+
+	if (filename != NULL)
+		gsc_path_index_remove (self->priv->index, filename, GSC_PATH_SOURCE_OPEN);
+
+	g_hash_table_remove (self->priv->documents, doc);
+}
+
+static void
+remove_document (GscProviderQuickopen *self,
+		 GeditDocument *doc)
+{
+	if (!g_hash_table_lookup_extended (self->priv->documents, doc, NULL, NULL))
+		return;
+
+	g_signal_handlers_disconnect_by_func (doc, document_uri_cb, self);
+	g_object_weak_unref (G_OBJECT (doc),
+			     (GWeakNotify) document_finalized_cb,
+			     self);
+	forget_document (self, doc);
+}
+
+/*
+ * The documents of a destroyed window may go without a tab-removed
+ */
+static void
+document_finalized_cb (GscProviderQuickopen *self,
+		       GObject *doc)
+{
+	forget_document (self, (GeditDocument *) doc);
+}
+
+static void
+tab_added_cb (GeditWindow *window,
+	      GeditTab *tab,
+	      GscProviderQuickopen *self)
+{
+	add_document (self, gedit_tab_get_document (tab));
+}
+
+static void
+tab_removed_cb (GeditWindow *window,
+		GeditTab *tab,
+		GscProviderQuickopen *self)
+{
+	remove_document (self, gedit_tab_get_document (tab));
+}
+
+static void
+recent_changed_cb (GtkRecentManager *manager,
+		   GscProviderQuickopen *self)
+{
+	self->priv->recent_dirty = TRUE;
+}
+
+/*
+ * Indexes the local gedit recent files again if they have changed
+ */
+static void
+update_recent (GscProviderQuickopen *self)
+{
+	GtkRecentInfo *info;
+	GList *items;
+	GList *l;
+	gchar *filename;
+
+	if (!self->priv->recent_dirty)
+		return;
+
+	self->priv->recent_dirty = FALSE;
+	gsc_path_index_clear_source (self->priv->index, GSC_PATH_SOURCE_RECENT);
+
+	items = gtk_recent_manager_get_items (self->priv->recent_manager);
+
+	for (l = items; l != NULL; l = g_list_next (l))
+	{
+		info = l->data;
+
+		if (!gtk_recent_info_has_group (info, "gedit"))
+			continue;
+
+		filename = g_filename_from_uri (gtk_recent_info_get_uri (info),
+						NULL, NULL);
+		if (filename != NULL)
+		{
+			gsc_path_index_add (self->priv->index,
+					    filename,
+					    GSC_PATH_SOURCE_RECENT);
+			g_free (filename);
+		}
+	}
+
+	g_list_foreach (items, (GFunc) gtk_recent_info_unref, NULL);
+	g_list_free (items);
+}
+
+static void
+project_changed_cb (GscProjectCrawlerEvent event,
+		    const gchar *path,
+		    GscProviderQuickopen *self)
+{
+	switch (event)
+	{
+		case GSC_PROJECT_CRAWLER_FILE_ADDED:
+			gsc_path_index_add (self->priv->index,
+					    path,
+					    GSC_PATH_SOURCE_PROJECT);
+			break;
+		case GSC_PROJECT_CRAWLER_FILE_REMOVED:
+			gsc_path_index_remove (self->priv->index,
+					       path,
+					       GSC_PATH_SOURCE_PROJECT);
+			break;
+		case GSC_PROJECT_CRAWLER_DIR_REMOVED:
+			gsc_path_index_remove_dir (self->priv->index,
+						   path,
+						   GSC_PATH_SOURCE_PROJECT);
+			break;
+		case GSC_PROJECT_CRAWLER_FILE_CHANGED:
+			/* Only the paths are indexed */
+			break;
+	}
+}
+
+static void
+stop_project (GscProviderQuickopen *self)
+{
+	if (self->priv->crawler == NULL)
+		return;
+
+	gsc_project_crawler_remove_func (self->priv->crawler,
+					 (GscProjectCrawlerFunc) project_changed_cb,
+					 self);
+	gsc_project_crawler_unref (self->priv->crawler);
+	self->priv->crawler = NULL;
+	gsc_path_index_clear_source (self->priv->index, GSC_PATH_SOURCE_PROJECT);
+}
+
+/*
+ * The query is the text between the last space and the cursor
+ */
+static gchar *
+get_query (GtkTextView *view)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+	guint n_chars = 0;
+
+	gsc_utils_get_iter_at_insert (view, &end);
+	start = end;
+
+	while (n_chars < MAX_QUERY_CHARS && gtk_text_iter_backward_char (&start))
+	{
+		if (g_unichar_isspace (gtk_text_iter_get_char (&start)))
+		{
+			gtk_text_iter_forward_char (&start);
+			break;
+		}
+
+		n_chars++;
+	}
+
+	return gtk_text_iter_get_slice (&start, &end);
+}
+
+static GdkPixbuf *
+load_icon (void)
+{
+	GtkIconTheme *theme = gtk_icon_theme_get_default ();
+	gint width;
+
+	gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, &width, NULL);
+
+	return gtk_icon_theme_load_icon (theme,
+					 GTK_STOCK_FILE,
+					 width,
+					 GTK_ICON_LOOKUP_USE_BUILTIN,
+					 NULL);
+}
+
+static const gchar *
+gsc_provider_quickopen_get_name (GscProvider *self)
+{
+	return GSC_PROVIDER_QUICKOPEN (self)->priv->name;
+}
+
+static GdkPixbuf *
+gsc_provider_quickopen_get_icon (GscProvider *self)
+{
+	return GSC_PROVIDER_QUICKOPEN (self)->priv->icon;
+}
+
+static void
+gsc_provider_quickopen_populate_completion (GscProvider *base,
+					    GscContext *context)
+{
+	GscProviderQuickopen *self = GSC_PROVIDER_QUICKOPEN (base);
+	GscPathMatch *matches = self->priv->matches;
+	GList *data_list = NULL;
+	gchar *query;
+	guint n_matches;
+	guint i;
+
+	query = get_query (gsc_context_get_view (context));
+
+	if (self->priv->window != NULL &&
+	    g_utf8_strlen (query, -1) >= MIN_QUERY_CHARS)
+	{
+		update_recent (self);
+
+		n_matches = gsc_path_index_query (self->priv->index,
+						  query,
+						  matches,
+						  MAX_PROPOSALS);
+
+		for (i = n_matches; i > 0; i--)
+		{
+			data_list = g_list_prepend (data_list,
+						    gsc_proposal_file_new (self->priv->window,
+									   matches[i - 1].path,
+									   query,
+									   self->priv->icon));
+		}
+	}
+
+	g_free (query);
+
+	/* GscManager frees this list and data */
+	gsc_context_add_proposals (context, base, data_list);
+}
+
+/*
+ * The files are only proposed when the completion is requested with the
+ * user request keys (AUTOMATIC), never while typing (INTERACTIVE)
+ */
+static const gchar *
+gsc_provider_quickopen_get_capabilities (GscProvider *provider)
+{
+	return GSC_COMPLETION_CAPABILITY_AUTOMATIC;
+}
+
+static void
+window_finalized_cb (GscProviderQuickopen *self,
+		     GObject *window)
+{
+	self->priv->window = NULL;
+	stop_project (self);
+}
+
+static void
+gsc_provider_quickopen_dispose (GObject *object)
+{
+	GscProviderQuickopen *self = GSC_PROVIDER_QUICKOPEN (object);
+	GHashTableIter iter;
+	gpointer doc;
+
+	if (self->priv->window != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (self->priv->window,
+						      tab_added_cb,
+						      self);
+		g_signal_handlers_disconnect_by_func (self->priv->window,
+						      tab_removed_cb,
+						      self);
+		g_object_weak_unref (G_OBJECT (self->priv->window),
+				     (GWeakNotify) window_finalized_cb,
+				     self);
+		self->priv->window = NULL;
+	}
+
+	g_hash_table_iter_init (&iter, self->priv->documents);
+	while (g_hash_table_iter_next (&iter, &doc, NULL))
+	{
+		g_signal_handlers_disconnect_by_func (doc, document_uri_cb, self);
+		g_object_weak_unref (G_OBJECT (doc),
+				     (GWeakNotify) document_finalized_cb,
+				     self);
+	}
+	g_hash_table_remove_all (self->priv->documents);
+
+	if (self->priv->recent_manager != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (self->priv->recent_manager,
+						      recent_changed_cb,
+						      self);
+		self->priv->recent_manager = NULL;
+	}
+
+	stop_project (self);
+
+	G_OBJECT_CLASS (gsc_provider_quickopen_parent_class)->dispose (object);
+}
+
+static void
+gsc_provider_quickopen_finalize (GObject *object)
+{
+	GscProviderQuickopen *self = GSC_PROVIDER_QUICKOPEN (object);
+
+	g_free (self->priv->name);
+
+	if (self->priv->icon != NULL)
+		g_object_unref (self->priv->icon);
+
+	g_hash_table_destroy (self->priv->documents);
+	gsc_path_index_free (self->priv->index);
+
+	G_OBJECT_CLASS (gsc_provider_quickopen_parent_class)->finalize (object);
+}
+
+static void
+gsc_provider_quickopen_class_init (GscProviderQuickopenClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->dispose = gsc_provider_quickopen_dispose;
+	object_class->finalize = gsc_provider_quickopen_finalize;
+
+	g_type_class_add_private (object_class, sizeof (GscProviderQuickopenPrivate));
+}
+
+static void
+gsc_provider_quickopen_iface_init (GscProviderIface *iface)
+{
+	iface->get_name = gsc_provider_quickopen_get_name;
+	iface->get_icon = gsc_provider_quickopen_get_icon;
+
+	iface->populate_completion = gsc_provider_quickopen_populate_completion;
+	iface->get_capabilities = gsc_provider_quickopen_get_capabilities;
+}
+
+static void
+gsc_provider_quickopen_init (GscProviderQuickopen *self)
+{
+	self->priv = GSC_PROVIDER_QUICKOPEN_GET_PRIVATE (self);
+
+	self->priv->index = gsc_path_index_new ();
+	self->priv->documents = g_hash_table_new_full (g_direct_hash,
+						       g_direct_equal,
+						       NULL,
+						       g_free);
+	self->priv->max_files = MAX_PROJECT_FILES;
+	self->priv->recent_dirty = TRUE;
+}
+
+GscProviderQuickopen *
+gsc_provider_quickopen_new (GeditWindow *window)
+{
+	GscProviderQuickopen *self;
+	GList *docs;
+	GList *l;
+
+	g_return_val_if_fail (GEDIT_IS_WINDOW (window), NULL);
+
+	self = g_object_new (GSC_TYPE_PROVIDER_QUICKOPEN, NULL);
+	self->priv->name = g_strdup ("Quick Open");
+	self->priv->icon = load_icon ();
+
+	self->priv->window = window;
+	g_object_weak_ref (G_OBJECT (window),
+			   (GWeakNotify) window_finalized_cb,
+			   self);
+	g_signal_connect (window, "tab-added",
+			  G_CALLBACK (tab_added_cb), self);
+	g_signal_connect (window, "tab-removed",
+			  G_CALLBACK (tab_removed_cb), self);
+
+	docs = gedit_window_get_documents (window);
+	for (l = docs; l != NULL; l = g_list_next (l))
+		add_document (self, GEDIT_DOCUMENT (l->data));
+	g_list_free (docs);
+
+	self->priv->recent_manager = gtk_recent_manager_get_default ();
+	g_signal_connect (self->priv->recent_manager, "changed",
+			  G_CALLBACK (recent_changed_cb), self);
+
+	return self;
+}
+
+/**
+ * gsc_provider_quickopen_set_max_files:
+ * @self: The #GscProviderQuickopen
+ * @max_files: Maximum number of files listed in a project
+ *
+ * The new limit is used from the next project listed.
+ */
+void
+gsc_provider_quickopen_set_max_files (GscProviderQuickopen *self,
+				      guint max_files)
+{
+	g_return_if_fail (GSC_IS_PROVIDER_QUICKOPEN (self));
+
+	self->priv->max_files = max_files;
+}
+
+/**
+ * gsc_provider_quickopen_set_project:
+ * @self: The #GscProviderQuickopen
+ * @root: The project directory, or %NULL
+ *
+ * Lists the files under @root instead of the ones of the previous project.
+ * With %NULL only the open and the recent files are proposed.
+ */
+void
+gsc_provider_quickopen_set_project (GscProviderQuickopen *self,
+				    const gchar *root)
+{
+	g_return_if_fail (GSC_IS_PROVIDER_QUICKOPEN (self));
+
+	if (self->priv->crawler != NULL && root != NULL &&
+	    strcmp (root, gsc_project_crawler_get_root (self->priv->crawler)) == 0)
+		return;
+
+	stop_project (self);
+
+	if (root == NULL || self->priv->window == NULL)
+		return;
+
+	self->priv->crawler = gsc_project_crawler_get_for_root (root,
+								self->priv->max_files);
+	gsc_project_crawler_add_func (self->priv->crawler,
+				      (GscProjectCrawlerFunc) project_changed_cb,
+				      self);
+}
@@ -0,0 +1,78 @@
+/*
+ *  gsc-provider-quickopen.h - Proposes the files whose path matches the text
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __QUICKOPEN_PROVIDER_H__
+#define __QUICKOPEN_PROVIDER_H__
+
+#include <glib.h>
+#include <glib-object.h>
+#include <gedit/gedit-plugin.h>
+#include <gtksourcecompletion/gsc-provider.h>
+
+G_BEGIN_DECLS
+
+#define GSC_TYPE_PROVIDER_QUICKOPEN (gsc_provider_quickopen_get_type ())
+#define GSC_PROVIDER_QUICKOPEN(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), GSC_TYPE_PROVIDER_QUICKOPEN, GscProviderQuickopen))
+#define GSC_PROVIDER_QUICKOPEN_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST ((klass), GSC_TYPE_PROVIDER_QUICKOPEN, GscProviderQuickopenClass))
+#define GSC_IS_PROVIDER_QUICKOPEN(obj) (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GSC_TYPE_PROVIDER_QUICKOPEN))
+#define GSC_IS_PROVIDER_QUICKOPEN_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GSC_TYPE_PROVIDER_QUICKOPEN))
+#define GSC_PROVIDER_QUICKOPEN_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), GSC_TYPE_PROVIDER_QUICKOPEN, GscProviderQuickopenClass))
+
+#define GSC_PROVIDER_QUICKOPEN_NAME "GscProviderQuickopen"
+
+typedef struct _GscProviderQuickopen GscProviderQuickopen;
+typedef struct _GscProviderQuickopenPrivate GscProviderQuickopenPrivate;
+typedef struct _GscProviderQuickopenClass GscProviderQuickopenClass;
+
+struct _GscProviderQuickopen
+{
+	GObject parent;
+
+	GscProviderQuickopenPrivate *priv;
+};
+
+struct _GscProviderQuickopenClass
+{
+	GObjectClass parent;
+};
+
+GType		 gsc_provider_quickopen_get_type	(void) G_GNUC_CONST;
+
+/**
+ * gsc_provider_quickopen_new:
+ * @window: The #GeditWindow
+ *
+ * Creates a provider proposing, when the user asks for them, the files
+ * whose path matches the text before the cursor. The files open in
+ * @window, the gedit recent files and the files of the project given to
+ * gsc_provider_quickopen_set_project are indexed. The project is listed
+ * in a thread and watched for changes.
+ *
+ * Returns: A new #GscProviderQuickopen
+ */
+GscProviderQuickopen *gsc_provider_quickopen_new	(GeditWindow *window);
+
+void		 gsc_provider_quickopen_set_max_files	(GscProviderQuickopen *self,
+							 guint max_files);
+
+void		 gsc_provider_quickopen_set_project	(GscProviderQuickopen *self,
+							 const gchar *root);
+
+G_END_DECLS
+
+#endif
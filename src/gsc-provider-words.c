@@ -18,27 +18,90 @@
  */
 
 #include <string.h>
+#include <gio/gio.h>
 #include "gsc-provider-words.h"
+#include "gsc-words-index.h"
+#include "gsc-words-selector.h"
 #include <gtksourcecompletion/gsc-completion.h>
 #include <gtksourcecompletion/gsc-item.h>
 #include <gtksourcecompletion/gsc-utils.h>
 
+/* Default maximum number of proposals shown */
+#define MAX_PROPOSALS 500
+
+/* Maximum number of matches kept to narrow them on the next keystroke */
+#define CACHE_MAX_WORDS 4096
+
+/* Default time given to every populate, in milliseconds */
+#define TIME_BUDGET 8
+
+/* Words visited between two looks at the clock */
+#define BUDGET_CHECK_WORDS 32
+
+/* Weight of the last populate in the mean latency, 1/n */
+#define LATENCY_WEIGHT 4
+
 #define GSC_PROVIDER_WORDS_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE((object), GSC_TYPE_PROVIDER_WORDS, GscProviderWordsPrivate))
 
 static void	 gsc_provider_words_iface_init	(GscProviderIface *iface);
 
+/* The state a refinement was started for */
+typedef struct
+{
+	guint generation;
+	guint changes;
+} RefineTag;
+
+typedef struct
+{
+	/* Offset of the word in cache_words */
+	guint32 word;
+	guint n_chars;
+	guint count;
+	guint distance;
+} CachedWord;
+
 struct _GscProviderWordsPrivate
 {
 	gchar *name;
 	GdkPixbuf *icon;
-	GdkPixbuf *proposal_icon;
-	gboolean is_completing;
-	GHashTable *current_words;
-	GList *data_list;
+	GscWordsSelector *selector;
 	gchar *cleaned_word;
-	gint count;
+	/* Index and cursor line of the populate running */
+	GscWordsIndex *index;
+	guint cursor_line;
+	
+	/* Milliseconds a walk of the index may take, 0 for no limit */
+	guint time_budget;
+	GTimer *timer;
+	guint n_visited;
+	/* Last word visited by a walk stopped by the time budget */
+	gchar *resume_word;
+	/* Cancels the task completing the cache after a stopped walk */
+	GCancellable *refine_cancellable;
+	guint n_overruns;
+	/* Increased by every populate, the results of older ones are
+	   discarded */
+	guint generation;
+	/* Moving mean of the populate time, in microseconds */
+	guint latency;
+	gboolean interactive;
+	
+	/* All the words matching the last prefix. While the user types
+	   more characters of the same word we only filter them. */
+	GString *cache_words;
+	GArray *cache;
+	gboolean cache_valid;
+	/* The walk filling the cache was stopped and is still running */
+	gboolean cache_partial;
+	GtkTextBuffer *cache_buffer;
+	gchar *cache_prefix;
+	gint cache_word_start;
+	gint cache_char_count;
+	guint cache_stamp;
 	GscProviderWordsSortType sort_type;
-	GtkTextIter start_iter;
+	guint max_proposals;
+	GThreadPool *pool;
 };
 
 G_DEFINE_TYPE_WITH_CODE (GscProviderWords,
@@ -48,145 +111,443 @@ G_DEFINE_TYPE_WITH_CODE (GscProviderWords,
 				 		gsc_provider_words_iface_init))
 
 static gboolean
-pred_is_separator(gunichar ch, gpointer user_data)
+is_valid_word(const gchar *current_word, const gchar *completion_word, guint n_chars)
 {
-	return gsc_utils_is_separator(ch);
+	if (n_chars < 3)
+		return FALSE;
+	
+	/* The index only gives us the words starting with current_word */
+	if (current_word != NULL && strcmp(current_word,completion_word) == 0)
+		return FALSE;
+
+	return TRUE;
 }
 
-static gint
-utf8_len_compare(gconstpointer a, gconstpointer b)
+static void
+cache_word (GscProviderWords *self,
+	    const gchar *word,
+	    guint n_chars,
+	    guint count,
+	    guint distance)
 {
-    glong lena,lenb;
-    lena = g_utf8_strlen(gsc_proposal_get_label((GscProposal*)a),-1);
-    lenb = g_utf8_strlen(gsc_proposal_get_label((GscProposal*)b),-1);
-    if (lena==lenb)
-        return 0;
-    else if (lena<lenb)
-        return -1;
-    else
-        return 1;
+	CachedWord cached;
+	
+	if (self->priv->cache->len >= CACHE_MAX_WORDS)
+	{
+		self->priv->cache_valid = FALSE;
+		return;
+	}
+	
+	cached.word = self->priv->cache_words->len;
+	cached.n_chars = n_chars;
+	cached.count = count;
+	cached.distance = distance;
+	
+	g_string_append (self->priv->cache_words, word);
+	g_string_append_c (self->priv->cache_words, '\0');
+	g_array_append_val (self->priv->cache, cached);
 }
 
-static GHashTable*
-get_all_words(GscProviderWords* self, GtkTextBuffer *buffer )
+/*
+ * Looks at the clock every BUDGET_CHECK_WORDS words. When the time budget
+ * has run out it keeps the word where the walk has to go on.
+ */
+static gboolean
+out_of_time (GscProviderWords *self,
+	     const gchar *word)
 {
-	GtkTextIter start_iter;
-	GtkTextIter prev_iter;
-	gchar *word;
-	GHashTable *result = g_hash_table_new_full(g_str_hash,
-						   g_str_equal,
-						   g_free,
-						   NULL);
-	
-	
-	gtk_text_buffer_get_start_iter(buffer,&start_iter);
-	prev_iter = start_iter;
-	while (gtk_text_iter_forward_find_char(
-			&start_iter,
-			(GtkTextCharPredicate)pred_is_separator,
-			NULL,
-			NULL))
+	if (self->priv->time_budget == 0 ||
+	    ++self->priv->n_visited % BUDGET_CHECK_WORDS != 0 ||
+	    g_timer_elapsed (self->priv->timer, NULL) * 1000 < self->priv->time_budget)
+		return FALSE;
+	
+	self->priv->resume_word = g_strdup (word);
+	return TRUE;
+}
+
+/*
+ * Called by the index for every word matching the current prefix. Offers
+ * the word to the selector, which keeps the best max_proposals, and keeps
+ * it in the cache. There is no selector while the cache is refined.
+ */
+static gboolean
+add_word_to_list(const gchar *word,
+		 guint n_chars,
+		 guint count,
+		 gpointer user_data)
+{
+	GscProviderWords *self = GSC_PROVIDER_WORDS(user_data);
+	guint distance = G_MAXUINT;
+	
+	/* The short words will never be proposed */
+	if (n_chars >= 3)
 	{
-		if (gtk_text_iter_compare(&self->priv->start_iter,&prev_iter)!=0)
+		/* Decoding the lines of a word is the expensive part, only
+		   done when they are used */
+		if (self->priv->sort_type == GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_PROXIMITY)
 		{
-			word = gtk_text_iter_get_text(&prev_iter,&start_iter);
-        
-			if (strlen(word)>0)
-				g_hash_table_insert(result,word,NULL);
-			else
-				g_free(word);
+			distance = gsc_words_index_get_distance (self->priv->index,
+								 word,
+								 self->priv->cursor_line);
 		}
-		prev_iter = start_iter;
-		gtk_text_iter_forward_char(&prev_iter);
+		
+		if (self->priv->cache_valid)
+			cache_word (self, word, n_chars, count, distance);
+		
+		if (self->priv->selector != NULL &&
+		    is_valid_word(self->priv->cleaned_word,word,n_chars))
+		{
+			gsc_words_selector_add (self->priv->selector,
+						word,
+						n_chars,
+						count,
+						distance);
+		}
+		
+		/* Without sorting the index order is the final one: the
+		   first words are the best ones and we only go on to fill
+		   the cache */
+		if (self->priv->sort_type == GSC_DOCUMENTWORDS_PROVIDER_SORT_NONE &&
+		    !self->priv->cache_valid &&
+		    (self->priv->selector == NULL ||
+		     gsc_words_selector_is_full (self->priv->selector)))
+			return FALSE;
 	}
+	
+	return !out_of_time (self, word);
+}
+
+/*
+ * Walks the words after the last one visited by a stopped walk, or all of
+ * them
+ */
+static void
+walk_index (GscProviderWords *self,
+	    const gchar *prefix)
+{
+	gchar *after = self->priv->resume_word;
+	
+	self->priv->resume_word = NULL;
+	self->priv->n_visited = 0;
+	g_timer_start (self->priv->timer);
+	
+	gsc_words_index_foreach_prefix_all_after (prefix, after, add_word_to_list, self);
+	
+	g_free (after);
+}
 
-	if (!gtk_text_iter_is_end(&prev_iter))
+static void
+refine_clear (GscProviderWords *self)
+{
+	if (self->priv->refine_cancellable != NULL)
 	{
-		gtk_text_buffer_get_end_iter(buffer,&start_iter);
-		if (gtk_text_iter_compare(&self->priv->start_iter,&prev_iter)!=0)
-		{
-			word = gtk_text_iter_get_text(&prev_iter,&start_iter);
-			if (strlen(word)>0)
-				g_hash_table_insert(result,word,NULL);
-			else
-				g_free(word);
-		}
-		prev_iter = start_iter;
-	        gtk_text_iter_forward_char(&prev_iter);
+		g_object_unref (self->priv->refine_cancellable);
+		self->priv->refine_cancellable = NULL;
 	}
-	return result;
+	
+	g_free (self->priv->resume_word);
+	self->priv->resume_word = NULL;
+	self->priv->cache_partial = FALSE;
 }
 
+/*
+ * Cancels the running refinement, its task returns in the next idle
+ * without touching the cache
+ */
+static void
+refine_cancel (GscProviderWords *self)
+{
+	if (self->priv->refine_cancellable != NULL)
+		g_cancellable_cancel (self->priv->refine_cancellable);
+	
+	refine_clear (self);
+}
+
+static void
+refine_tag_free (RefineTag *tag)
+{
+	g_slice_free (RefineTag, tag);
+}
+
+/*
+ * Goes on with the walk stopped by the time budget, one budget per idle,
+ * only to fill the cache. The task returns TRUE if the cache has been
+ * completed.
+ */
 static gboolean
-is_valid_word(gchar *current_word, gchar *completion_word)
+refine_cache_idle (GTask *task)
 {
-	if (g_utf8_strlen(completion_word, -1) < 3)
+	GscProviderWords *self = g_task_get_source_object (task);
+	RefineTag *tag = g_task_get_task_data (task);
+	GscWordsIndex *index;
+	
+	if (g_task_return_error_if_cancelled (task))
+	{
+		g_object_unref (task);
+		return FALSE;
+	}
+	
+	/* The walk is only valid for the words it started with */
+	if (self->priv->cache_buffer == NULL ||
+	    self->priv->cache_stamp != gsc_words_index_get_all_stamp ())
+	{
+		g_task_return_boolean (task, FALSE);
+		g_object_unref (task);
+		return FALSE;
+	}
+	
+	index = gsc_words_index_get_for_buffer (self->priv->cache_buffer,
+						self->priv->pool);
+	if (gsc_words_index_get_changes (index) != tag->changes)
+	{
+		g_task_return_boolean (task, FALSE);
+		g_object_unref (task);
 		return FALSE;
+	}
 	
-	if (current_word==NULL)
+	self->priv->index = index;
+	walk_index (self, self->priv->cache_prefix);
+	self->priv->index = NULL;
+	
+	if (self->priv->resume_word != NULL && self->priv->cache_valid)
 		return TRUE;
-		
-	gint len_cur = strlen (current_word);
-	if (g_utf8_collate(current_word,completion_word) == 0)
-			return FALSE;
+	
+	g_task_return_boolean (task, self->priv->cache_valid);
+	g_object_unref (task);
+	return FALSE;
+}
 
-	if (len_cur!=0 && strncmp(current_word,completion_word,len_cur)==0)
+static void
+refine_done_cb (GObject *source,
+		GAsyncResult *result,
+		gpointer user_data)
+{
+	GscProviderWords *self = GSC_PROVIDER_WORDS (source);
+	RefineTag *tag = g_task_get_task_data (G_TASK (result));
+	gboolean complete;
+	
+	complete = g_task_propagate_boolean (G_TASK (result), NULL);
+	
+	/* A newer populate owns the cache now */
+	if (tag->generation != self->priv->generation)
+		return;
+	
+	refine_clear (self);
+	
+	if (!complete)
+		self->priv->cache_valid = FALSE;
+}
+
+/*
+ * Starts a task completing the cache of the walk stopped by the time
+ * budget in idle time. It adds no proposal: the populate has returned its
+ * own already, and the completion API can not take more later.
+ */
+static void
+refine_start (GscProviderWords *self)
+{
+	RefineTag *tag = g_slice_new (RefineTag);
+	GSource *source;
+	GTask *task;
+	
+	tag->generation = self->priv->generation;
+	tag->changes = gsc_words_index_get_changes (self->priv->index);
+	
+	self->priv->cache_partial = TRUE;
+	self->priv->refine_cancellable = g_cancellable_new ();
+	
+	task = g_task_new (self,
+			   self->priv->refine_cancellable,
+			   refine_done_cb,
+			   NULL);
+	g_task_set_task_data (task, tag, (GDestroyNotify) refine_tag_free);
+	
+	source = g_idle_source_new ();
+	g_source_set_priority (source, G_PRIORITY_LOW);
+	g_task_attach_source (task, source, (GSourceFunc) refine_cache_idle);
+	g_source_unref (source);
+}
+
+/*
+ * The cached words can be narrowed if the user has only typed more
+ * characters at the end of the same word since the last populate.
+ */
+static gboolean
+can_narrow_cache (GscProviderWords *self,
+		  GtkTextBuffer *buffer,
+		  const gchar *prefix,
+		  gint word_start)
+{
+	glong typed;
+	
+	if (!self->priv->cache_valid ||
+	    self->priv->cache_partial ||
+	    self->priv->cache_buffer != buffer ||
+	    self->priv->cache_stamp != gsc_words_index_get_all_stamp () ||
+	    self->priv->cache_word_start != word_start ||
+	    !g_str_has_prefix (prefix, self->priv->cache_prefix))
+		return FALSE;
+	
+	typed = g_utf8_strlen (prefix, -1) -
+		g_utf8_strlen (self->priv->cache_prefix, -1);
+	
+	return gtk_text_buffer_get_char_count (buffer) -
+	       self->priv->cache_char_count == typed;
+}
+
+/*
+ * Drops the cached words not matching the new prefix and offers the rest
+ * to the selector
+ */
+static void
+narrow_cache (GscProviderWords *self,
+	      const gchar *prefix)
+{
+	CachedWord *cached;
+	const gchar *word;
+	guint i;
+	guint j = 0;
+	
+	for (i = 0; i < self->priv->cache->len; i++)
 	{
-		return TRUE;
+		cached = &g_array_index (self->priv->cache, CachedWord, i);
+		word = self->priv->cache_words->str + cached->word;
+		
+		if (!g_str_has_prefix (word, prefix))
+			continue;
+		
+		g_array_index (self->priv->cache, CachedWord, j++) = *cached;
+		
+		if (is_valid_word (self->priv->cleaned_word, word, cached->n_chars))
+		{
+			gsc_words_selector_add (self->priv->selector,
+						word,
+						cached->n_chars,
+						cached->count,
+						cached->distance);
+		}
 	}
-	return FALSE;
+	
+	g_array_set_size (self->priv->cache, j);
 }
 
 static void
-clean_current_words(GscProviderWords* self)
+cache_forget_buffer (GscProviderWords *self)
 {
-	/*Clean the previous data*/
-	if (self->priv->current_words!=NULL)
-	{	
-		g_hash_table_destroy(self->priv->current_words);
-		self->priv->current_words = NULL;
+	if (self->priv->cache_buffer != NULL)
+	{
+		g_object_remove_weak_pointer (G_OBJECT (self->priv->cache_buffer),
+					      (gpointer *) &self->priv->cache_buffer);
+		self->priv->cache_buffer = NULL;
 	}
 }
 
 /*
- * Check the proposals hash and inserts the completion proposal into the final list
+ * Walks the index and fills the cache again
  */
 static void
-gh_add_key_to_list(gpointer key,
-		   gpointer value,
-		   gpointer user_data)
+fill_cache (GscProviderWords *self,
+	    GtkTextBuffer *buffer,
+	    const gchar *prefix)
 {
-
-	GscProviderWords *self = GSC_PROVIDER_WORDS(user_data);
-	if (self->priv->count>=500)
+	g_string_truncate (self->priv->cache_words, 0);
+	g_array_set_size (self->priv->cache, 0);
+	self->priv->cache_valid = TRUE;
+	
+	if (self->priv->cache_buffer != buffer)
 	{
+		cache_forget_buffer (self);
+		self->priv->cache_buffer = buffer;
+		g_object_add_weak_pointer (G_OBJECT (buffer),
+					   (gpointer *) &self->priv->cache_buffer);
+	}
+	
+	self->priv->cache_stamp = gsc_words_index_get_all_stamp ();
+	
+	/* The words of all the open documents */
+	walk_index (self, prefix);
+	
+	if (self->priv->resume_word == NULL)
 		return;
+	
+	/* The best words found so far are the proposals. The rest of the
+	   walk only completes the cache, in idle time. */
+	self->priv->n_overruns++;
+	
+	if (self->priv->cache_valid)
+	{
+		refine_start (self);
 	}
-	GscItem *data;
-	if (is_valid_word(self->priv->cleaned_word,(gchar*)key))
+	else
 	{
-		self->priv->count++;
-		data = gsc_item_new (key, key, self->priv->proposal_icon, NULL);
-		/*data = gsc_proposal_new((gchar*)key,
-					NULL,
-					self->priv->icon);*/
-		self->priv->data_list = g_list_append(self->priv->data_list,data);
+		g_free (self->priv->resume_word);
+		self->priv->resume_word = NULL;
 	}
 }
 
-static GList*
-_sort_completion_list(GscProviderWords *self, GList *data_list)
+/*
+ * All the providers share the same icon, loaded the first time it is used
+ */
+static GdkPixbuf *
+get_proposal_icon (void)
+{
+	static GdkPixbuf *icon = NULL;
+	static gboolean loaded = FALSE;
+	GtkIconTheme *theme;
+	gint width;
+	
+	if (!loaded)
+	{
+		loaded = TRUE;
+		theme = gtk_icon_theme_get_default ();
+		
+		gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, &width, NULL);
+		icon = gtk_icon_theme_load_icon (theme,
+						 GTK_STOCK_FILE,
+						 width,
+						 GTK_ICON_LOOKUP_USE_BUILTIN,
+						 NULL);
+	}
+	
+	return icon;
+}
+
+static GscWordsCandidateCompareFunc
+get_compare_func (GscProviderWords *self)
 {
 	switch(self->priv->sort_type)
 	{
 		case GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_LENGTH:
-		{
-			data_list = g_list_sort(data_list,
-						(GCompareFunc)utf8_len_compare );
-			break;
-		}
+			return gsc_words_candidate_compare_length;
+		case GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_FREQUENCY:
+			return gsc_words_candidate_compare_count;
+		case GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_PROXIMITY:
+			return gsc_words_candidate_compare_distance;
 		default: 
-			break;
+			return gsc_words_candidate_compare_word;
+	}
+}
+
+static GList*
+build_completion_list(GscProviderWords *self)
+{
+	const GscWordsCandidate *candidates;
+	GList *data_list = NULL;
+	GscItem *data;
+	GdkPixbuf *icon = get_proposal_icon ();
+	guint n_candidates;
+	guint i;
+	
+	candidates = gsc_words_selector_finish (self->priv->selector,
+						&n_candidates);
+	
+	for (i = n_candidates; i > 0; i--)
+	{
+		data = gsc_item_new (candidates[i - 1].word,
+				     candidates[i - 1].word,
+				     icon,
+				     NULL);
+		data_list = g_list_prepend (data_list, data);
 	}
 	
 	return data_list;
@@ -211,46 +572,74 @@ gsc_provider_words_populate_completion (GscProvider *base,
 {
 	GscProviderWords *self = GSC_PROVIDER_WORDS (base);
 	GtkTextIter current_iter;
+	GtkTextIter start_iter;
 	GtkTextIter end_iter;
 	GtkTextView *view;
+	GscWordsIndex *index;
+	GList *data_list;
+	const gchar *prefix;
+	gint word_start;
+	gint64 started;
 
+	started = g_get_monotonic_time ();
 	view = gsc_context_get_view (context);
 	GtkTextBuffer *text_buffer = gtk_text_view_get_buffer(view);
 	gsc_utils_get_iter_at_insert (view, &current_iter);
 	
 	gchar* current_word = gsc_utils_get_word_iter(text_buffer,
 						      &current_iter,
-						      &self->priv->start_iter,
+						      &start_iter,
 						      &end_iter);
 	
 	self->priv->cleaned_word = gsc_utils_clear_word(current_word);
 	g_free(current_word);
 	
-	if (!self->priv->is_completing)
-	{
-		self->priv->current_words = get_all_words(self,text_buffer);
-	}
+	/* The index is kept up to date by the buffer edits */
+	index = gsc_words_index_get_for_buffer (text_buffer, self->priv->pool);
 	
-	self->priv->data_list = NULL;
-	self->priv->count = 0;
-	g_hash_table_foreach(self->priv->current_words,gh_add_key_to_list,self);
-	g_free(self->priv->cleaned_word);
-	self->priv->cleaned_word = NULL;
+	/* Every keystroke cancels the work left by the previous one */
+	self->priv->generation++;
+	refine_cancel (self);
+	
+	self->priv->selector = gsc_words_selector_new (self->priv->max_proposals,
+							get_compare_func (self));
+	self->priv->index = index;
+	self->priv->cursor_line = gtk_text_iter_get_line (&current_iter);
 	
-	if (self->priv->data_list!=NULL)
+	/* NULL means there is no word at the cursor: all the words match */
+	prefix = self->priv->cleaned_word != NULL ? self->priv->cleaned_word : "";
+	word_start = gtk_text_iter_get_offset (&start_iter);
+	
+	if (self->priv->cleaned_word != NULL && prefix[0] == '\0')
 	{
-		self->priv->is_completing = TRUE;
-		self->priv->data_list = _sort_completion_list(self,
-							      self->priv->data_list);
+		self->priv->cache_valid = FALSE;
 	}
 	else
 	{
-		clean_current_words(self);
-		self->priv->is_completing = FALSE;
+		if (can_narrow_cache (self, text_buffer, prefix, word_start))
+			narrow_cache (self, prefix);
+		else
+			fill_cache (self, text_buffer, prefix);
+		
+		g_free (self->priv->cache_prefix);
+		self->priv->cache_prefix = g_strdup (prefix);
+		self->priv->cache_word_start = word_start;
+		self->priv->cache_char_count = gtk_text_buffer_get_char_count (text_buffer);
 	}
+	
+	g_free(self->priv->cleaned_word);
+	self->priv->cleaned_word = NULL;
+	
+	data_list = build_completion_list (self);
+	gsc_words_selector_free (self->priv->selector);
+	self->priv->selector = NULL;
+	self->priv->index = NULL;
+
+	self->priv->latency += ((gint) (g_get_monotonic_time () - started) -
+				(gint) self->priv->latency) / LATENCY_WEIGHT;
 
 	/* GscManager frees this list and data */
-	gsc_context_add_proposals (context, base, self->priv->data_list);
+	gsc_context_add_proposals (context, base, data_list);
 }
 
 /*
@@ -270,6 +659,9 @@ gsc_provider_words_filter_proposal (GscProvider *provider,
 static const gchar *
 gsc_provider_words_get_capabilities (GscProvider *provider)
 {
+	if (!GSC_PROVIDER_WORDS (provider)->priv->interactive)
+		return GSC_COMPLETION_CAPABILITY_AUTOMATIC;
+	
 	return GSC_COMPLETION_CAPABILITY_INTERACTIVE ","
 	       GSC_COMPLETION_CAPABILITY_AUTOMATIC;
 }
@@ -286,10 +678,15 @@ gsc_provider_words_finalize (GObject *object)
 		g_object_unref (provider->priv->icon);
 	}
 	
-	if (provider->priv->proposal_icon != NULL)
-	{
-		g_object_unref (provider->priv->proposal_icon);
-	}
+	/* A running refinement keeps a reference to the provider: there is
+	   none at this point */
+	refine_cancel (provider);
+	g_timer_destroy (provider->priv->timer);
+	
+	cache_forget_buffer (provider);
+	g_string_free (provider->priv->cache_words, TRUE);
+	g_array_free (provider->priv->cache, TRUE);
+	g_free (provider->priv->cache_prefix);
 
 	G_OBJECT_CLASS (gsc_provider_words_parent_class)->finalize (object);
 }
@@ -318,19 +715,14 @@ gsc_provider_words_iface_init (GscProviderIface *iface)
 static void 
 gsc_provider_words_init (GscProviderWords * self)
 {
-	GtkIconTheme *theme;
-	gint width;
-	
 	self->priv = GSC_PROVIDER_WORDS_GET_PRIVATE (self);
 	
-	theme = gtk_icon_theme_get_default ();
-
-	gtk_icon_size_lookup (GTK_ICON_SIZE_MENU, &width, NULL);
-	self->priv->proposal_icon = gtk_icon_theme_load_icon (theme,
-	                                                      GTK_STOCK_FILE,
-	                                                      width,
-	                                                      GTK_ICON_LOOKUP_USE_BUILTIN,
-	                                                      NULL);
+	self->priv->max_proposals = MAX_PROPOSALS;
+	self->priv->time_budget = TIME_BUDGET;
+	self->priv->interactive = TRUE;
+	self->priv->timer = g_timer_new ();
+	self->priv->cache_words = g_string_new (NULL);
+	self->priv->cache = g_array_new (FALSE, FALSE, sizeof (CachedWord));
 }
 
 GscProviderWords *
@@ -350,3 +742,114 @@ gsc_provider_words_new (void)
 	  
 	return ret;
 }
+
+/**
+ * gsc_provider_words_set_thread_pool:
+ * @self: The #GscProviderWords
+ * @pool: A pool from gsc_words_index_pool_new or %NULL
+ *
+ * Sets the pool used to scan the big documents. The provider does not
+ * own the pool.
+ */
+void
+gsc_provider_words_set_thread_pool (GscProviderWords *self,
+				    GThreadPool *pool)
+{
+	g_return_if_fail (GSC_IS_PROVIDER_WORDS (self));
+	
+	self->priv->pool = pool;
+}
+
+/**
+ * gsc_provider_words_set_sort_type:
+ * @self: The #GscProviderWords
+ * @sort_type: How the proposals are sorted
+ */
+void
+gsc_provider_words_set_sort_type (GscProviderWords *self,
+				  GscProviderWordsSortType sort_type)
+{
+	g_return_if_fail (GSC_IS_PROVIDER_WORDS (self));
+	
+	self->priv->sort_type = sort_type;
+	/* The cached words have no distances for other sort types */
+	self->priv->cache_valid = FALSE;
+}
+
+/**
+ * gsc_provider_words_set_max_proposals:
+ * @self: The #GscProviderWords
+ * @max_proposals: Maximum number of proposals
+ *
+ * Only the best @max_proposals words under the sort type are proposed.
+ */
+void
+gsc_provider_words_set_max_proposals (GscProviderWords *self,
+				      guint max_proposals)
+{
+	g_return_if_fail (GSC_IS_PROVIDER_WORDS (self));
+	g_return_if_fail (max_proposals > 0);
+	
+	self->priv->max_proposals = max_proposals;
+}
+
+/**
+ * gsc_provider_words_set_time_budget:
+ * @self: The #GscProviderWords
+ * @msecs: Milliseconds, 0 for no limit
+ *
+ * Sets the time a populate may spend looking for the words. When it runs
+ * out the best words found so far are proposed. The rest are looked for
+ * in idle time only to fill the cache narrowed by the next populate.
+ */
+void
+gsc_provider_words_set_time_budget (GscProviderWords *self,
+				    guint msecs)
+{
+	g_return_if_fail (GSC_IS_PROVIDER_WORDS (self));
+	
+	self->priv->time_budget = msecs;
+}
+
+/**
+ * gsc_provider_words_get_overruns:
+ * @self: The #GscProviderWords
+ *
+ * Returns: The number of populates stopped by the time budget
+ */
+guint
+gsc_provider_words_get_overruns (GscProviderWords *self)
+{
+	g_return_val_if_fail (GSC_IS_PROVIDER_WORDS (self), 0);
+	
+	return self->priv->n_overruns;
+}
+
+/**
+ * gsc_provider_words_get_latency:
+ * @self: The #GscProviderWords
+ *
+ * Returns: The mean time of the last populates, in microseconds
+ */
+guint
+gsc_provider_words_get_latency (GscProviderWords *self)
+{
+	g_return_val_if_fail (GSC_IS_PROVIDER_WORDS (self), 0);
+	
+	return self->priv->latency;
+}
+
+/**
+ * gsc_provider_words_set_interactive:
+ * @self: The #GscProviderWords
+ * @interactive: %FALSE to propose the words only when the user asks for
+ * them
+ */
+void
+gsc_provider_words_set_interactive (GscProviderWords *self,
+				    gboolean interactive)
+{
+	g_return_if_fail (GSC_IS_PROVIDER_WORDS (self));
+	
+	self->priv->interactive = interactive;
+}
@@ -34,9 +34,20 @@ G_BEGIN_DECLS
 
 #define GSC_PROVIDER_WORDS_NAME "GscProviderWords"
 
+/**
+ * GscProviderWordsSortType:
+ * @GSC_DOCUMENTWORDS_PROVIDER_SORT_NONE: Does not sort the proposals
+ * @GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_LENGTH: Sets the small words first
+ * @GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_FREQUENCY: Sets the words with more
+ * occurrences in the document first
+ * @GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_PROXIMITY: Sets the words nearer to
+ * the cursor first
+ **/
 typedef enum{
 	GSC_DOCUMENTWORDS_PROVIDER_SORT_NONE,
-	GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_LENGTH
+	GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_LENGTH,
+	GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_FREQUENCY,
+	GSC_DOCUMENTWORDS_PROVIDER_SORT_BY_PROXIMITY
 } GscProviderWordsSortType;
 
 typedef struct _GscProviderWords GscProviderWords;
@@ -59,6 +70,25 @@ GType		 gsc_provider_words_get_type	(void) G_GNUC_CONST;
 
 GscProviderWords *gsc_provider_words_new (void);
 
+void		 gsc_provider_words_set_thread_pool	(GscProviderWords *self,
+							 GThreadPool *pool);
+
+void		 gsc_provider_words_set_sort_type	(GscProviderWords *self,
+							 GscProviderWordsSortType sort_type);
+
+void		 gsc_provider_words_set_max_proposals	(GscProviderWords *self,
+							 guint max_proposals);
+
+void		 gsc_provider_words_set_time_budget	(GscProviderWords *self,
+							 guint msecs);
+
+guint		 gsc_provider_words_get_overruns	(GscProviderWords *self);
+
+guint		 gsc_provider_words_get_latency	(GscProviderWords *self);
+
+void		 gsc_provider_words_set_interactive	(GscProviderWords *self,
+							 gboolean interactive);
+
 G_END_DECLS
 
 #endif
@@ -0,0 +1,486 @@
+/*
+ *  gsc-words-frozen.c - Compact read-only form of the document words
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "gsc-words-frozen.h"
+
+/* Words of a block. A lookup decodes at most one block. */
+#define BLOCK_WORDS 16
+
+#define FILE_MAGIC "GSCWORDS"
+#define FILE_VERSION 1
+
+/* The numbers are written in the byte order of the host, the files of
+   another one are rejected */
+#define BYTE_ORDER_MARK 0x01020304
+
+/*
+ * A saved GscWordsFrozen is the header, the block offsets and the words.
+ * All the fields are 8-byte aligned so the file can be used as mapped.
+ */
+typedef struct
+{
+	gchar magic[8];
+	guint32 byte_order;
+	guint32 version;
+	guint32 n_words;
+	guint32 n_blocks;
+	guint64 data_len;
+	guint32 first_bytes[8];
+	/* SHA1 of the block offsets and the words, in hexadecimal */
+	gchar checksum[48];
+	GscWordsFrozenSource source;
+} FileHeader;
+
+struct _GscWordsFrozen
+{
+	/* The words, one after another: shared prefix length, suffix
+	   length, suffix, count, length of the lines and the lines */
+	const guint8 *data;
+	gsize data_len;
+	/* Offset of the first word of every block */
+	const guint32 *blocks;
+	guint n_blocks;
+	guint n_words;
+	/* Bit set of the first bytes of the words */
+	guint32 first_bytes[8];
+	/* Where data and blocks are: two arrays or a mapped file */
+	GByteArray *data_array;
+	GArray *blocks_array;
+	GMappedFile *file;
+	/* Only while the words are appended */
+	GString *last;
+	GByteArray *lines;
+};
+
+static void
+put_varint (GByteArray *array,
+	    guint32 value)
+{
+	guint8 buf[5];
+	guint len;
+
+	for (len = 0; value >= 0x80; len++)
+	{
+		buf[len] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	buf[len++] = value;
+
+	g_byte_array_append (array, buf, len);
+}
+
+static guint32
+get_varint (const guint8 **p)
+{
+	guint32 value = 0;
+	guint shift = 0;
+
+	do
+	{
+		value |= (guint32) (**p & 0x7f) << shift;
+		shift += 7;
+	}
+	while (*(*p)++ & 0x80);
+
+	return value;
+}
+
+GscWordsFrozen *
+gsc_words_frozen_new (void)
+{
+	GscWordsFrozen *frozen = g_slice_new0 (GscWordsFrozen);
+
+	frozen->data_array = g_byte_array_new ();
+	frozen->blocks_array = g_array_new (FALSE, FALSE, sizeof (guint32));
+	frozen->last = g_string_new (NULL);
+	frozen->lines = g_byte_array_new ();
+
+	return frozen;
+}
+
+void
+gsc_words_frozen_free (GscWordsFrozen *frozen)
+{
+	if (frozen->data_array != NULL)
+		g_byte_array_free (frozen->data_array, TRUE);
+	if (frozen->blocks_array != NULL)
+		g_array_free (frozen->blocks_array, TRUE);
+	if (frozen->file != NULL)
+		g_mapped_file_unref (frozen->file);
+	if (frozen->last != NULL)
+		g_string_free (frozen->last, TRUE);
+	if (frozen->lines != NULL)
+		g_byte_array_free (frozen->lines, TRUE);
+	g_slice_free (GscWordsFrozen, frozen);
+}
+
+void
+gsc_words_frozen_append (GscWordsFrozen *frozen,
+			 const gchar *word,
+			 guint count,
+			 const guint32 *lines,
+			 guint n_lines)
+{
+	guint32 offset;
+	guint32 prev = 0;
+	gsize shared = 0;
+	gsize len = strlen (word);
+	guint i;
+
+	if (frozen->n_words % BLOCK_WORDS == 0)
+	{
+		offset = frozen->data_array->len;
+		g_array_append_val (frozen->blocks_array, offset);
+	}
+	else
+	{
+		while (shared < frozen->last->len &&
+		       frozen->last->str[shared] == word[shared])
+			shared++;
+	}
+
+	put_varint (frozen->data_array, shared);
+	put_varint (frozen->data_array, len - shared);
+	g_byte_array_append (frozen->data_array, (const guint8 *) word + shared, len - shared);
+	put_varint (frozen->data_array, count);
+
+	g_byte_array_set_size (frozen->lines, 0);
+	for (i = 0; i < n_lines; i++)
+	{
+		put_varint (frozen->lines, lines[i] - prev);
+		prev = lines[i];
+	}
+	put_varint (frozen->data_array, frozen->lines->len);
+	g_byte_array_append (frozen->data_array, frozen->lines->data, frozen->lines->len);
+
+	g_string_assign (frozen->last, word);
+	frozen->first_bytes[(guchar) word[0] / 32] |= 1 << ((guchar) word[0] % 32);
+	frozen->n_words++;
+}
+
+void
+gsc_words_frozen_finish (GscWordsFrozen *frozen)
+{
+	GByteArray *data;
+	GArray *blocks;
+
+	/* The arrays reserve up to twice their size while they grow */
+	data = g_byte_array_sized_new (frozen->data_array->len);
+	g_byte_array_append (data, frozen->data_array->data, frozen->data_array->len);
+	g_byte_array_free (frozen->data_array, TRUE);
+	frozen->data_array = data;
+
+	blocks = g_array_sized_new (FALSE, FALSE, sizeof (guint32), frozen->blocks_array->len);
+	g_array_append_vals (blocks, frozen->blocks_array->data, frozen->blocks_array->len);
+	g_array_free (frozen->blocks_array, TRUE);
+	frozen->blocks_array = blocks;
+
+	frozen->data = data->data;
+	frozen->data_len = data->len;
+	frozen->blocks = (const guint32 *) blocks->data;
+	frozen->n_blocks = blocks->len;
+
+	g_string_free (frozen->last, TRUE);
+	frozen->last = NULL;
+	g_byte_array_free (frozen->lines, TRUE);
+	frozen->lines = NULL;
+}
+
+gsize
+gsc_words_frozen_get_size (GscWordsFrozen *frozen)
+{
+	return sizeof (GscWordsFrozen) +
+	       frozen->data_len +
+	       frozen->n_blocks * sizeof (guint32);
+}
+
+gboolean
+gsc_words_frozen_may_have_prefix (GscWordsFrozen *frozen,
+				  const gchar *prefix)
+{
+	guchar first = prefix[0];
+
+	if (first == '\0')
+		return frozen->n_words > 0;
+
+	return (frozen->first_bytes[first / 32] & (1 << (first % 32))) != 0;
+}
+
+/*
+ * Compares the first word of the block with key
+ */
+static gint
+block_compare (GscWordsFrozen *frozen,
+	       guint block,
+	       const gchar *key)
+{
+	const guint8 *p;
+	gsize len;
+	gint cmp;
+
+	p = frozen->data + frozen->blocks[block];
+
+	/* The first word of a block shares nothing */
+	get_varint (&p);
+	len = get_varint (&p);
+
+	cmp = strncmp ((const gchar *) p, key, len);
+	if (cmp != 0)
+		return cmp;
+
+	/* key has at least len bytes: the word is key or a prefix of it */
+	return key[len] == '\0' ? 0 : -1;
+}
+
+/*
+ * Decodes the word at iter->p and moves iter->p to the next one
+ */
+static void
+iter_decode (GscWordsFrozenIter *iter)
+{
+	gsize shared;
+	gsize len;
+
+	shared = get_varint (&iter->p);
+	len = get_varint (&iter->p);
+
+	g_string_truncate (iter->word, shared);
+	g_string_append_len (iter->word, (const gchar *) iter->p, len);
+	iter->p += len;
+
+	iter->count = get_varint (&iter->p);
+	iter->lines_len = get_varint (&iter->p);
+	iter->lines = iter->p;
+	iter->p += iter->lines_len;
+}
+
+gboolean
+gsc_words_frozen_iter_init (GscWordsFrozenIter *iter,
+			    GscWordsFrozen *frozen,
+			    const gchar *key)
+{
+	guint lo = 0;
+	guint hi = frozen->n_blocks;
+	guint mid;
+
+	iter->frozen = frozen;
+	iter->word = g_string_new (NULL);
+
+	if (frozen->n_words == 0)
+		return FALSE;
+
+	/* The first block beginning at or after key */
+	while (lo < hi)
+	{
+		mid = (lo + hi) / 2;
+
+		if (block_compare (frozen, mid, key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* The word may be in the block before */
+	if (lo > 0)
+		lo--;
+
+	iter->n = lo * BLOCK_WORDS;
+	iter->p = frozen->data + frozen->blocks[lo];
+	iter_decode (iter);
+
+	while (strcmp (iter->word->str, key) < 0)
+	{
+		if (!gsc_words_frozen_iter_next (iter))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean
+gsc_words_frozen_iter_next (GscWordsFrozenIter *iter)
+{
+	/* The blocks are contiguous: the next word is always at iter->p */
+	if (++iter->n >= iter->frozen->n_words)
+		return FALSE;
+
+	iter_decode (iter);
+
+	return TRUE;
+}
+
+void
+gsc_words_frozen_iter_get_lines (GscWordsFrozenIter *iter,
+				 GArray *values)
+{
+	const guint8 *p = iter->lines;
+	const guint8 *end = p + iter->lines_len;
+	guint32 line = 0;
+
+	g_array_set_size (values, 0);
+
+	while (p < end)
+	{
+		line += get_varint (&p);
+		g_array_append_val (values, line);
+	}
+}
+
+void
+gsc_words_frozen_iter_clear (GscWordsFrozenIter *iter)
+{
+	g_string_free (iter->word, TRUE);
+	iter->word = NULL;
+}
+
+static gchar *
+compute_checksum (const guint32 *blocks,
+		  guint n_blocks,
+		  const guint8 *data,
+		  gsize data_len)
+{
+	GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA1);
+	gchar *result;
+
+	g_checksum_update (checksum, (const guchar *) blocks, n_blocks * sizeof (guint32));
+	g_checksum_update (checksum, data, data_len);
+	result = g_strdup (g_checksum_get_string (checksum));
+	g_checksum_free (checksum);
+
+	return result;
+}
+
+gboolean
+gsc_words_frozen_save (GscWordsFrozen *frozen,
+		       const gchar *filename,
+		       const GscWordsFrozenSource *source,
+		       GError **error)
+{
+	FileHeader header;
+	GByteArray *contents;
+	gchar *checksum;
+	gboolean saved;
+
+	memset (&header, 0, sizeof (FileHeader));
+	memcpy (header.magic, FILE_MAGIC, sizeof (header.magic));
+	header.byte_order = BYTE_ORDER_MARK;
+	header.version = FILE_VERSION;
+	header.n_words = frozen->n_words;
+	header.n_blocks = frozen->n_blocks;
+	header.data_len = frozen->data_len;
+	memcpy (header.first_bytes, frozen->first_bytes, sizeof (header.first_bytes));
+	header.source = *source;
+
+	checksum = compute_checksum (frozen->blocks,
+				     frozen->n_blocks,
+				     frozen->data,
+				     frozen->data_len);
+	g_strlcpy (header.checksum, checksum, sizeof (header.checksum));
+	g_free (checksum);
+
+	contents = g_byte_array_sized_new (sizeof (FileHeader) +
+					   frozen->n_blocks * sizeof (guint32) +
+					   frozen->data_len);
+	g_byte_array_append (contents, (const guint8 *) &header, sizeof (FileHeader));
+	g_byte_array_append (contents,
+			     (const guint8 *) frozen->blocks,
+			     frozen->n_blocks * sizeof (guint32));
+	g_byte_array_append (contents, frozen->data, frozen->data_len);
+
+	/* Written to a temporary file and renamed: a reader never sees
+	   half a file */
+	saved = g_file_set_contents (filename,
+				     (const gchar *) contents->data,
+				     contents->len,
+				     error);
+
+	g_byte_array_free (contents, TRUE);
+
+	return saved;
+}
+
+GscWordsFrozen *
+gsc_words_frozen_map (const gchar *filename,
+		      GscWordsFrozenSource *source,
+		      GError **error)
+{
+	GscWordsFrozen *frozen;
+	GMappedFile *file;
+	const FileHeader *header;
+	const guint8 *contents;
+	gsize len;
+	guint64 blocks_len;
+	gchar *checksum = NULL;
+
+	file = g_mapped_file_new (filename, FALSE, error);
+	if (file == NULL)
+		return NULL;
+
+	contents = (const guint8 *) g_mapped_file_get_contents (file);
+	len = g_mapped_file_get_length (file);
+	header = (const FileHeader *) contents;
+
+	if (len < sizeof (FileHeader) ||
+	    memcmp (header->magic, FILE_MAGIC, sizeof (header->magic)) != 0 ||
+	    header->byte_order != BYTE_ORDER_MARK ||
+	    header->version != FILE_VERSION ||
+	    header->n_blocks != (header->n_words + BLOCK_WORDS - 1) / BLOCK_WORDS)
+		goto invalid;
+
+	blocks_len = (guint64) header->n_blocks * sizeof (guint32);
+	if (len - sizeof (FileHeader) != blocks_len + header->data_len)
+		goto invalid;
+
+	/* Reads the whole file once, but a damaged file would make the
+	   words be decoded out of it */
+	checksum = compute_checksum ((const guint32 *) (contents + sizeof (FileHeader)),
+				     header->n_blocks,
+				     contents + sizeof (FileHeader) + blocks_len,
+				     header->data_len);
+	if (strncmp (checksum, header->checksum, sizeof (header->checksum)) != 0)
+		goto invalid;
+
+	g_free (checksum);
+
+	frozen = g_slice_new0 (GscWordsFrozen);
+	frozen->file = file;
+	frozen->blocks = (const guint32 *) (contents + sizeof (FileHeader));
+	frozen->n_blocks = header->n_blocks;
+	frozen->data = contents + sizeof (FileHeader) + blocks_len;
+	frozen->data_len = header->data_len;
+	frozen->n_words = header->n_words;
+	memcpy (frozen->first_bytes, header->first_bytes, sizeof (frozen->first_bytes));
+
+	*source = header->source;
+	source->digest[sizeof (source->digest) - 1] = '\0';
+
+	return frozen;
+
+invalid:
+	g_free (checksum);
+	g_mapped_file_unref (file);
+	g_set_error (error,
+		     G_FILE_ERROR,
+		     G_FILE_ERROR_INVAL,
+		     "%s is not a valid words file",
+		     filename);
+
+	return NULL;
+}
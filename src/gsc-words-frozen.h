@@ -0,0 +1,160 @@
+/*
+ *  gsc-words-frozen.h - Compact read-only form of the document words
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __WORDS_FROZEN_H__
+#define __WORDS_FROZEN_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GscWordsFrozen GscWordsFrozen;
+typedef struct _GscWordsFrozenIter GscWordsFrozenIter;
+typedef struct _GscWordsFrozenSource GscWordsFrozenSource;
+
+/*
+ * The file the words come from, saved with them
+ */
+struct _GscWordsFrozenSource
+{
+	guint64 mtime;
+	guint64 size;
+	/* SHA1 of the text, in hexadecimal */
+	gchar digest[48];
+};
+
+/*
+ * A position in a #GscWordsFrozen. The fields are read-only.
+ */
+struct _GscWordsFrozenIter
+{
+	GscWordsFrozen *frozen;
+	/* The current word, rewritten by every step */
+	GString *word;
+	guint count;
+	/* Private */
+	guint n;
+	const guint8 *p;
+	const guint8 *lines;
+	gsize lines_len;
+};
+
+/**
+ * gsc_words_frozen_new:
+ *
+ * Creates an empty set of words to fill with gsc_words_frozen_append.
+ * The words are front-coded in blocks: every block stores its first word
+ * whole and the rest as the length of the prefix shared with the
+ * previous word plus the new bytes. Counts and line lists are varints.
+ *
+ * Returns: A new #GscWordsFrozen
+ */
+GscWordsFrozen	*gsc_words_frozen_new		(void);
+
+void		 gsc_words_frozen_free		(GscWordsFrozen *frozen);
+
+/**
+ * gsc_words_frozen_append:
+ * @frozen: The #GscWordsFrozen
+ * @word: A word after all the words appended before, in strcmp order
+ * @count: Number of occurrences of @word
+ * @lines: The lines of @word, in ascending order
+ * @n_lines: Number of lines
+ */
+void		 gsc_words_frozen_append	(GscWordsFrozen *frozen,
+						 const gchar *word,
+						 guint count,
+						 const guint32 *lines,
+						 guint n_lines);
+
+/**
+ * gsc_words_frozen_finish:
+ * @frozen: The #GscWordsFrozen
+ *
+ * Releases the memory reserved for more words. No word can be appended
+ * afterwards.
+ */
+void		 gsc_words_frozen_finish	(GscWordsFrozen *frozen);
+
+/**
+ * gsc_words_frozen_save:
+ * @frozen: A finished #GscWordsFrozen
+ * @filename: The file to write
+ * @source: Where the words come from
+ * @error: Return location for an error
+ *
+ * Writes the words to @filename in a form gsc_words_frozen_map can use
+ * without copying it.
+ *
+ * Returns: %TRUE if the file has been written
+ */
+gboolean	 gsc_words_frozen_save		(GscWordsFrozen *frozen,
+						 const gchar *filename,
+						 const GscWordsFrozenSource *source,
+						 GError **error);
+
+/**
+ * gsc_words_frozen_map:
+ * @filename: A file written by gsc_words_frozen_save
+ * @source: Return location for the source saved with the words
+ * @error: Return location for an error
+ *
+ * Maps the words saved in @filename. A file of another version, of a
+ * host with another byte order or damaged is rejected.
+ *
+ * Returns: The words, %NULL on error
+ */
+GscWordsFrozen	*gsc_words_frozen_map		(const gchar *filename,
+						 GscWordsFrozenSource *source,
+						 GError **error);
+
+/* Bytes used by the words */
+gsize		 gsc_words_frozen_get_size	(GscWordsFrozen *frozen);
+
+/* Returns FALSE if no word can start with prefix */
+gboolean	 gsc_words_frozen_may_have_prefix (GscWordsFrozen *frozen,
+						   const gchar *prefix);
+
+/**
+ * gsc_words_frozen_iter_init:
+ * @iter: The iter to initialize
+ * @frozen: The #GscWordsFrozen
+ * @key: The word to look for
+ *
+ * Points @iter to the first word greater than or equal to @key. The
+ * blocks are binary searched by their first word, then one block is
+ * decoded. Free the iter with gsc_words_frozen_iter_clear.
+ *
+ * Returns: %FALSE if there is no such word
+ */
+gboolean	 gsc_words_frozen_iter_init	(GscWordsFrozenIter *iter,
+						 GscWordsFrozen *frozen,
+						 const gchar *key);
+
+/* Moves to the next word. Returns FALSE at the end. */
+gboolean	 gsc_words_frozen_iter_next	(GscWordsFrozenIter *iter);
+
+/* Decodes the lines of the current word into values (guint32) */
+void		 gsc_words_frozen_iter_get_lines (GscWordsFrozenIter *iter,
+						  GArray *values);
+
+void		 gsc_words_frozen_iter_clear	(GscWordsFrozenIter *iter);
+
+G_END_DECLS
+
+#endif
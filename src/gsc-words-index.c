@@ -0,0 +1,2527 @@
+/*
+ *  gsc-words-index.c - Per-buffer index of the document words
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include "gsc-words-index.h"
+#include "gsc-words-tokenizer.h"
+#include "gsc-words-positions.h"
+#include "gsc-words-frozen.h"
+#include <gtksourcecompletion/gsc-utils.h>
+
+#define WORDS_INDEX_KEY "GscWordsIndex"
+
+/* Lines read from the buffer at once when scanning all the buffer */
+#define SCAN_CHUNK_LINES 2048
+
+/*
+ * Buffers (and edits) smaller than this are scanned in the main thread,
+ * bigger ones are scanned by the thread pool
+ */
+#define SYNC_SCAN_CHARS (64 * 1024)
+
+/* Smallest piece of a snapshot given to a thread */
+#define MIN_CHUNK_SIZE (1024 * 1024)
+
+/* Time the main loop gives to every idle slice of a scan, in seconds */
+#define SCAN_SLICE_TIME 0.004
+
+/* Bytes of a snapshot scanned at once in the main loop */
+#define SCAN_SLICE_BYTES (64 * 1024)
+
+/* Initial number of hash buckets of a table */
+#define MIN_BUCKETS 256
+
+/* The arena is compacted once it wastes this many bytes (and half of it) */
+#define COMPACT_BYTES (64 * 1024)
+
+/* Sequence data standing for WordsTable.key */
+#define KEY_ENTRY G_MAXUINT32
+
+/* No entry index */
+#define NO_ENTRY G_MAXUINT32
+
+/* Approximate bytes of a GSequence node */
+#define SEQUENCE_NODE_SIZE (5 * sizeof (gpointer))
+
+/* Buckets of the counters of the first two bytes of the words */
+#define PAIR_BUCKETS 1024
+#define PAIR_BUCKET(a, b) ((((guchar) (a) << 5) ^ (guchar) (b)) & (PAIR_BUCKETS - 1))
+
+typedef struct _GscWordsEntry GscWordsEntry;
+typedef struct _WordsTable WordsTable;
+typedef struct _Occurrence Occurrence;
+typedef struct _JournalEntry JournalEntry;
+typedef struct _ScanJob ScanJob;
+typedef struct _ChunkJob ChunkJob;
+typedef struct _MergeCursor MergeCursor;
+
+/*
+ * A word of a table. The entries live in an array and are referenced by
+ * their index, the words in the table arena by their offset.
+ */
+struct _GscWordsEntry
+{
+	/* Offset of the nul-terminated word in the arena */
+	guint32 word;
+	guint32 hash;
+	/* Length of the word in characters */
+	guint32 n_chars;
+	/* 0 for the free entries */
+	guint count;
+	GSequenceIter *iter;
+	/* The lines where the word is */
+	GscWordsLines lines;
+};
+
+/* A word found while a table is being built */
+struct _Occurrence
+{
+	guint32 entry;
+	guint32 line;
+};
+
+/*
+ * The words of a text. A table is only used by one thread at a time.
+ */
+struct _WordsTable
+{
+	/* The words, nul-terminated, one after another. Freed in one shot
+	   with the table. */
+	GString *arena;
+	/* Bytes of the arena used by removed words */
+	gsize dead_bytes;
+	/* GscWordsEntry */
+	GArray *entries;
+	/* Indexes of the free entries */
+	GArray *free_entries;
+	/* Open addressing with linear probing: entry index + 1, 0 is an
+	   empty bucket. n_buckets is a power of 2. */
+	guint32 *buckets;
+	guint32 n_buckets;
+	guint32 n_words;
+	/* Number of words starting with every byte and (hashed) every
+	   pair of bytes. A lookup skips the tables that can not have any
+	   word with its prefix. */
+	guint32 first_bytes[256];
+	guint32 first_pairs[PAIR_BUCKETS];
+	/* Entry indexes sorted by word, the words with the same prefix
+	   are together. NULL while a table is being built: it is sorted
+	   once at the end. */
+	GSequence *sorted;
+	/* Word compared when the sequence passes KEY_ENTRY */
+	const gchar *key;
+	/* The lines of the entries */
+	GscWordsPositions *positions;
+	/* Occurrence, only while the table is being built. The line lists
+	   are encoded once at the end. */
+	GArray *pending;
+	/* Delta applied by the current scan */
+	gint delta;
+	/* Line of the text being scanned up to line_cursor */
+	guint line;
+	const gchar *line_cursor;
+};
+
+/*
+ * An edit done while a scan was running: the words of text added or
+ * removed at line, or a shift of the lines after line if text is NULL
+ */
+struct _JournalEntry
+{
+	gchar *text;
+	gint delta;
+	guint line;
+};
+
+/*
+ * A snapshot being scanned. The snapshot is copied in idle slices, then
+ * it is split in chunks scanned in parallel and the last chunk to finish
+ * merges the results. Without a pool it is scanned in idle slices too.
+ */
+struct _ScanJob
+{
+	GscWordsIndex *index;
+	guint serial;
+	/* The snapshot while it is being copied */
+	GString *copy;
+	guint copy_line;
+	gchar *text;
+	/* Scanned up to here, only without a pool */
+	gsize scan_offset;
+	gsize len;
+	/* SHA1 of the snapshot, only if the index has a cache file */
+	GChecksum *checksum;
+	/* Where the result is saved, NULL if it is not */
+	gchar *cache_file;
+	GscWordsFrozenSource source;
+	volatile gint pending;
+	guint n_chunks;
+	WordsTable **results;
+	WordsTable *result;
+};
+
+struct _ChunkJob
+{
+	ScanJob *scan;
+	guint n;
+	gsize offset;
+	gsize len;
+};
+
+struct _GscWordsIndex
+{
+	volatile gint ref_count;
+	/* NULL when the buffer has been destroyed */
+	GtkTextBuffer *buffer;
+	GThreadPool *pool;
+	/* Last complete table, NULL until the first scan finishes */
+	WordsTable *table;
+	/* Changes every time table is replaced */
+	guint table_stamp;
+	/* Changes with every edit of the buffer */
+	guint changes;
+	/* Serial of the last scan started, older results are discarded */
+	guint scan_serial;
+	gboolean scanning;
+	/* Job of the running scan while it is copied (or scanned, without a
+	   pool) in the main loop */
+	ScanJob *idle_job;
+	guint idle_id;
+	/* Edits done since the snapshot of the running scan */
+	GArray *journal;
+	/* A big edit is rescanned in the pool once it is done */
+	gboolean rescan_after_edit;
+	/* Set before an edit for the handler run after it */
+	gboolean edit_to_line_end;
+	gint deleted_lines;
+	/* Value of use_clock when it was used the last time */
+	guint last_use;
+	/* The table has been dropped to save memory until the index is
+	   used again */
+	gboolean evicted;
+	/* Monotonic time of the last use */
+	gint64 last_use_time;
+	/* The words of an index not used for a while, compressed. table is
+	   NULL until it is thawed. */
+	GscWordsFrozen *frozen;
+	/* The file where the words are saved for the next time the document
+	   is opened, and the file of the document. The digest is the one
+	   of the saved words, if they have been loaded. */
+	gchar *cache_file;
+	GscWordsFrozenSource cache_source;
+	/* Value of changes when the document was loaded */
+	guint cache_changes;
+};
+
+/*
+ * A position in the sorted words of one index while merging all of them.
+ * It walks the table or, if table is NULL, the frozen words.
+ */
+struct _MergeCursor
+{
+	WordsTable *table;
+	GSequenceIter *iter;
+	GscWordsFrozenIter frozen;
+	const gchar *word;
+	/* G_MAXUINT until it is needed for the frozen words */
+	guint n_chars;
+	guint count;
+};
+
+/* The indexes of all the open buffers */
+static GPtrArray *all_indexes = NULL;
+
+/* Increased every time an index is used */
+static guint use_clock = 0;
+
+/* Changes every time an index is added, removed or scanned again */
+static guint all_stamp = 0;
+
+/* The words of the project files, NULL until one has been read */
+static WordsTable *project_table = NULL;
+
+#define TABLE_ENTRY(table, i) (&g_array_index ((table)->entries, GscWordsEntry, (i)))
+#define ENTRY_WORD(table, entry) ((table)->arena->str + (entry)->word)
+
+static const gchar *
+sequence_word (WordsTable *table,
+	       gconstpointer data)
+{
+	guint32 i = GPOINTER_TO_UINT (data);
+
+	if (i == KEY_ENTRY)
+		return table->key;
+
+	return ENTRY_WORD (table, TABLE_ENTRY (table, i));
+}
+
+static gint
+entry_compare (gconstpointer a,
+	       gconstpointer b,
+	       gpointer user_data)
+{
+	return strcmp (sequence_word (user_data, a),
+		       sequence_word (user_data, b));
+}
+
+/*
+ * Never returns 0 so g_sequence_search gives us the first entry
+ * greater than or equal to the key
+ */
+static gint
+entry_lower_bound (gconstpointer a,
+		   gconstpointer b,
+		   gpointer user_data)
+{
+	return entry_compare (a, b, user_data) < 0 ? -1 : 1;
+}
+
+static gint
+entry_index_compare (gconstpointer a,
+		     gconstpointer b,
+		     gpointer user_data)
+{
+	WordsTable *table = user_data;
+
+	return strcmp (ENTRY_WORD (table, TABLE_ENTRY (table, *(guint32 *) a)),
+		       ENTRY_WORD (table, TABLE_ENTRY (table, *(guint32 *) b)));
+}
+
+static guint32
+word_hash (const gchar *word,
+	   gsize len)
+{
+	guint32 hash = 5381;
+	gsize i;
+
+	for (i = 0; i < len; i++)
+		hash = hash * 33 + (guchar) word[i];
+
+	return hash;
+}
+
+static WordsTable *
+words_table_new (gboolean sorted)
+{
+	WordsTable *table = g_slice_new (WordsTable);
+
+	table->arena = g_string_sized_new (4096);
+	table->dead_bytes = 0;
+	table->entries = g_array_new (FALSE, FALSE, sizeof (GscWordsEntry));
+	table->free_entries = g_array_new (FALSE, FALSE, sizeof (guint32));
+	table->n_buckets = MIN_BUCKETS;
+	table->buckets = g_new0 (guint32, table->n_buckets);
+	table->n_words = 0;
+	memset (table->first_bytes, 0, sizeof (table->first_bytes));
+	memset (table->first_pairs, 0, sizeof (table->first_pairs));
+	table->sorted = sorted ? g_sequence_new (NULL) : NULL;
+	table->key = NULL;
+	table->positions = gsc_words_positions_new ();
+	table->pending = sorted ? NULL : g_array_new (FALSE, FALSE, sizeof (Occurrence));
+	table->delta = 0;
+	table->line = 0;
+	table->line_cursor = NULL;
+
+	return table;
+}
+
+static void
+words_table_free (WordsTable *table)
+{
+	if (table->sorted != NULL)
+		g_sequence_free (table->sorted);
+	g_string_free (table->arena, TRUE);
+	g_array_free (table->entries, TRUE);
+	g_array_free (table->free_entries, TRUE);
+	g_free (table->buckets);
+	gsc_words_positions_free (table->positions);
+	if (table->pending != NULL)
+		g_array_free (table->pending, TRUE);
+	g_slice_free (WordsTable, table);
+}
+
+/*
+ * Returns the bucket of the word, or the empty bucket where it should be
+ * inserted
+ */
+static guint32
+words_table_lookup (WordsTable *table,
+		    const gchar *word,
+		    gsize len,
+		    guint32 hash)
+{
+	guint32 mask = table->n_buckets - 1;
+	guint32 bucket = hash & mask;
+	GscWordsEntry *entry;
+	const gchar *entry_word;
+
+	while (table->buckets[bucket] != 0)
+	{
+		entry = TABLE_ENTRY (table, table->buckets[bucket] - 1);
+		entry_word = ENTRY_WORD (table, entry);
+
+		if (entry->hash == hash &&
+		    strncmp (entry_word, word, len) == 0 &&
+		    entry_word[len] == '\0')
+			return bucket;
+
+		bucket = (bucket + 1) & mask;
+	}
+
+	return bucket;
+}
+
+static void
+words_table_grow (WordsTable *table)
+{
+	guint32 *old_buckets = table->buckets;
+	guint32 old_n_buckets = table->n_buckets;
+	guint32 mask;
+	guint32 bucket;
+	guint32 i;
+
+	table->n_buckets *= 2;
+	table->buckets = g_new0 (guint32, table->n_buckets);
+	mask = table->n_buckets - 1;
+
+	for (i = 0; i < old_n_buckets; i++)
+	{
+		if (old_buckets[i] == 0)
+			continue;
+
+		bucket = TABLE_ENTRY (table, old_buckets[i] - 1)->hash & mask;
+		while (table->buckets[bucket] != 0)
+			bucket = (bucket + 1) & mask;
+
+		table->buckets[bucket] = old_buckets[i];
+	}
+
+	g_free (old_buckets);
+}
+
+/*
+ * Copies the live words to a new arena once the removed ones take most
+ * of it. The entry indexes do not change so the sorted sequence is
+ * still valid.
+ */
+static void
+words_table_compact (WordsTable *table)
+{
+	GString *arena;
+	GscWordsEntry *entry;
+	const gchar *word;
+	guint i;
+
+	arena = g_string_sized_new (table->arena->len - table->dead_bytes);
+
+	for (i = 0; i < table->entries->len; i++)
+	{
+		entry = TABLE_ENTRY (table, i);
+		if (entry->count == 0)
+			continue;
+
+		word = ENTRY_WORD (table, entry);
+		entry->word = arena->len;
+		g_string_append_len (arena, word, strlen (word) + 1);
+	}
+
+	g_string_free (table->arena, TRUE);
+	table->arena = arena;
+	table->dead_bytes = 0;
+}
+
+/*
+ * Counts a word added to (delta 1) or removed from (delta -1) the table
+ * in the prefix counters. The words are never empty.
+ */
+static void
+words_table_count_prefix (WordsTable *table,
+			  const gchar *word,
+			  gint delta)
+{
+	table->first_bytes[(guchar) word[0]] += delta;
+
+	if (word[1] != '\0')
+		table->first_pairs[PAIR_BUCKET (word[0], word[1])] += delta;
+}
+
+/*
+ * Returns FALSE if no word of the table can start with the prefix
+ */
+static gboolean
+words_table_may_have_prefix (WordsTable *table,
+			     const gchar *prefix)
+{
+	if (prefix[0] == '\0')
+		return table->n_words > 0;
+
+	if (prefix[1] == '\0')
+		return table->first_bytes[(guchar) prefix[0]] > 0;
+
+	return table->first_pairs[PAIR_BUCKET (prefix[0], prefix[1])] > 0;
+}
+
+static guint32
+words_table_insert (WordsTable *table,
+		    guint32 bucket,
+		    const gchar *word,
+		    gsize len,
+		    guint32 hash,
+		    guint count)
+{
+	GscWordsEntry *entry;
+	guint32 i;
+
+	if (table->free_entries->len > 0)
+	{
+		i = g_array_index (table->free_entries,
+				   guint32,
+				   table->free_entries->len - 1);
+		g_array_set_size (table->free_entries,
+				  table->free_entries->len - 1);
+	}
+	else
+	{
+		i = table->entries->len;
+		g_array_set_size (table->entries, i + 1);
+	}
+
+	entry = TABLE_ENTRY (table, i);
+	entry->word = table->arena->len;
+	entry->hash = hash;
+	entry->n_chars = g_utf8_strlen (word, len);
+	entry->count = count;
+	entry->iter = NULL;
+	memset (&entry->lines, 0, sizeof (GscWordsLines));
+
+	g_string_append_len (table->arena, word, len);
+	g_string_append_c (table->arena, '\0');
+
+	table->buckets[bucket] = i + 1;
+	table->n_words++;
+	words_table_count_prefix (table, ENTRY_WORD (table, entry), 1);
+
+	if (table->sorted != NULL)
+	{
+		entry->iter = g_sequence_insert_sorted (table->sorted,
+							GUINT_TO_POINTER (i),
+							entry_compare,
+							table);
+	}
+
+	return i;
+}
+
+/*
+ * Empties the bucket. The next words of the cluster are moved back so the
+ * lookups never need tombstones.
+ */
+static void
+words_table_clear_bucket (WordsTable *table,
+			  guint32 bucket)
+{
+	guint32 mask = table->n_buckets - 1;
+	guint32 next = bucket;
+	guint32 home;
+
+	for (;;)
+	{
+		table->buckets[bucket] = 0;
+
+		for (;;)
+		{
+			next = (next + 1) & mask;
+			if (table->buckets[next] == 0)
+				return;
+
+			home = TABLE_ENTRY (table, table->buckets[next] - 1)->hash & mask;
+
+			/* The word can not be moved before its home bucket */
+			if (bucket <= next ?
+			    (home <= bucket || home > next) :
+			    (home <= bucket && home > next))
+				break;
+		}
+
+		table->buckets[bucket] = table->buckets[next];
+		bucket = next;
+	}
+}
+
+static void
+words_table_remove (WordsTable *table,
+		    guint32 bucket)
+{
+	guint32 i = table->buckets[bucket] - 1;
+	GscWordsEntry *entry = TABLE_ENTRY (table, i);
+
+	if (entry->iter != NULL)
+		g_sequence_remove (entry->iter);
+
+	words_table_count_prefix (table, ENTRY_WORD (table, entry), -1);
+	table->dead_bytes += strlen (ENTRY_WORD (table, entry)) + 1;
+	gsc_words_positions_clear (table->positions, &entry->lines);
+	entry->count = 0;
+	entry->iter = NULL;
+	g_array_append_val (table->free_entries, i);
+	table->n_words--;
+
+	words_table_clear_bucket (table, bucket);
+
+	if (table->dead_bytes > COMPACT_BYTES &&
+	    table->dead_bytes > table->arena->len / 2)
+		words_table_compact (table);
+}
+
+/*
+ * Returns the entry of the word or NO_ENTRY if the word is not (or no
+ * longer) in the table
+ */
+static guint32
+words_table_add_word (WordsTable *table,
+		      const gchar *word,
+		      gsize len,
+		      gint delta)
+{
+	GscWordsEntry *entry;
+	guint32 hash = word_hash (word, len);
+	guint32 bucket;
+
+	/* Keep the load factor under 3/4 */
+	if ((table->n_words + 1) * 4 > table->n_buckets * 3)
+		words_table_grow (table);
+
+	bucket = words_table_lookup (table, word, len, hash);
+
+	if (table->buckets[bucket] == 0)
+	{
+		/* We only copy the word when it is a new one */
+		if (delta > 0)
+			return words_table_insert (table, bucket, word, len, hash, delta);
+		return NO_ENTRY;
+	}
+
+	entry = TABLE_ENTRY (table, table->buckets[bucket] - 1);
+
+	if (delta > 0 || entry->count > (guint) -delta)
+	{
+		entry->count += delta;
+		return table->buckets[bucket] - 1;
+	}
+
+	words_table_remove (table, bucket);
+	return NO_ENTRY;
+}
+
+/*
+ * Counts the line breaks like GtkTextBuffer does: \n, \r, \r\n and the
+ * paragraph separator U+2029
+ */
+static guint
+count_line_breaks (const gchar *text,
+		   const gchar *end)
+{
+	const guchar *p = (const guchar *) text;
+	guint n = 0;
+
+	for (; p < (const guchar *) end; p++)
+	{
+		if (*p == '\n')
+			n++;
+		else if (*p == '\r' && (p + 1 == (const guchar *) end || p[1] != '\n'))
+			n++;
+		else if (*p == 0xe2 && p + 2 < (const guchar *) end &&
+			 p[1] == 0x80 && p[2] == 0xa9)
+			n++;
+	}
+
+	return n;
+}
+
+static void
+update_word (const gchar *word,
+	     gsize len,
+	     gpointer user_data)
+{
+	WordsTable *table = user_data;
+	GscWordsEntry *entry;
+	Occurrence occurrence;
+	guint32 i;
+
+	table->line += count_line_breaks (table->line_cursor, word);
+	table->line_cursor = word + len;
+
+	i = words_table_add_word (table, word, len, table->delta);
+	if (i == NO_ENTRY)
+		return;
+
+	if (table->pending != NULL)
+	{
+		occurrence.entry = i;
+		occurrence.line = table->line;
+		g_array_append_val (table->pending, occurrence);
+		return;
+	}
+
+	entry = TABLE_ENTRY (table, i);
+
+	if (table->delta > 0)
+		gsc_words_positions_add (table->positions, &entry->lines, table->line);
+	else
+		gsc_words_positions_remove (table->positions, &entry->lines, table->line);
+}
+
+/*
+ * Adds (delta > 0) or removes (delta < 0) every word of the text. The text
+ * must begin and finish in word boundaries and begin at the given line.
+ * Afterwards table->line is the line where the text finishes.
+ */
+static void
+words_table_add_text (WordsTable *table,
+		      const gchar *text,
+		      gsize len,
+		      gint delta,
+		      guint line)
+{
+	table->delta = delta;
+	table->line = line;
+	table->line_cursor = text;
+
+	gsc_words_tokenize (text, len, update_word, table);
+
+	table->line += count_line_breaks (table->line_cursor, text + len);
+	table->line_cursor = NULL;
+}
+
+/*
+ * Moves the line lists of the table to a new arena, applying the logged
+ * line shifts
+ */
+static void
+words_table_rebuild_positions (WordsTable *table)
+{
+	GscWordsPositions *positions = gsc_words_positions_new ();
+	guint i;
+
+	for (i = 0; i < table->entries->len; i++)
+	{
+		gsc_words_positions_move (positions,
+					  table->positions,
+					  &TABLE_ENTRY (table, i)->lines);
+	}
+
+	gsc_words_positions_free (table->positions);
+	table->positions = positions;
+}
+
+/*
+ * The lines after after_line have moved delta lines
+ */
+static void
+words_table_shift_lines (WordsTable *table,
+			 guint after_line,
+			 gint delta)
+{
+	gsc_words_positions_shift (table->positions, after_line, delta);
+
+	if (gsc_words_positions_needs_rebuild (table->positions))
+		words_table_rebuild_positions (table);
+}
+
+/*
+ * Encodes the line lists of a table built unsorted. The occurrences of
+ * every entry are grouped keeping their order, so their lines are
+ * sorted.
+ */
+static void
+words_table_finish_lines (WordsTable *table)
+{
+	Occurrence *occurrence;
+	guint32 *starts;
+	guint32 *lines;
+	guint32 start = 0;
+	guint i;
+
+	starts = g_new (guint32, table->entries->len + 1);
+
+	for (i = 0; i < table->entries->len; i++)
+	{
+		starts[i] = start;
+		start += TABLE_ENTRY (table, i)->count;
+	}
+	starts[i] = start;
+
+	lines = g_new (guint32, MAX (start, 1));
+
+	for (i = 0; i < table->pending->len; i++)
+	{
+		occurrence = &g_array_index (table->pending, Occurrence, i);
+		lines[starts[occurrence->entry]++] = occurrence->line;
+	}
+
+	/* starts[i] is now the end of the lines of entry i */
+	start = 0;
+	for (i = 0; i < table->entries->len; i++)
+	{
+		gsc_words_positions_set (table->positions,
+					 &TABLE_ENTRY (table, i)->lines,
+					 lines + start,
+					 starts[i] - start);
+		start = starts[i];
+	}
+
+	g_free (lines);
+	g_free (starts);
+	g_array_free (table->pending, TRUE);
+	table->pending = NULL;
+}
+
+/*
+ * Estimates the memory used by a table
+ */
+static gsize
+words_table_get_size (WordsTable *table)
+{
+	return table->arena->allocated_len +
+	       table->entries->len * sizeof (GscWordsEntry) +
+	       table->free_entries->len * sizeof (guint32) +
+	       table->n_buckets * sizeof (guint32) +
+	       table->n_words * SEQUENCE_NODE_SIZE +
+	       gsc_words_positions_get_size (table->positions);
+}
+
+/*
+ * Builds the sorted sequence of a table built unsorted. Sorting an array
+ * once is much cheaper than inserting every new word in order.
+ */
+static void
+words_table_sort (WordsTable *table)
+{
+	GArray *indexes;
+	guint32 i;
+
+	indexes = g_array_sized_new (FALSE, FALSE, sizeof (guint32), table->n_words);
+
+	for (i = 0; i < table->entries->len; i++)
+	{
+		if (TABLE_ENTRY (table, i)->count > 0)
+			g_array_append_val (indexes, i);
+	}
+
+	g_array_sort_with_data (indexes, entry_index_compare, table);
+
+	table->sorted = g_sequence_new (NULL);
+
+	for (i = 0; i < indexes->len; i++)
+	{
+		GscWordsEntry *entry;
+
+		entry = TABLE_ENTRY (table, g_array_index (indexes, guint32, i));
+		entry->iter = g_sequence_append (table->sorted,
+						 GUINT_TO_POINTER (g_array_index (indexes, guint32, i)));
+	}
+
+	g_array_free (indexes, TRUE);
+
+	words_table_finish_lines (table);
+}
+
+/*
+ * Adds the words of an unsorted table to dest and frees it. The text of
+ * src was after the text of dest, beginning at first_line.
+ */
+static void
+words_table_merge (WordsTable *dest,
+		   WordsTable *src,
+		   guint first_line)
+{
+	GscWordsEntry *entry;
+	Occurrence *occurrence;
+	Occurrence moved;
+	guint32 *dest_entries;
+	const gchar *word;
+	guint i;
+
+	dest_entries = g_new (guint32, src->entries->len);
+
+	for (i = 0; i < src->entries->len; i++)
+	{
+		entry = TABLE_ENTRY (src, i);
+		word = ENTRY_WORD (src, entry);
+
+		if (entry->count == 0)
+		{
+			dest_entries[i] = NO_ENTRY;
+			continue;
+		}
+
+		dest_entries[i] = words_table_add_word (dest,
+							word,
+							strlen (word),
+							entry->count);
+	}
+
+	for (i = 0; i < src->pending->len; i++)
+	{
+		occurrence = &g_array_index (src->pending, Occurrence, i);
+		moved.entry = dest_entries[occurrence->entry];
+		moved.line = occurrence->line + first_line;
+		g_array_append_val (dest->pending, moved);
+	}
+
+	g_free (dest_entries);
+	words_table_free (src);
+}
+
+/*
+ * Returns the words of a sorted table in the compact read-only form
+ */
+static GscWordsFrozen *
+words_table_freeze (WordsTable *table)
+{
+	GscWordsFrozen *frozen;
+	GscWordsEntry *entry;
+	GSequenceIter *iter;
+	const guint32 *lines;
+	guint n_lines;
+
+	frozen = gsc_words_frozen_new ();
+
+	for (iter = g_sequence_get_begin_iter (table->sorted);
+	     !g_sequence_iter_is_end (iter);
+	     iter = g_sequence_iter_next (iter))
+	{
+		entry = TABLE_ENTRY (table, GPOINTER_TO_UINT (g_sequence_get (iter)));
+		lines = gsc_words_positions_get (table->positions,
+						 &entry->lines,
+						 &n_lines);
+
+		gsc_words_frozen_append (frozen,
+					 ENTRY_WORD (table, entry),
+					 entry->count,
+					 lines,
+					 n_lines);
+	}
+
+	gsc_words_frozen_finish (frozen);
+
+	return frozen;
+}
+
+static GscWordsIndex *
+gsc_words_index_ref (GscWordsIndex *index)
+{
+	g_atomic_int_inc (&index->ref_count);
+	return index;
+}
+
+static void
+journal_clear (GscWordsIndex *index)
+{
+	guint i;
+
+	for (i = 0; i < index->journal->len; i++)
+		g_free (g_array_index (index->journal, JournalEntry, i).text);
+
+	g_array_set_size (index->journal, 0);
+}
+
+static void
+gsc_words_index_unref (GscWordsIndex *index)
+{
+	if (!g_atomic_int_dec_and_test (&index->ref_count))
+		return;
+
+	if (index->table != NULL)
+		words_table_free (index->table);
+	if (index->frozen != NULL)
+		gsc_words_frozen_free (index->frozen);
+	g_free (index->cache_file);
+
+	journal_clear (index);
+	g_array_free (index->journal, TRUE);
+	g_free (index);
+}
+
+/*
+ * Stops the job of the running scan if it is still in the main loop. The
+ * jobs already in the pool are discarded when they finish.
+ */
+static void
+scan_job_free (ScanJob *job)
+{
+	if (job->copy != NULL)
+		g_string_free (job->copy, TRUE);
+	g_free (job->text);
+	if (job->result != NULL)
+		words_table_free (job->result);
+	if (job->checksum != NULL)
+		g_checksum_free (job->checksum);
+	g_free (job->cache_file);
+
+	gsc_words_index_unref (job->index);
+	g_slice_free (ScanJob, job);
+}
+
+static void
+scan_job_cancel (GscWordsIndex *index)
+{
+	ScanJob *job = index->idle_job;
+
+	if (job == NULL)
+		return;
+
+	g_source_remove (index->idle_id);
+	index->idle_job = NULL;
+	index->idle_id = 0;
+
+	scan_job_free (job);
+}
+
+/*
+ * Called by the buffer when it is destroyed or when the index is removed.
+ * The running jobs may keep the index alive for a while, they do not use
+ * the pool any more.
+ */
+static void
+gsc_words_index_detach (GscWordsIndex *index)
+{
+	g_ptr_array_remove_fast (all_indexes, index);
+	all_stamp++;
+
+	scan_job_cancel (index);
+
+	/* A destroyed buffer has no handlers left, a removed index has */
+	g_signal_handlers_disconnect_matched (index->buffer,
+					      G_SIGNAL_MATCH_DATA,
+					      0, 0, NULL, NULL,
+					      index);
+
+	index->buffer = NULL;
+	index->pool = NULL;
+	gsc_words_index_unref (index);
+}
+
+/*
+ * Scans the lines between range_start and range_end in chunks of lines.
+ * Every chunk begins at a line start so a word never crosses two chunks.
+ */
+static WordsTable *
+scan_range (const GtkTextIter *range_start,
+	    const GtkTextIter *range_end)
+{
+	WordsTable *table = words_table_new (FALSE);
+	GtkTextIter start = *range_start;
+	GtkTextIter end;
+	gchar *text;
+
+	while (gtk_text_iter_compare (&start, range_end) < 0)
+	{
+		end = start;
+		gtk_text_iter_forward_lines (&end, SCAN_CHUNK_LINES);
+		if (gtk_text_iter_compare (&end, range_end) > 0)
+			end = *range_end;
+
+		/* The slice keeps a 0xFFFC for every pixbuf so they are
+		   separators like in the buffer */
+		text = gtk_text_iter_get_slice (&start, &end);
+		words_table_add_text (table,
+				      text,
+				      strlen (text),
+				      1,
+				      gtk_text_iter_get_line (&start));
+		g_free (text);
+
+		start = end;
+	}
+
+	words_table_sort (table);
+
+	return table;
+}
+
+/*
+ * Runs in the main loop when a job has finished
+ */
+static gboolean
+scan_job_done (ScanJob *job)
+{
+	GscWordsIndex *index = job->index;
+	JournalEntry *entry;
+	guint i;
+
+	if (index->buffer != NULL && job->serial == index->scan_serial)
+	{
+		/* Apply the edits done since the snapshot was taken */
+		for (i = 0; i < index->journal->len; i++)
+		{
+			entry = &g_array_index (index->journal, JournalEntry, i);
+
+			if (entry->text == NULL)
+			{
+				words_table_shift_lines (job->result,
+							 entry->line,
+							 entry->delta);
+			}
+			else
+			{
+				words_table_add_text (job->result,
+						      entry->text,
+						      strlen (entry->text),
+						      entry->delta,
+						      entry->line);
+			}
+		}
+		journal_clear (index);
+
+		if (index->table != NULL)
+			words_table_free (index->table);
+
+		/* The saved words were stale */
+		if (index->frozen != NULL)
+		{
+			gsc_words_frozen_free (index->frozen);
+			index->frozen = NULL;
+		}
+		index->cache_source.digest[0] = '\0';
+
+		index->table = job->result;
+		job->result = NULL;
+		index->table_stamp++;
+		all_stamp++;
+		index->scanning = FALSE;
+	}
+
+	scan_job_free (job);
+
+	return FALSE;
+}
+
+/*
+ * Saves the words of a snapshot of the file of the document. Runs in the
+ * thread of the last chunk (or in the main loop without a pool).
+ */
+static void
+scan_job_save (ScanJob *job)
+{
+	GscWordsFrozen *frozen;
+	gchar *dir;
+
+	if (job->cache_file == NULL)
+		return;
+
+	dir = g_path_get_dirname (job->cache_file);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	frozen = words_table_freeze (job->result);
+	gsc_words_frozen_save (frozen, job->cache_file, &job->source, NULL);
+	gsc_words_frozen_free (frozen);
+}
+
+/*
+ * Runs in the thread of the last chunk
+ */
+static void
+scan_job_merge (ScanJob *job)
+{
+	guint first_line;
+	guint n_lines;
+	guint i;
+
+	/* The chunks are merged in order so the lines of every word stay
+	   sorted */
+	job->result = job->results[0];
+	first_line = job->result->line;
+
+	for (i = 1; i < job->n_chunks; i++)
+	{
+		n_lines = job->results[i]->line;
+		words_table_merge (job->result, job->results[i], first_line);
+		first_line += n_lines;
+	}
+
+	words_table_sort (job->result);
+	scan_job_save (job);
+
+	g_free (job->results);
+	job->results = NULL;
+	g_free (job->text);
+	job->text = NULL;
+
+	g_idle_add ((GSourceFunc) scan_job_done, job);
+}
+
+/*
+ * Runs in a thread of the pool. It only uses the job data and writes its
+ * own result slot.
+ */
+static void
+chunk_job_run (ChunkJob *chunk,
+	       gpointer user_data)
+{
+	ScanJob *job = chunk->scan;
+	WordsTable *table;
+
+	table = words_table_new (FALSE);
+	words_table_add_text (table, job->text + chunk->offset, chunk->len, 1, 0);
+	job->results[chunk->n] = table;
+
+	g_slice_free (ChunkJob, chunk);
+
+	if (g_atomic_int_dec_and_test (&job->pending))
+		scan_job_merge (job);
+}
+
+/*
+ * Returns where a chunk of text can finish: the first separator at or
+ * after pos, but never between the \r and the \n of a line break, which
+ * would be counted twice.
+ */
+static gsize
+find_chunk_end (const gchar *text,
+		gsize len,
+		gsize pos)
+{
+	pos = gsc_words_tokenizer_next_boundary (text, len, pos);
+
+	if (pos > 0 && pos < len && text[pos] == '\n' && text[pos - 1] == '\r')
+		pos++;
+
+	return pos;
+}
+
+static gint
+get_n_cpus (void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	glong n = sysconf (_SC_NPROCESSORS_ONLN);
+
+	if (n > 0)
+		return (gint) n;
+#endif
+	return 1;
+}
+
+/*
+ * Splits the snapshot in one chunk per thread (chunks are never smaller
+ * than MIN_CHUNK_SIZE) and pushes them to the pool. Chunks are cut at
+ * ASCII separators so no word is split.
+ */
+static void
+scan_job_push (ScanJob *job,
+	       GThreadPool *pool)
+{
+	ChunkJob *chunk;
+	gsize len = strlen (job->text);
+	gsize start = 0;
+	gsize end;
+	gint n_threads;
+	guint i;
+
+	n_threads = g_thread_pool_get_max_threads (pool);
+	if (n_threads <= 0)
+		n_threads = get_n_cpus ();
+
+	job->n_chunks = CLAMP (len / MIN_CHUNK_SIZE, 1, (guint) n_threads);
+	job->results = g_new0 (WordsTable *, job->n_chunks);
+	job->pending = job->n_chunks;
+
+	for (i = 0; i < job->n_chunks; i++)
+	{
+		if (i == job->n_chunks - 1)
+			end = len;
+		else
+			end = find_chunk_end (job->text,
+					      len,
+					      MAX (start, len / job->n_chunks * (i + 1)));
+
+		chunk = g_slice_new (ChunkJob);
+		chunk->scan = job;
+		chunk->n = i;
+		chunk->offset = start;
+		chunk->len = end - start;
+
+		g_thread_pool_push (pool, chunk, NULL);
+
+		start = end;
+	}
+}
+
+/*
+ * Copies the next lines of the buffer to the snapshot. Returns TRUE when
+ * the whole buffer has been copied.
+ */
+static gboolean
+scan_job_copy_step (ScanJob *job)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+	gchar *text;
+
+	gtk_text_buffer_get_iter_at_line (job->index->buffer, &start, job->copy_line);
+	end = start;
+	gtk_text_iter_forward_lines (&end, SCAN_CHUNK_LINES);
+
+	text = gtk_text_iter_get_slice (&start, &end);
+	g_string_append (job->copy, text);
+	if (job->checksum != NULL)
+		g_checksum_update (job->checksum, (const guchar *) text, -1);
+	g_free (text);
+
+	job->copy_line += SCAN_CHUNK_LINES;
+
+	return gtk_text_iter_is_end (&end);
+}
+
+/*
+ * Compares the snapshot with the text the saved words come from. If it is
+ * the same the scan is not needed: the job is freed and TRUE returned.
+ * Otherwise the result is saved if the snapshot is the text of the file.
+ */
+static gboolean
+scan_job_check_cache (ScanJob *job)
+{
+	GscWordsIndex *index = job->index;
+	const gchar *digest = g_checksum_get_string (job->checksum);
+
+	if (strcmp (digest, index->cache_source.digest) == 0)
+	{
+		/* The edits done since the snapshot are already in the
+		   served words */
+		journal_clear (index);
+		index->idle_job = NULL;
+		index->scanning = FALSE;
+		scan_job_free (job);
+		return TRUE;
+	}
+
+	if (index->changes == index->cache_changes)
+	{
+		job->cache_file = g_strdup (index->cache_file);
+		job->source = index->cache_source;
+		g_strlcpy (job->source.digest, digest, sizeof (job->source.digest));
+	}
+
+	return FALSE;
+}
+
+/*
+ * The snapshot is complete: it goes to the pool or, without a pool, it is
+ * scanned in the next idle slices
+ */
+static void
+scan_job_copied (ScanJob *job)
+{
+	GscWordsIndex *index = job->index;
+
+	job->len = job->copy->len;
+	job->text = g_string_free (job->copy, FALSE);
+	job->copy = NULL;
+
+	if (job->checksum != NULL && scan_job_check_cache (job))
+		return;
+
+	if (index->pool == NULL)
+	{
+		job->result = words_table_new (FALSE);
+		return;
+	}
+
+	index->idle_job = NULL;
+	scan_job_push (job, index->pool);
+}
+
+/*
+ * Scans the next piece of the snapshot in the main loop. Returns TRUE
+ * when the whole snapshot has been scanned.
+ */
+static gboolean
+scan_job_scan_step (ScanJob *job)
+{
+	gsize end;
+
+	end = find_chunk_end (job->text,
+			      job->len,
+			      MIN (job->scan_offset + SCAN_SLICE_BYTES, job->len));
+
+	words_table_add_text (job->result,
+			      job->text + job->scan_offset,
+			      end - job->scan_offset,
+			      1,
+			      job->result->line);
+	job->scan_offset = end;
+
+	return end == job->len;
+}
+
+/*
+ * Works on the running scan for SCAN_SLICE_TIME and gives the control
+ * back to the main loop
+ */
+static gboolean
+scan_job_idle (ScanJob *job)
+{
+	GscWordsIndex *index = job->index;
+	GTimer *timer = g_timer_new ();
+
+	do
+	{
+		if (job->copy != NULL)
+		{
+			if (scan_job_copy_step (job))
+				scan_job_copied (job);
+		}
+		else if (scan_job_scan_step (job))
+		{
+			words_table_sort (job->result);
+			scan_job_save (job);
+			g_free (job->text);
+			job->text = NULL;
+
+			index->idle_job = NULL;
+			scan_job_done (job);
+		}
+	}
+	while (index->idle_job != NULL &&
+	       g_timer_elapsed (timer, NULL) < SCAN_SLICE_TIME);
+
+	g_timer_destroy (timer);
+
+	if (index->idle_job != NULL)
+		return TRUE;
+
+	index->idle_id = 0;
+	return FALSE;
+}
+
+/*
+ * Called before an edit: the snapshot must not see it, so the rest of the
+ * buffer is copied right now
+ */
+static void
+scan_job_finish_copy (GscWordsIndex *index)
+{
+	ScanJob *job = index->idle_job;
+
+	if (job == NULL || job->copy == NULL)
+		return;
+
+	while (!scan_job_copy_step (job))
+		;
+	scan_job_copied (job);
+
+	if (index->idle_job == NULL)
+	{
+		g_source_remove (index->idle_id);
+		index->idle_id = 0;
+	}
+}
+
+/*
+ * Rebuilds the table. Small buffers are scanned right now. The big ones
+ * are copied in idle slices and scanned in the pool (or in idle slices
+ * without a pool): the current table (if any) is served until the new one
+ * is ready.
+ */
+static void
+start_scan (GscWordsIndex *index)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+	ScanJob *job;
+	gint n_chars;
+
+	index->scan_serial++;
+	journal_clear (index);
+	scan_job_cancel (index);
+
+	n_chars = gtk_text_buffer_get_char_count (index->buffer);
+
+	if (n_chars <= SYNC_SCAN_CHARS)
+	{
+		if (index->table != NULL)
+			words_table_free (index->table);
+		if (index->frozen != NULL)
+		{
+			gsc_words_frozen_free (index->frozen);
+			index->frozen = NULL;
+		}
+
+		gtk_text_buffer_get_bounds (index->buffer, &start, &end);
+		index->table = scan_range (&start, &end);
+		index->table_stamp++;
+		all_stamp++;
+		index->scanning = FALSE;
+		return;
+	}
+
+	job = g_slice_new0 (ScanJob);
+	job->index = gsc_words_index_ref (index);
+	job->serial = index->scan_serial;
+	job->copy = g_string_sized_new (n_chars + 1);
+	if (index->cache_file != NULL)
+		job->checksum = g_checksum_new (G_CHECKSUM_SHA1);
+
+	index->scanning = TRUE;
+	index->idle_job = job;
+	index->idle_id = g_idle_add_full (G_PRIORITY_LOW,
+					  (GSourceFunc) scan_job_idle,
+					  job,
+					  NULL);
+}
+
+/*
+ * Adds or removes the words between start and end from the served table
+ * and records the edit if a scan is running. The range must begin and
+ * finish in word boundaries.
+ */
+static void
+apply_edit (GscWordsIndex *index,
+	    const GtkTextIter *start,
+	    const GtkTextIter *end,
+	    gint delta)
+{
+	JournalEntry entry;
+
+	if (gtk_text_iter_equal (start, end) || index->evicted)
+		return;
+
+	entry.text = gtk_text_iter_get_slice (start, end);
+	entry.delta = delta;
+	entry.line = gtk_text_iter_get_line (start);
+
+	if (index->table != NULL)
+	{
+		words_table_add_text (index->table,
+				      entry.text,
+				      strlen (entry.text),
+				      delta,
+				      entry.line);
+	}
+
+	if (index->scanning)
+		g_array_append_val (index->journal, entry);
+	else
+		g_free (entry.text);
+}
+
+/*
+ * The lines after after_line have moved delta lines
+ */
+static void
+apply_shift (GscWordsIndex *index,
+	     guint after_line,
+	     gint delta)
+{
+	JournalEntry entry;
+
+	if (delta == 0)
+		return;
+
+	if (index->table != NULL)
+		words_table_shift_lines (index->table, after_line, delta);
+
+	if (index->scanning)
+	{
+		entry.text = NULL;
+		entry.delta = delta;
+		entry.line = after_line;
+		g_array_append_val (index->journal, entry);
+	}
+}
+
+/*
+ * Moves start back until it is in a word boundary and end forward until
+ * it is in a word boundary or, if to_line_end, at the end of its line:
+ * when an edit adds or removes lines the words after it on the same line
+ * move to another line.
+ */
+static void
+extend_edit_bounds (GtkTextIter *start,
+		    GtkTextIter *end,
+		    gboolean to_line_end)
+{
+	GtkTextIter prev = *start;
+
+	while (gtk_text_iter_backward_char (&prev) &&
+	       !gsc_utils_is_separator (gtk_text_iter_get_char (&prev)))
+	{
+		*start = prev;
+	}
+
+	if (to_line_end)
+	{
+		if (!gtk_text_iter_ends_line (end))
+			gtk_text_iter_forward_to_line_end (end);
+		return;
+	}
+
+	while (!gtk_text_iter_is_end (end) &&
+	       !gsc_utils_is_separator (gtk_text_iter_get_char (end)))
+	{
+		gtk_text_iter_forward_char (end);
+	}
+}
+
+/*
+ * Compresses the words of an index not used for a while. The words do not
+ * change so the stamps are kept.
+ */
+static void
+gsc_words_index_freeze (GscWordsIndex *index)
+{
+	/* A running scan would replace the table */
+	if (index->table == NULL || index->scanning)
+		return;
+
+	index->frozen = words_table_freeze (index->table);
+	words_table_free (index->table);
+	index->table = NULL;
+}
+
+/*
+ * Rebuilds the table of a frozen index. The words come out sorted so the
+ * sequence is built by appending, without comparing any word.
+ */
+static void
+gsc_words_index_thaw (GscWordsIndex *index)
+{
+	WordsTable *table;
+	GscWordsFrozenIter iter;
+	GscWordsEntry *entry;
+	GArray *lines;
+	gboolean found;
+	guint32 i;
+
+	table = words_table_new (FALSE);
+	g_array_free (table->pending, TRUE);
+	table->pending = NULL;
+
+	lines = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	for (found = gsc_words_frozen_iter_init (&iter, index->frozen, "");
+	     found;
+	     found = gsc_words_frozen_iter_next (&iter))
+	{
+		i = words_table_add_word (table,
+					  iter.word->str,
+					  iter.word->len,
+					  iter.count);
+		if (i == NO_ENTRY)
+			continue;
+
+		gsc_words_frozen_iter_get_lines (&iter, lines);
+		gsc_words_positions_set (table->positions,
+					 &TABLE_ENTRY (table, i)->lines,
+					 (guint32 *) lines->data,
+					 lines->len);
+	}
+
+	gsc_words_frozen_iter_clear (&iter);
+	g_array_free (lines, TRUE);
+
+	table->sorted = g_sequence_new (NULL);
+	for (i = 0; i < table->entries->len; i++)
+	{
+		entry = TABLE_ENTRY (table, i);
+		if (entry->count == 0)
+			continue;
+
+		entry->iter = g_sequence_append (table->sorted, GUINT_TO_POINTER (i));
+	}
+
+	gsc_words_frozen_free (index->frozen);
+	index->frozen = NULL;
+	index->table = table;
+	index->last_use_time = g_get_monotonic_time ();
+}
+
+/*
+ * Before the insertion: the word around the location will be split or
+ * extended, so we remove it.
+ */
+static void
+insert_text_cb (GtkTextBuffer *buffer,
+		GtkTextIter *location,
+		gchar *text,
+		gint len,
+		GscWordsIndex *index)
+{
+	GtkTextIter start = *location;
+	GtkTextIter end = *location;
+
+	if (index->frozen != NULL)
+		gsc_words_index_thaw (index);
+
+	/* len is in bytes, never fewer than the chars: only a long text
+	   has to be counted */
+	if (index->pool != NULL && len > SYNC_SCAN_CHARS &&
+	    g_utf8_strlen (text, len) > SYNC_SCAN_CHARS)
+	{
+		index->rescan_after_edit = TRUE;
+		return;
+	}
+
+	scan_job_finish_copy (index);
+
+	index->edit_to_line_end = count_line_breaks (text, text + len) > 0;
+
+	extend_edit_bounds (&start, &end, index->edit_to_line_end);
+	apply_edit (index, &start, &end, -1);
+}
+
+/*
+ * After the insertion: location points to the end of the new text. We
+ * move the next lines and add the new words and the words at the edges.
+ */
+static void
+insert_text_after_cb (GtkTextBuffer *buffer,
+		      GtkTextIter *location,
+		      gchar *text,
+		      gint len,
+		      GscWordsIndex *index)
+{
+	GtkTextIter start = *location;
+	GtkTextIter end = *location;
+	gint line;
+
+	index->changes++;
+
+	if (index->rescan_after_edit)
+	{
+		index->rescan_after_edit = FALSE;
+		if (!index->evicted)
+			start_scan (index);
+		return;
+	}
+
+	gtk_text_iter_backward_chars (&start, g_utf8_strlen (text, len));
+
+	line = gtk_text_iter_get_line (&start);
+	apply_shift (index, line, gtk_text_iter_get_line (location) - line);
+
+	extend_edit_bounds (&start, &end, index->edit_to_line_end);
+	apply_edit (index, &start, &end, 1);
+}
+
+static void
+delete_range_cb (GtkTextBuffer *buffer,
+		 GtkTextIter *start,
+		 GtkTextIter *end,
+		 GscWordsIndex *index)
+{
+	GtkTextIter word_start = *start;
+	GtkTextIter word_end = *end;
+
+	if (index->frozen != NULL)
+		gsc_words_index_thaw (index);
+
+	if (index->pool != NULL &&
+	    gtk_text_iter_get_offset (end) - gtk_text_iter_get_offset (start) > SYNC_SCAN_CHARS)
+	{
+		index->rescan_after_edit = TRUE;
+		return;
+	}
+
+	scan_job_finish_copy (index);
+
+	index->deleted_lines = gtk_text_iter_get_line (end) -
+			       gtk_text_iter_get_line (start);
+
+	extend_edit_bounds (&word_start, &word_end, index->deleted_lines > 0);
+	apply_edit (index, &word_start, &word_end, -1);
+}
+
+/*
+ * After the deletion start and end point to the same place. The words at
+ * both edges may have been joined.
+ */
+static void
+delete_range_after_cb (GtkTextBuffer *buffer,
+		       GtkTextIter *start,
+		       GtkTextIter *end,
+		       GscWordsIndex *index)
+{
+	GtkTextIter word_start = *start;
+	GtkTextIter word_end = *start;
+	gint line;
+
+	index->changes++;
+
+	if (index->rescan_after_edit)
+	{
+		index->rescan_after_edit = FALSE;
+		if (!index->evicted)
+			start_scan (index);
+		return;
+	}
+
+	line = gtk_text_iter_get_line (start);
+	apply_shift (index, line + index->deleted_lines, -index->deleted_lines);
+
+	extend_edit_bounds (&word_start, &word_end, index->deleted_lines > 0);
+	apply_edit (index, &word_start, &word_end, 1);
+}
+
+GThreadPool *
+gsc_words_index_pool_new (gint max_threads)
+{
+	if (max_threads <= 0)
+		max_threads = get_n_cpus ();
+
+	return g_thread_pool_new ((GFunc) chunk_job_run,
+				  NULL,
+				  max_threads,
+				  FALSE,
+				  NULL);
+}
+
+/*
+ * Serves the words saved the last time the document was opened if they
+ * were saved for the same file. The next scan compares the text of the
+ * buffer with the text they come from.
+ */
+static void
+load_cache (GscWordsIndex *index)
+{
+	GscWordsFrozenSource source;
+	GscWordsFrozen *frozen;
+
+	index->cache_source.digest[0] = '\0';
+
+	/* Small buffers are scanned at once */
+	if (gtk_text_buffer_get_char_count (index->buffer) <= SYNC_SCAN_CHARS)
+		return;
+
+	frozen = gsc_words_frozen_map (index->cache_file, &source, NULL);
+	if (frozen == NULL)
+		return;
+
+	/* The document has changed since, the file is rewritten by the
+	   next scan */
+	if (source.mtime != index->cache_source.mtime ||
+	    source.size != index->cache_source.size)
+	{
+		gsc_words_frozen_free (frozen);
+		g_unlink (index->cache_file);
+		return;
+	}
+
+	/* The saved words are pruned by modification time: these ones are
+	   still in use */
+	g_utime (index->cache_file, NULL);
+
+	if (index->table != NULL)
+	{
+		words_table_free (index->table);
+		index->table = NULL;
+	}
+
+	index->frozen = frozen;
+	index->cache_source = source;
+	index->table_stamp++;
+	all_stamp++;
+}
+
+/*
+ * Creates the index of the buffer, without words
+ */
+static GscWordsIndex *
+gsc_words_index_new (GtkTextBuffer *buffer,
+		     GThreadPool *pool)
+{
+	GscWordsIndex *index;
+
+	index = g_new0 (GscWordsIndex, 1);
+	index->ref_count = 1;
+	index->buffer = buffer;
+	index->pool = pool;
+	index->journal = g_array_new (FALSE, FALSE, sizeof (JournalEntry));
+	index->last_use_time = g_get_monotonic_time ();
+
+	g_signal_connect (buffer, "insert-text",
+			  G_CALLBACK (insert_text_cb), index);
+	g_signal_connect_after (buffer, "insert-text",
+				G_CALLBACK (insert_text_after_cb), index);
+	g_signal_connect (buffer, "delete-range",
+			  G_CALLBACK (delete_range_cb), index);
+	g_signal_connect_after (buffer, "delete-range",
+				G_CALLBACK (delete_range_after_cb), index);
+
+	if (all_indexes == NULL)
+		all_indexes = g_ptr_array_new ();
+
+	g_ptr_array_add (all_indexes, index);
+	all_stamp++;
+
+	/* The buffer disconnects the handlers before destroying its data */
+	g_object_set_data_full (G_OBJECT (buffer),
+				WORDS_INDEX_KEY,
+				index,
+				(GDestroyNotify) gsc_words_index_detach);
+
+	return index;
+}
+
+void
+gsc_words_index_remove (GtkTextBuffer *buffer)
+{
+	g_object_set_data (G_OBJECT (buffer), WORDS_INDEX_KEY, NULL);
+}
+
+void
+gsc_words_index_remove_all (void)
+{
+	GscWordsIndex *index;
+
+	/* Every removal takes the index out of all_indexes */
+	while (all_indexes != NULL && all_indexes->len > 0)
+	{
+		index = g_ptr_array_index (all_indexes, all_indexes->len - 1);
+		gsc_words_index_remove (index->buffer);
+	}
+}
+
+GscWordsIndex *
+gsc_words_index_get_for_buffer (GtkTextBuffer *buffer,
+				GThreadPool *pool)
+{
+	GscWordsIndex *index;
+
+	index = g_object_get_data (G_OBJECT (buffer), WORDS_INDEX_KEY);
+	if (index == NULL)
+	{
+		index = gsc_words_index_new (buffer, pool);
+		start_scan (index);
+	}
+	else if (index->evicted)
+	{
+		index->evicted = FALSE;
+		if (index->cache_file != NULL)
+			load_cache (index);
+		start_scan (index);
+	}
+
+	return index;
+}
+
+static void
+set_cache_file (GscWordsIndex *index,
+		const gchar *cache_file,
+		guint64 mtime,
+		guint64 size)
+{
+	g_free (index->cache_file);
+	index->cache_file = g_strdup (cache_file);
+	index->cache_source.mtime = mtime;
+	index->cache_source.size = size;
+	index->cache_source.digest[0] = '\0';
+	index->cache_changes = index->changes;
+}
+
+GscWordsIndex *
+gsc_words_index_warm (GtkTextBuffer *buffer,
+		      GThreadPool *pool,
+		      const GtkTextIter *first,
+		      const GtkTextIter *last,
+		      const gchar *cache_file,
+		      guint64 mtime,
+		      guint64 size)
+{
+	GscWordsIndex *index;
+	GtkTextIter start = *first;
+	GtkTextIter end = *last;
+
+	index = g_object_get_data (G_OBJECT (buffer), WORDS_INDEX_KEY);
+	if (index != NULL)
+	{
+		/* The file has been loaded again */
+		if (cache_file != NULL &&
+		    (index->cache_file == NULL ||
+		     index->cache_source.mtime != mtime ||
+		     index->cache_source.size != size))
+			set_cache_file (index, cache_file, mtime, size);
+		return index;
+	}
+
+	index = gsc_words_index_new (buffer, pool);
+
+	if (cache_file != NULL)
+	{
+		set_cache_file (index, cache_file, mtime, size);
+		load_cache (index);
+	}
+
+	/* The visible lines are served while the whole buffer is scanned */
+	if (index->frozen == NULL &&
+	    gtk_text_buffer_get_char_count (buffer) > SYNC_SCAN_CHARS)
+	{
+		gtk_text_iter_order (&start, &end);
+		gtk_text_iter_set_line_offset (&start, 0);
+		if (!gtk_text_iter_starts_line (&end))
+			gtk_text_iter_forward_line (&end);
+
+		index->table = scan_range (&start, &end);
+		index->table_stamp++;
+		all_stamp++;
+	}
+
+	start_scan (index);
+
+	return index;
+}
+
+/*
+ * Returns the first entry of the table with the prefix
+ */
+static GSequenceIter *
+words_table_search (WordsTable *table,
+		    const gchar *prefix)
+{
+	GSequenceIter *iter;
+
+	table->key = prefix;
+	iter = g_sequence_search (table->sorted,
+				  GUINT_TO_POINTER (KEY_ENTRY),
+				  entry_lower_bound,
+				  table);
+	table->key = NULL;
+
+	return iter;
+}
+
+static void
+words_frozen_foreach_prefix (GscWordsFrozen *frozen,
+			     const gchar *prefix,
+			     GscWordsIndexFunc func,
+			     gpointer user_data)
+{
+	GscWordsFrozenIter iter;
+	gboolean found;
+	gsize len = strlen (prefix);
+
+	if (!gsc_words_frozen_may_have_prefix (frozen, prefix))
+		return;
+
+	for (found = gsc_words_frozen_iter_init (&iter, frozen, prefix);
+	     found && strncmp (iter.word->str, prefix, len) == 0;
+	     found = gsc_words_frozen_iter_next (&iter))
+	{
+		if (!func (iter.word->str,
+			   g_utf8_strlen (iter.word->str, iter.word->len),
+			   iter.count,
+			   user_data))
+			break;
+	}
+
+	gsc_words_frozen_iter_clear (&iter);
+}
+
+void
+gsc_words_index_foreach_prefix (GscWordsIndex *index,
+				const gchar *prefix,
+				GscWordsIndexFunc func,
+				gpointer user_data)
+{
+	WordsTable *table = index->table;
+	GscWordsEntry *entry;
+	GSequenceIter *iter;
+	const gchar *word;
+	gsize len = strlen (prefix);
+
+	if (index->frozen != NULL)
+	{
+		words_frozen_foreach_prefix (index->frozen, prefix, func, user_data);
+		return;
+	}
+
+	if (table == NULL || !words_table_may_have_prefix (table, prefix))
+		return;
+
+	iter = words_table_search (table, prefix);
+
+	while (!g_sequence_iter_is_end (iter))
+	{
+		entry = TABLE_ENTRY (table, GPOINTER_TO_UINT (g_sequence_get (iter)));
+		word = ENTRY_WORD (table, entry);
+
+		if (strncmp (word, prefix, len) != 0)
+			break;
+
+		if (!func (word, entry->n_chars, entry->count, user_data))
+			break;
+
+		iter = g_sequence_iter_next (iter);
+	}
+}
+
+/*
+ * Points the cursor to its current entry. Returns FALSE when there are no
+ * more words with the prefix.
+ */
+static gboolean
+merge_cursor_load (MergeCursor *cursor,
+		   const gchar *prefix,
+		   gsize len)
+{
+	WordsTable *table = cursor->table;
+	GscWordsEntry *entry;
+
+	if (table == NULL)
+	{
+		cursor->word = cursor->frozen.word->str;
+		cursor->n_chars = G_MAXUINT;
+		cursor->count = cursor->frozen.count;
+	}
+	else
+	{
+		if (g_sequence_iter_is_end (cursor->iter))
+			return FALSE;
+
+		entry = TABLE_ENTRY (table, GPOINTER_TO_UINT (g_sequence_get (cursor->iter)));
+		cursor->word = ENTRY_WORD (table, entry);
+		cursor->n_chars = entry->n_chars;
+		cursor->count = entry->count;
+	}
+
+	return strncmp (cursor->word, prefix, len) == 0;
+}
+
+static gboolean
+merge_cursor_next (MergeCursor *cursor,
+		   const gchar *prefix,
+		   gsize len)
+{
+	if (cursor->table != NULL)
+		cursor->iter = g_sequence_iter_next (cursor->iter);
+	else if (!gsc_words_frozen_iter_next (&cursor->frozen))
+		return FALSE;
+
+	return merge_cursor_load (cursor, prefix, len);
+}
+
+static void
+merge_cursor_clear (MergeCursor *cursor)
+{
+	if (cursor->table == NULL)
+		gsc_words_frozen_iter_clear (&cursor->frozen);
+}
+
+/*
+ * Min-heap of cursors by their current word
+ */
+static void
+merge_heap_sift_down (MergeCursor *heap,
+		      guint size,
+		      guint i)
+{
+	MergeCursor tmp = heap[i];
+	guint child;
+
+	while ((child = 2 * i + 1) < size)
+	{
+		if (child + 1 < size &&
+		    strcmp (heap[child + 1].word, heap[child].word) < 0)
+			child++;
+
+		if (strcmp (heap[child].word, tmp.word) >= 0)
+			break;
+
+		heap[i] = heap[child];
+		i = child;
+	}
+
+	heap[i] = tmp;
+}
+
+void
+gsc_words_index_foreach_prefix_all (const gchar *prefix,
+				    GscWordsIndexFunc func,
+				    gpointer user_data)
+{
+	gsc_words_index_foreach_prefix_all_after (prefix, NULL, func, user_data);
+}
+
+void
+gsc_words_index_foreach_prefix_all_after (const gchar *prefix,
+					  const gchar *after,
+					  GscWordsIndexFunc func,
+					  gpointer user_data)
+{
+	GscWordsIndex *index;
+	MergeCursor *heap;
+	GString *word;
+	const gchar *key = after != NULL ? after : prefix;
+	guint n_chars;
+	guint count;
+	guint size = 0;
+	guint n_indexes = all_indexes != NULL ? all_indexes->len : 0;
+	gsize len = strlen (prefix);
+	guint i;
+
+	/* One cursor per index and one for the project */
+	heap = g_new (MergeCursor, n_indexes + 1);
+
+	for (i = 0; i < n_indexes; i++)
+	{
+		index = g_ptr_array_index (all_indexes, i);
+		heap[size].table = index->table;
+
+		/* Most documents are discarded without a search */
+		if (index->frozen != NULL)
+		{
+			if (!gsc_words_frozen_may_have_prefix (index->frozen, prefix))
+				continue;
+
+			if (!gsc_words_frozen_iter_init (&heap[size].frozen,
+							 index->frozen,
+							 key))
+			{
+				gsc_words_frozen_iter_clear (&heap[size].frozen);
+				continue;
+			}
+		}
+		else if (index->table != NULL &&
+			 words_table_may_have_prefix (index->table, prefix))
+		{
+			heap[size].iter = words_table_search (index->table, key);
+		}
+		else
+		{
+			continue;
+		}
+
+		if (merge_cursor_load (&heap[size], prefix, len))
+			size++;
+		else
+			merge_cursor_clear (&heap[size]);
+	}
+
+	if (project_table != NULL &&
+	    words_table_may_have_prefix (project_table, prefix))
+	{
+		heap[size].table = project_table;
+		heap[size].iter = words_table_search (project_table, key);
+
+		if (merge_cursor_load (&heap[size], prefix, len))
+			size++;
+		else
+			merge_cursor_clear (&heap[size]);
+	}
+
+	for (i = size / 2; i > 0; i--)
+		merge_heap_sift_down (heap, size, i - 1);
+
+	/* The current word is copied: the cursors of the frozen indexes
+	   rewrite theirs at every step */
+	word = g_string_new (NULL);
+
+	/* Every index gives its words sorted: the same word of several
+	   documents comes out once with all its occurrences */
+	while (size > 0)
+	{
+		g_string_assign (word, heap[0].word);
+		n_chars = heap[0].n_chars;
+		count = 0;
+
+		while (size > 0 && strcmp (heap[0].word, word->str) == 0)
+		{
+			count += heap[0].count;
+
+			if (!merge_cursor_next (&heap[0], prefix, len))
+			{
+				merge_cursor_clear (&heap[0]);
+				heap[0] = heap[--size];
+			}
+
+			merge_heap_sift_down (heap, size, 0);
+		}
+
+		/* after was visited already, it can only be the first word */
+		if (after != NULL && strcmp (word->str, after) == 0)
+			continue;
+
+		if (n_chars == G_MAXUINT)
+			n_chars = g_utf8_strlen (word->str, word->len);
+
+		if (!func (word->str, n_chars, count, user_data))
+			break;
+	}
+
+	for (i = 0; i < size; i++)
+		merge_cursor_clear (&heap[i]);
+
+	g_string_free (word, TRUE);
+	g_free (heap);
+}
+
+guint
+gsc_words_index_get_stamp (GscWordsIndex *index)
+{
+	return index->table_stamp;
+}
+
+guint
+gsc_words_index_get_changes (GscWordsIndex *index)
+{
+	return index->changes;
+}
+
+static guint
+words_frozen_get_distance (GscWordsFrozen *frozen,
+			   const gchar *word,
+			   guint line)
+{
+	GscWordsFrozenIter iter;
+	GArray *lines;
+	guint32 value;
+	guint distance = G_MAXUINT;
+	guint i;
+
+	if (gsc_words_frozen_iter_init (&iter, frozen, word) &&
+	    strcmp (iter.word->str, word) == 0)
+	{
+		lines = g_array_new (FALSE, FALSE, sizeof (guint32));
+		gsc_words_frozen_iter_get_lines (&iter, lines);
+
+		for (i = 0; i < lines->len; i++)
+		{
+			value = g_array_index (lines, guint32, i);
+			distance = MIN (distance, value > line ? value - line : line - value);
+		}
+
+		g_array_free (lines, TRUE);
+	}
+
+	gsc_words_frozen_iter_clear (&iter);
+
+	return distance;
+}
+
+guint
+gsc_words_index_get_distance (GscWordsIndex *index,
+			      const gchar *word,
+			      guint line)
+{
+	WordsTable *table = index->table;
+	gsize len = strlen (word);
+	guint32 bucket;
+
+	if (index->frozen != NULL)
+		return words_frozen_get_distance (index->frozen, word, line);
+
+	if (table == NULL)
+		return G_MAXUINT;
+
+	bucket = words_table_lookup (table, word, len, word_hash (word, len));
+	if (table->buckets[bucket] == 0)
+		return G_MAXUINT;
+
+	return gsc_words_positions_get_distance (table->positions,
+						 &TABLE_ENTRY (table, table->buckets[bucket] - 1)->lines,
+						 line);
+}
+
+void
+gsc_words_index_touch (GtkTextBuffer *buffer,
+		       GThreadPool *pool)
+{
+	GscWordsIndex *index;
+
+	if (g_object_get_data (G_OBJECT (buffer), WORDS_INDEX_KEY) == NULL)
+		return;
+
+	index = gsc_words_index_get_for_buffer (buffer, pool);
+	index->last_use = ++use_clock;
+	index->last_use_time = g_get_monotonic_time ();
+
+	/* The words loaded from the cache wait for the first edit */
+	if (index->frozen != NULL && index->cache_source.digest[0] == '\0')
+		gsc_words_index_thaw (index);
+}
+
+/*
+ * Drops the words of the index until it is used again
+ */
+static void
+gsc_words_index_evict (GscWordsIndex *index)
+{
+	index->scan_serial++;
+	journal_clear (index);
+	scan_job_cancel (index);
+	index->scanning = FALSE;
+
+	if (index->table != NULL)
+	{
+		words_table_free (index->table);
+		index->table = NULL;
+	}
+
+	if (index->frozen != NULL)
+	{
+		gsc_words_frozen_free (index->frozen);
+		index->frozen = NULL;
+	}
+
+	index->evicted = TRUE;
+	index->table_stamp++;
+	all_stamp++;
+}
+
+static gsize
+gsc_words_index_get_size (GscWordsIndex *index)
+{
+	if (index->frozen != NULL)
+		return gsc_words_frozen_get_size (index->frozen);
+
+	if (index->table != NULL)
+		return words_table_get_size (index->table);
+
+	return 0;
+}
+
+void
+gsc_words_index_freeze_unused (guint seconds)
+{
+	GscWordsIndex *index;
+	gint64 now = g_get_monotonic_time ();
+	guint newest = 0;
+	guint i;
+
+	if (all_indexes == NULL)
+		return;
+
+	for (i = 0; i < all_indexes->len; i++)
+	{
+		index = g_ptr_array_index (all_indexes, i);
+		newest = MAX (newest, index->last_use);
+	}
+
+	for (i = 0; i < all_indexes->len; i++)
+	{
+		index = g_ptr_array_index (all_indexes, i);
+
+		/* Never the one in use, even if it has been focused long ago */
+		if (newest != 0 && index->last_use == newest)
+			continue;
+
+		if (now - index->last_use_time >= (gint64) seconds * G_USEC_PER_SEC)
+			gsc_words_index_freeze (index);
+	}
+}
+
+gsize
+gsc_words_index_trim (gsize max_size)
+{
+	GscWordsIndex *index;
+	GscWordsIndex *victim;
+	gsize size = 0;
+	guint newest = 0;
+	guint i;
+
+	if (all_indexes == NULL)
+		return 0;
+
+	for (i = 0; i < all_indexes->len; i++)
+	{
+		index = g_ptr_array_index (all_indexes, i);
+		size += gsc_words_index_get_size (index);
+		newest = MAX (newest, index->last_use);
+	}
+
+	while (size > max_size)
+	{
+		/* The least recently used index, never the one in use */
+		victim = NULL;
+		for (i = 0; i < all_indexes->len; i++)
+		{
+			index = g_ptr_array_index (all_indexes, i);
+
+			if (index->evicted ||
+			    (newest != 0 && index->last_use == newest))
+				continue;
+
+			if (victim == NULL || index->last_use < victim->last_use)
+				victim = index;
+		}
+
+		if (victim == NULL)
+			break;
+
+		size -= gsc_words_index_get_size (victim);
+		gsc_words_index_evict (victim);
+	}
+
+	return size;
+}
+
+guint
+gsc_words_index_get_all_stamp (void)
+{
+	return all_stamp;
+}
+
+void
+gsc_words_index_add_project_word (const gchar *word,
+				  gsize len,
+				  gint delta)
+{
+	g_return_if_fail (word != NULL && len > 0);
+
+	if (project_table == NULL)
+	{
+		if (delta <= 0)
+			return;
+
+		project_table = words_table_new (TRUE);
+	}
+
+	/* The stamp is changed once for many words by
+	   gsc_words_index_project_changed */
+	words_table_add_word (project_table, word, len, delta);
+}
+
+void
+gsc_words_index_project_changed (void)
+{
+	all_stamp++;
+}
+
+void
+gsc_words_index_clear_project (void)
+{
+	if (project_table == NULL)
+		return;
+
+	words_table_free (project_table);
+	project_table = NULL;
+	all_stamp++;
+}
+
+gsize
+gsc_words_index_get_project_size (void)
+{
+	if (project_table == NULL)
+		return 0;
+
+	return words_table_get_size (project_table);
+}
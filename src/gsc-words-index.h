@@ -0,0 +1,281 @@
+/*
+ *  gsc-words-index.h - Per-buffer index of the document words
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __WORDS_INDEX_H__
+#define __WORDS_INDEX_H__
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GscWordsIndex GscWordsIndex;
+
+/**
+ * GscWordsIndexFunc:
+ * @word: The indexed word
+ * @n_chars: Length of @word in characters, computed when it was indexed
+ * @count: Number of occurrences of @word
+ * @user_data: The user data
+ *
+ * Returns: %FALSE to stop the iteration
+ */
+typedef gboolean (*GscWordsIndexFunc) (const gchar *word,
+				       guint n_chars,
+				       guint count,
+				       gpointer user_data);
+
+/**
+ * gsc_words_index_pool_new:
+ * @max_threads: Maximum number of scanning threads, 0 to use one per CPU
+ *
+ * Creates a thread pool to scan the big buffers out of the main loop. A
+ * big buffer is split in chunks scanned in parallel by all the threads.
+ * The caller owns the pool and must keep it alive while there are indexes
+ * using it.
+ *
+ * Returns: A new #GThreadPool
+ */
+GThreadPool	*gsc_words_index_pool_new	(gint max_threads);
+
+/**
+ * gsc_words_index_get_for_buffer:
+ * @buffer: The #GtkTextBuffer to index
+ * @pool: A pool from gsc_words_index_pool_new or %NULL to scan in the
+ * main loop
+ *
+ * Returns the words index of @buffer. The first call scans the whole buffer
+ * and attaches the index to it; from then on the index lives as long as the
+ * buffer and is kept up to date from the insert-text and delete-range
+ * signals, re-scanning only the words touched by every edit.
+ *
+ * The big buffers are copied in low priority idle slices and scanned by
+ * @pool (or in idle slices too without a pool). Until the scan finishes
+ * the index serves the last complete table (or no words at all the first
+ * time).
+ *
+ * Returns: The index owned by @buffer. Do not free it.
+ */
+GscWordsIndex	*gsc_words_index_get_for_buffer	(GtkTextBuffer *buffer,
+						 GThreadPool *pool);
+
+/**
+ * gsc_words_index_remove:
+ * @buffer: A #GtkTextBuffer
+ *
+ * Drops the index of @buffer, if it has one, and stops following its
+ * edits. The next gsc_words_index_get_for_buffer scans it again.
+ */
+void		 gsc_words_index_remove		(GtkTextBuffer *buffer);
+
+/**
+ * gsc_words_index_remove_all:
+ *
+ * Drops the indexes of all the buffers. Afterwards no index uses the
+ * pools they were given, which can be freed.
+ */
+void		 gsc_words_index_remove_all	(void);
+
+/**
+ * gsc_words_index_warm:
+ * @buffer: The #GtkTextBuffer to index
+ * @pool: A pool from gsc_words_index_pool_new or %NULL to scan in the
+ * main loop
+ * @first: First visible line
+ * @last: Last visible line
+ * @cache_file: File where the words are saved, or %NULL
+ * @mtime: Modification time of the file of the document
+ * @size: Size of the file of the document
+ *
+ * Like gsc_words_index_get_for_buffer but, when it creates the index of a
+ * big buffer, the lines between @first and @last are scanned at once and
+ * served until the scan of the whole buffer finishes. Call it when a
+ * document has been loaded so the first completion does not wait for the
+ * scan.
+ *
+ * With a @cache_file the words saved there for the same @mtime and @size
+ * are served at once, mapped, instead of the visible lines. The scan then
+ * only hashes the text and stops if it is the text the words come from.
+ * Otherwise it saves the words it finds for the next time.
+ *
+ * Returns: The index owned by @buffer. Do not free it.
+ */
+GscWordsIndex	*gsc_words_index_warm		(GtkTextBuffer *buffer,
+						 GThreadPool *pool,
+						 const GtkTextIter *first,
+						 const GtkTextIter *last,
+						 const gchar *cache_file,
+						 guint64 mtime,
+						 guint64 size);
+
+/**
+ * gsc_words_index_foreach_prefix:
+ * @index: The #GscWordsIndex
+ * @prefix: The prefix to look for. "" iterates over all the words.
+ * @func: Called, in strcmp order, with every word starting with @prefix
+ * @user_data: Data passed to @func
+ *
+ * Only the matching words are visited: the cost is a binary search plus
+ * the number of matches.
+ */
+void		 gsc_words_index_foreach_prefix	(GscWordsIndex *index,
+						 const gchar *prefix,
+						 GscWordsIndexFunc func,
+						 gpointer user_data);
+
+/**
+ * gsc_words_index_foreach_prefix_all:
+ * @prefix: The prefix to look for. "" iterates over all the words.
+ * @func: Called, in strcmp order, with every word starting with @prefix
+ * @user_data: Data passed to @func
+ *
+ * Like gsc_words_index_foreach_prefix but over the indexes of all the
+ * buffers alive and the words of the project. A word in several buffers
+ * is visited once, with the sum of its occurrences. The sorted words of
+ * every index are merged, no buffer is scanned again.
+ */
+void		 gsc_words_index_foreach_prefix_all (const gchar *prefix,
+						     GscWordsIndexFunc func,
+						     gpointer user_data);
+
+/**
+ * gsc_words_index_foreach_prefix_all_after:
+ * @prefix: The prefix to look for
+ * @after: A word starting with @prefix or %NULL
+ * @func: Called, in strcmp order, with every word starting with @prefix
+ * @user_data: Data passed to @func
+ *
+ * Like gsc_words_index_foreach_prefix_all but only the words after @after
+ * are visited, so a walk stopped by @func can go on later from the last
+ * word it visited.
+ */
+void		 gsc_words_index_foreach_prefix_all_after (const gchar *prefix,
+							   const gchar *after,
+							   GscWordsIndexFunc func,
+							   gpointer user_data);
+
+/**
+ * gsc_words_index_get_stamp:
+ * @index: The #GscWordsIndex
+ *
+ * The stamp changes every time a scan replaces the words of @index. It
+ * does not change with the incremental updates of the edits.
+ *
+ * Returns: The current stamp
+ */
+guint		 gsc_words_index_get_stamp	(GscWordsIndex *index);
+
+/**
+ * gsc_words_index_get_changes:
+ * @index: The #GscWordsIndex
+ *
+ * Returns: A counter increased by every edit of the buffer
+ */
+guint		 gsc_words_index_get_changes	(GscWordsIndex *index);
+
+/**
+ * gsc_words_index_get_distance:
+ * @index: The #GscWordsIndex
+ * @word: An indexed word
+ * @line: A line of the buffer
+ *
+ * The index keeps the lines of every word, moving them with the edits.
+ *
+ * Returns: The number of lines between @line and the nearest occurrence
+ * of @word, %G_MAXUINT if @word is not in the index
+ */
+guint		 gsc_words_index_get_distance	(GscWordsIndex *index,
+						 const gchar *word,
+						 guint line);
+
+/**
+ * gsc_words_index_get_all_stamp:
+ *
+ * Like gsc_words_index_get_stamp but it also changes when an index is
+ * created or destroyed.
+ *
+ * Returns: The stamp of all the indexes
+ */
+guint		 gsc_words_index_get_all_stamp	(void);
+
+/**
+ * gsc_words_index_touch:
+ * @buffer: A #GtkTextBuffer
+ * @pool: The pool of the index
+ *
+ * Marks the index of @buffer, if it has one, as the most recently used.
+ * An index evicted by gsc_words_index_trim is scanned again and a frozen
+ * one is thawed, unless its words have been loaded from its cache file.
+ */
+void		 gsc_words_index_touch		(GtkTextBuffer *buffer,
+						 GThreadPool *pool);
+
+/**
+ * gsc_words_index_freeze_unused:
+ * @seconds: Time without use
+ *
+ * Compresses the words of the indexes not used for @seconds, except the
+ * most recently used one. A frozen index still gives its words but it is
+ * thawed before an edit or by gsc_words_index_touch.
+ */
+void		 gsc_words_index_freeze_unused	(guint seconds);
+
+/**
+ * gsc_words_index_trim:
+ * @max_size: Bytes all the indexes may use
+ *
+ * Drops the words of the least recently used indexes until all of them
+ * fit in @max_size. The most recently used index is always kept. An
+ * evicted index has no words until gsc_words_index_get_for_buffer is
+ * called for its buffer.
+ *
+ * Returns: The (approximate) bytes used by the indexes
+ */
+gsize		 gsc_words_index_trim		(gsize max_size);
+
+/**
+ * gsc_words_index_add_project_word:
+ * @word: A word, not nul-terminated
+ * @len: Length of @word in bytes
+ * @delta: Occurrences added (> 0) or removed (< 0)
+ *
+ * Counts @word in the files of the project that are not open. The words
+ * of the project are visited by gsc_words_index_foreach_prefix_all along
+ * with the ones of the buffers. The change is only seen by the providers
+ * after gsc_words_index_project_changed.
+ */
+void		 gsc_words_index_add_project_word (const gchar *word,
+						   gsize len,
+						   gint delta);
+
+/* Changes the stamp of all the indexes after some project words changed */
+void		 gsc_words_index_project_changed (void);
+
+/* Forgets all the words of the project */
+void		 gsc_words_index_clear_project	(void);
+
+/**
+ * gsc_words_index_get_project_size:
+ *
+ * Returns: The (approximate) bytes used by the words of the project
+ */
+gsize		 gsc_words_index_get_project_size (void);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,457 @@
+/*
+ *  gsc-words-positions.c - Compact lists of the lines of the words
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gsc-words-positions.h"
+
+/* Shifts logged before the owner should rebuild the lists */
+#define MAX_SHIFTS 64
+
+/* The arena should be rebuilt once it wastes this many bytes (and half of it) */
+#define COMPACT_BYTES (64 * 1024)
+
+typedef struct _LineShift LineShift;
+typedef struct _Breakpoint Breakpoint;
+
+struct _LineShift
+{
+	guint32 after;
+	gint32 delta;
+};
+
+/* The lines after threshold (up to the next breakpoint) move offset lines */
+struct _Breakpoint
+{
+	gint64 threshold;
+	gint64 offset;
+};
+
+struct _GscWordsPositions
+{
+	/* The encoded lists, one after another */
+	GByteArray *data;
+	/* Bytes of data used by old versions of the lists */
+	gsize dead_bytes;
+	/* LineShift. A list stores the number of shifts already applied to
+	   it (its epoch). */
+	GArray *shifts;
+	/* Composition of the shifts done after map_epoch, up to
+	   map_n_shifts */
+	GArray *map;
+	GArray *map_tmp;
+	guint map_epoch;
+	guint map_n_shifts;
+	/* Decoded lines of the list being used */
+	GArray *values;
+};
+
+static void
+decode (GscWordsPositions *positions,
+	GscWordsLines *lines)
+{
+	const guint8 *p = positions->data->data + lines->offset;
+	const guint8 *end = p + lines->len;
+	guint32 line = 0;
+	guint32 delta;
+	guint shift;
+
+	g_array_set_size (positions->values, 0);
+
+	while (p < end)
+	{
+		delta = 0;
+		shift = 0;
+
+		do
+		{
+			delta |= (guint32) (*p & 0x7f) << shift;
+			shift += 7;
+		}
+		while (*p++ & 0x80);
+
+		line += delta;
+		g_array_append_val (positions->values, line);
+	}
+}
+
+static void
+encode (GscWordsPositions *positions,
+	GscWordsLines *lines,
+	const guint32 *values,
+	guint n_values)
+{
+	guint8 buf[5];
+	guint32 prev = 0;
+	guint32 delta;
+	guint len;
+	guint i;
+
+	positions->dead_bytes += lines->len;
+	lines->offset = positions->data->len;
+	lines->epoch = positions->shifts->len;
+
+	for (i = 0; i < n_values; i++)
+	{
+		delta = values[i] - prev;
+		prev = values[i];
+
+		for (len = 0; delta >= 0x80; len++)
+		{
+			buf[len] = (delta & 0x7f) | 0x80;
+			delta >>= 7;
+		}
+		buf[len++] = delta;
+
+		g_byte_array_append (positions->data, buf, len);
+	}
+
+	lines->len = positions->data->len - lines->offset;
+}
+
+static void
+map_add_breakpoint (GArray *map,
+		    gint64 threshold,
+		    gint64 offset)
+{
+	Breakpoint bp;
+
+	/* Adjacent intervals moving the same offset are joined */
+	if (map->len > 0 &&
+	    g_array_index (map, Breakpoint, map->len - 1).offset == offset)
+		return;
+
+	bp.threshold = threshold;
+	bp.offset = offset;
+	g_array_append_val (map, bp);
+}
+
+/*
+ * Composes the map with a shift: the lines that the map moves after
+ * shift->after move shift->delta lines more
+ */
+static void
+map_add_shift (GscWordsPositions *positions,
+	       const LineShift *shift)
+{
+	GArray *map = positions->map;
+	Breakpoint *bp;
+	gint64 hi;
+	gint64 split;
+	guint i;
+
+	g_array_set_size (positions->map_tmp, 0);
+
+	for (i = 0; i < map->len; i++)
+	{
+		bp = &g_array_index (map, Breakpoint, i);
+		hi = i + 1 < map->len ?
+		     g_array_index (map, Breakpoint, i + 1).threshold : G_MAXINT64;
+		split = (gint64) shift->after - bp->offset;
+
+		if (split <= bp->threshold)
+		{
+			map_add_breakpoint (positions->map_tmp,
+					    bp->threshold,
+					    bp->offset + shift->delta);
+		}
+		else if (split >= hi)
+		{
+			map_add_breakpoint (positions->map_tmp,
+					    bp->threshold,
+					    bp->offset);
+		}
+		else
+		{
+			map_add_breakpoint (positions->map_tmp,
+					    bp->threshold,
+					    bp->offset);
+			map_add_breakpoint (positions->map_tmp,
+					    split,
+					    bp->offset + shift->delta);
+		}
+	}
+
+	positions->map = positions->map_tmp;
+	positions->map_tmp = map;
+}
+
+static void
+build_map (GscWordsPositions *positions,
+	   guint epoch)
+{
+	Breakpoint start = { G_MININT64, 0 };
+	guint i;
+
+	if (positions->map_epoch != epoch ||
+	    positions->map_n_shifts > positions->shifts->len)
+	{
+		g_array_set_size (positions->map, 0);
+		g_array_append_val (positions->map, start);
+		positions->map_epoch = epoch;
+		positions->map_n_shifts = epoch;
+	}
+
+	for (i = positions->map_n_shifts; i < positions->shifts->len; i++)
+		map_add_shift (positions, &g_array_index (positions->shifts, LineShift, i));
+
+	positions->map_n_shifts = positions->shifts->len;
+}
+
+/*
+ * Decodes the list into positions->values applying the shifts logged
+ * since it was encoded
+ */
+static void
+load (GscWordsPositions *positions,
+      GscWordsLines *lines)
+{
+	Breakpoint *map;
+	guint32 *values;
+	guint n_map;
+	guint i;
+	guint j = 0;
+
+	decode (positions, lines);
+
+	if (positions->values->len == 0 ||
+	    lines->epoch == positions->shifts->len)
+		return;
+
+	build_map (positions, lines->epoch);
+
+	map = (Breakpoint *) positions->map->data;
+	n_map = positions->map->len;
+	values = (guint32 *) positions->values->data;
+
+	/* Both the lines and the breakpoints are sorted */
+	for (i = 0; i < positions->values->len; i++)
+	{
+		while (j + 1 < n_map && values[i] > map[j + 1].threshold)
+			j++;
+
+		values[i] += map[j].offset;
+	}
+}
+
+/*
+ * Returns the index of the first value greater than or equal to line
+ */
+static guint
+lower_bound (GArray *values,
+	     guint line)
+{
+	guint lo = 0;
+	guint hi = values->len;
+	guint mid;
+
+	while (lo < hi)
+	{
+		mid = (lo + hi) / 2;
+
+		if (g_array_index (values, guint32, mid) < line)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+GscWordsPositions *
+gsc_words_positions_new (void)
+{
+	GscWordsPositions *positions = g_slice_new (GscWordsPositions);
+
+	positions->data = g_byte_array_new ();
+	positions->dead_bytes = 0;
+	positions->shifts = g_array_new (FALSE, FALSE, sizeof (LineShift));
+	positions->map = g_array_new (FALSE, FALSE, sizeof (Breakpoint));
+	positions->map_tmp = g_array_new (FALSE, FALSE, sizeof (Breakpoint));
+	positions->map_epoch = G_MAXUINT;
+	positions->map_n_shifts = 0;
+	positions->values = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	return positions;
+}
+
+void
+gsc_words_positions_free (GscWordsPositions *positions)
+{
+	g_byte_array_free (positions->data, TRUE);
+	g_array_free (positions->shifts, TRUE);
+	g_array_free (positions->map, TRUE);
+	g_array_free (positions->map_tmp, TRUE);
+	g_array_free (positions->values, TRUE);
+	g_slice_free (GscWordsPositions, positions);
+}
+
+gsize
+gsc_words_positions_get_size (GscWordsPositions *positions)
+{
+	return positions->data->len +
+	       positions->shifts->len * sizeof (LineShift) +
+	       positions->map->len * sizeof (Breakpoint);
+}
+
+void
+gsc_words_positions_set (GscWordsPositions *positions,
+			 GscWordsLines *lines,
+			 const guint32 *values,
+			 guint n_values)
+{
+	encode (positions, lines, values, n_values);
+}
+
+void
+gsc_words_positions_add (GscWordsPositions *positions,
+			 GscWordsLines *lines,
+			 guint line)
+{
+	guint32 value = line;
+	guint i;
+
+	load (positions, lines);
+
+	i = lower_bound (positions->values, line);
+	g_array_insert_val (positions->values, i, value);
+
+	encode (positions,
+		lines,
+		(guint32 *) positions->values->data,
+		positions->values->len);
+}
+
+void
+gsc_words_positions_remove (GscWordsPositions *positions,
+			    GscWordsLines *lines,
+			    guint line)
+{
+	guint i;
+
+	load (positions, lines);
+
+	i = lower_bound (positions->values, line);
+	if (i == positions->values->len ||
+	    g_array_index (positions->values, guint32, i) != line)
+		return;
+
+	g_array_remove_index (positions->values, i);
+
+	encode (positions,
+		lines,
+		(guint32 *) positions->values->data,
+		positions->values->len);
+}
+
+void
+gsc_words_positions_clear (GscWordsPositions *positions,
+			   GscWordsLines *lines)
+{
+	positions->dead_bytes += lines->len;
+	lines->len = 0;
+}
+
+const guint32 *
+gsc_words_positions_get (GscWordsPositions *positions,
+			 GscWordsLines *lines,
+			 guint *n_values)
+{
+	if (lines->len == 0)
+	{
+		*n_values = 0;
+		return NULL;
+	}
+
+	load (positions, lines);
+
+	*n_values = positions->values->len;
+	return (const guint32 *) positions->values->data;
+}
+
+guint
+gsc_words_positions_get_distance (GscWordsPositions *positions,
+				  GscWordsLines *lines,
+				  guint line)
+{
+	guint distance = G_MAXUINT;
+	guint32 value;
+	guint i;
+
+	if (lines->len == 0)
+		return G_MAXUINT;
+
+	load (positions, lines);
+
+	i = lower_bound (positions->values, line);
+
+	if (i < positions->values->len)
+		distance = g_array_index (positions->values, guint32, i) - line;
+
+	if (i > 0)
+	{
+		value = g_array_index (positions->values, guint32, i - 1);
+		distance = MIN (distance, line - value);
+	}
+
+	return distance;
+}
+
+void
+gsc_words_positions_shift (GscWordsPositions *positions,
+			   guint after_line,
+			   gint delta)
+{
+	LineShift shift;
+
+	if (delta == 0)
+		return;
+
+	shift.after = after_line;
+	shift.delta = delta;
+	g_array_append_val (positions->shifts, shift);
+}
+
+gboolean
+gsc_words_positions_needs_rebuild (GscWordsPositions *positions)
+{
+	return positions->shifts->len >= MAX_SHIFTS ||
+	       (positions->dead_bytes > COMPACT_BYTES &&
+		positions->dead_bytes > positions->data->len / 2);
+}
+
+void
+gsc_words_positions_move (GscWordsPositions *dest,
+			  GscWordsPositions *src,
+			  GscWordsLines *lines)
+{
+	if (lines->len == 0)
+	{
+		lines->offset = 0;
+		lines->epoch = dest->shifts->len;
+		return;
+	}
+
+	load (src, lines);
+
+	/* The old list is in src, it does not waste dest */
+	lines->len = 0;
+	encode (dest,
+		lines,
+		(guint32 *) src->values->data,
+		src->values->len);
+}
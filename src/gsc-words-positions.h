@@ -0,0 +1,142 @@
+/*
+ *  gsc-words-positions.h - Compact lists of the lines of the words
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __WORDS_POSITIONS_H__
+#define __WORDS_POSITIONS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GscWordsPositions GscWordsPositions;
+typedef struct _GscWordsLines GscWordsLines;
+
+/*
+ * A sorted list of line numbers stored in a #GscWordsPositions. It is
+ * owned by the caller (usually inside a bigger struct) and must be
+ * zero-filled before its first use.
+ */
+struct _GscWordsLines
+{
+	guint32 offset;
+	guint32 len;
+	guint32 epoch;
+};
+
+/**
+ * gsc_words_positions_new:
+ *
+ * Creates an arena of line lists. Every list is stored delta-encoded as
+ * varints. The line shifts done by the edits are logged and applied to
+ * a list only when it is used.
+ *
+ * Returns: A new #GscWordsPositions
+ */
+GscWordsPositions *gsc_words_positions_new	(void);
+
+void		 gsc_words_positions_free	(GscWordsPositions *positions);
+
+/* Bytes used by the lists and the shift log */
+gsize		 gsc_words_positions_get_size	(GscWordsPositions *positions);
+
+/**
+ * gsc_words_positions_set:
+ * @positions: The #GscWordsPositions
+ * @lines: An empty list
+ * @values: The lines, in ascending order
+ * @n_values: Number of lines
+ */
+void		 gsc_words_positions_set	(GscWordsPositions *positions,
+						 GscWordsLines *lines,
+						 const guint32 *values,
+						 guint n_values);
+
+void		 gsc_words_positions_add	(GscWordsPositions *positions,
+						 GscWordsLines *lines,
+						 guint line);
+
+/* Removes one occurrence of line, if any */
+void		 gsc_words_positions_remove	(GscWordsPositions *positions,
+						 GscWordsLines *lines,
+						 guint line);
+
+void		 gsc_words_positions_clear	(GscWordsPositions *positions,
+						 GscWordsLines *lines);
+
+/**
+ * gsc_words_positions_get:
+ * @positions: The #GscWordsPositions
+ * @lines: A list
+ * @n_values: Return location for the number of lines
+ *
+ * Returns: The lines of @lines in ascending order, valid until the next
+ * call on @positions
+ */
+const guint32	*gsc_words_positions_get	(GscWordsPositions *positions,
+						 GscWordsLines *lines,
+						 guint *n_values);
+
+/**
+ * gsc_words_positions_get_distance:
+ * @positions: The #GscWordsPositions
+ * @lines: A list
+ * @line: A line
+ *
+ * Returns: The distance in lines from @line to the nearest line of
+ * @lines, %G_MAXUINT if @lines is empty
+ */
+guint		 gsc_words_positions_get_distance (GscWordsPositions *positions,
+						   GscWordsLines *lines,
+						   guint line);
+
+/**
+ * gsc_words_positions_shift:
+ * @positions: The #GscWordsPositions
+ * @after_line: Last line not moved
+ * @delta: Lines added (> 0) or removed (< 0) after @after_line
+ *
+ * Moves the lines after @after_line of every list. When lines are
+ * removed the lists must not contain any of them any more.
+ */
+void		 gsc_words_positions_shift	(GscWordsPositions *positions,
+						 guint after_line,
+						 gint delta);
+
+/**
+ * gsc_words_positions_needs_rebuild:
+ * @positions: The #GscWordsPositions
+ *
+ * Returns: %TRUE when the shift log is long or most of the arena is
+ * wasted. The owner should then move all its lists to a new arena with
+ * gsc_words_positions_move.
+ */
+gboolean	 gsc_words_positions_needs_rebuild (GscWordsPositions *positions);
+
+/**
+ * gsc_words_positions_move:
+ * @dest: The new #GscWordsPositions
+ * @src: The old #GscWordsPositions
+ * @lines: A list of @src. It is updated to point to @dest.
+ */
+void		 gsc_words_positions_move	(GscWordsPositions *dest,
+						 GscWordsPositions *src,
+						 GscWordsLines *lines);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,555 @@
+/*
+ *  gsc-words-project.c - Indexes the words of the files of a project
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "gsc-words-project.h"
+#include "gsc-words-index.h"
+#include "gsc-words-tokenizer.h"
+#include "gsc-project-crawler.h"
+
+/* Bigger files are not read, they are seldom written by hand */
+#define MAX_FILE_SIZE (1024 * 1024)
+
+/* A nul byte in the beginning of a file tells it is not text */
+#define BINARY_CHECK_SIZE 4096
+
+/* Milliseconds between two looks at the files read by the threads */
+#define DRAIN_INTERVAL 20
+
+/* Milliseconds the main loop may spend on them every time */
+#define DRAIN_BUDGET 8
+
+typedef struct _FileWords FileWords;
+typedef struct _ReadJob ReadJob;
+typedef struct _WordCounter WordCounter;
+
+/*
+ * The words counted in a file, kept to take them out of the index when
+ * the file changes
+ */
+struct _FileWords
+{
+	/* Serial of the last read, the results of the older ones are
+	   discarded */
+	guint serial;
+	/* The words, nul-terminated, one after another. NULL until the
+	   file has been read. */
+	gchar *words;
+	gsize words_len;
+	guint32 *counts;
+	guint n_words;
+};
+
+/* A file read by the pool, with the words found */
+struct _ReadJob
+{
+	gchar *path;
+	guint serial;
+	gchar *words;
+	gsize words_len;
+	guint32 *counts;
+	guint n_words;
+};
+
+struct _WordCounter
+{
+	/* Word -> count. The words are freed by hand: inserting an
+	   existing key would free it. */
+	GHashTable *counts;
+	/* The current word, nul-terminated */
+	GString *key;
+};
+
+struct _GscWordsProject
+{
+	GscProjectCrawler *crawler;
+	GThreadPool *pool;
+	/* ReadJob read by the pool */
+	GAsyncQueue *results;
+	/* Set when the project is freed, the jobs left are not run */
+	gint cancelled;
+	/* Jobs whose result has not been applied yet */
+	guint n_jobs;
+	guint drain_id;
+	/* Path -> FileWords */
+	GHashTable *files;
+	/* Path -> documents open on it. Their words are in the indexes of
+	   the buffers. */
+	GHashTable *open_files;
+	guint serial;
+	/* The crawler may be shared with a bigger limit */
+	guint max_files;
+	gsize max_size;
+	/* Bytes of the FileWords */
+	gsize files_size;
+};
+
+static void
+read_job_free (ReadJob *job)
+{
+	g_free (job->path);
+	g_free (job->words);
+	g_free (job->counts);
+	g_slice_free (ReadJob, job);
+}
+
+/*
+ * Bytes of a file in the project, without its words
+ */
+static gsize
+file_words_get_size (const gchar *path)
+{
+	return sizeof (FileWords) + strlen (path) + 1;
+}
+
+static void
+file_words_free (FileWords *file)
+{
+	g_free (file->words);
+	g_free (file->counts);
+	g_slice_free (FileWords, file);
+}
+
+/*
+ * Takes the words of the file out of the index
+ */
+static void
+file_words_clear (GscWordsProject *project,
+		  FileWords *file)
+{
+	const gchar *word = file->words;
+	gsize len;
+	guint i;
+
+	for (i = 0; i < file->n_words; i++)
+	{
+		len = strlen (word);
+		gsc_words_index_add_project_word (word, len, -(gint) file->counts[i]);
+		word += len + 1;
+	}
+
+	project->files_size -= file->words_len + file->n_words * sizeof (guint32);
+
+	g_free (file->words);
+	g_free (file->counts);
+	file->words = NULL;
+	file->words_len = 0;
+	file->counts = NULL;
+	file->n_words = 0;
+}
+
+static gsize
+get_size (GscWordsProject *project)
+{
+	return gsc_words_index_get_project_size () + project->files_size;
+}
+
+/* Runs in the pool */
+static void
+count_word (const gchar *word,
+	    gsize len,
+	    WordCounter *counter)
+{
+	gpointer key;
+	gpointer count;
+
+	g_string_truncate (counter->key, 0);
+	g_string_append_len (counter->key, word, len);
+
+	if (g_hash_table_lookup_extended (counter->counts,
+					  counter->key->str,
+					  &key,
+					  &count))
+	{
+		g_hash_table_insert (counter->counts,
+				     key,
+				     GUINT_TO_POINTER (GPOINTER_TO_UINT (count) + 1));
+	}
+	else
+	{
+		g_hash_table_insert (counter->counts,
+				     g_strndup (word, len),
+				     GUINT_TO_POINTER (1));
+	}
+}
+
+/*
+ * Counts the words of a mapped file, if it is UTF-8 text
+ */
+static void
+read_job_count (ReadJob *job,
+		const gchar *text,
+		gsize len)
+{
+	WordCounter counter;
+	GHashTableIter iter;
+	GString *words;
+	gpointer key;
+	gpointer count;
+	guint i = 0;
+
+	if (len == 0 || len > MAX_FILE_SIZE ||
+	    memchr (text, '\0', MIN (len, BINARY_CHECK_SIZE)) != NULL ||
+	    !g_utf8_validate (text, len, NULL))
+		return;
+
+	counter.counts = g_hash_table_new (g_str_hash, g_str_equal);
+	counter.key = g_string_new (NULL);
+
+	gsc_words_tokenize (text, len, (GscWordsTokenFunc) count_word, &counter);
+
+	job->n_words = g_hash_table_size (counter.counts);
+	job->counts = g_new (guint32, MAX (job->n_words, 1));
+	words = g_string_new (NULL);
+
+	g_hash_table_iter_init (&iter, counter.counts);
+	while (g_hash_table_iter_next (&iter, &key, &count))
+	{
+		g_string_append_len (words, key, strlen (key) + 1);
+		job->counts[i++] = GPOINTER_TO_UINT (count);
+		g_free (key);
+	}
+
+	job->words_len = words->len;
+	job->words = g_string_free (words, FALSE);
+
+	g_string_free (counter.key, TRUE);
+	g_hash_table_destroy (counter.counts);
+}
+
+/* Runs in the pool */
+static void
+read_job_run (ReadJob *job,
+	      GscWordsProject *project)
+{
+	GMappedFile *file;
+
+	if (g_atomic_int_get (&project->cancelled))
+	{
+		read_job_free (job);
+		return;
+	}
+
+	/* The file is paged in as it is tokenized, it is never copied */
+	file = g_mapped_file_new (job->path, FALSE, NULL);
+	if (file != NULL)
+	{
+		read_job_count (job,
+				g_mapped_file_get_contents (file),
+				g_mapped_file_get_length (file));
+		g_mapped_file_unref (file);
+	}
+
+	g_async_queue_push (project->results, job);
+}
+
+static void
+remove_file (GscWordsProject *project,
+	     const gchar *path)
+{
+	FileWords *file = g_hash_table_lookup (project->files, path);
+
+	if (file == NULL)
+		return;
+
+	file_words_clear (project, file);
+	project->files_size -= file_words_get_size (path);
+	g_hash_table_remove (project->files, path);
+}
+
+/*
+ * Replaces the words of the file with the ones read, unless the file
+ * has been removed or read again since the job was queued
+ */
+static void
+apply_job (GscWordsProject *project,
+	   ReadJob *job)
+{
+	FileWords *file;
+	const gchar *word;
+	gsize len;
+	guint i;
+
+	file = g_hash_table_lookup (project->files, job->path);
+	if (file == NULL || file->serial != job->serial)
+		return;
+
+	file_words_clear (project, file);
+
+	if (get_size (project) + job->words_len > project->max_size)
+	{
+		/* Read again if it is written once there is room */
+		remove_file (project, job->path);
+		return;
+	}
+
+	word = job->words;
+	for (i = 0; i < job->n_words; i++)
+	{
+		len = strlen (word);
+		gsc_words_index_add_project_word (word, len, job->counts[i]);
+		word += len + 1;
+	}
+
+	file->words = job->words;
+	file->words_len = job->words_len;
+	file->counts = job->counts;
+	file->n_words = job->n_words;
+	project->files_size += file->words_len + file->n_words * sizeof (guint32);
+
+	job->words = NULL;
+	job->counts = NULL;
+}
+
+static gboolean
+drain_cb (GscWordsProject *project)
+{
+	gint64 end = g_get_monotonic_time () + DRAIN_BUDGET * 1000;
+	ReadJob *job;
+	gboolean changed = FALSE;
+
+	while (g_get_monotonic_time () < end &&
+	       (job = g_async_queue_try_pop (project->results)) != NULL)
+	{
+		apply_job (project, job);
+		read_job_free (job);
+		project->n_jobs--;
+		changed = TRUE;
+	}
+
+	/* The providers look for the words again once per slice */
+	if (changed)
+		gsc_words_index_project_changed ();
+
+	if (project->n_jobs > 0)
+		return TRUE;
+
+	project->drain_id = 0;
+	return FALSE;
+}
+
+static void
+read_file (GscWordsProject *project,
+	   const gchar *path)
+{
+	FileWords *file;
+	ReadJob *job;
+
+	file = g_hash_table_lookup (project->files, path);
+	if (file == NULL)
+	{
+		/* The files already read are kept up to date, no new ones
+		   are read once the budget is spent */
+		if (get_size (project) >= project->max_size ||
+		    g_hash_table_size (project->files) >= project->max_files)
+			return;
+
+		file = g_slice_new0 (FileWords);
+		g_hash_table_insert (project->files, g_strdup (path), file);
+		project->files_size += file_words_get_size (path);
+	}
+
+	file->serial = ++project->serial;
+
+	/* Read when it is closed */
+	if (g_hash_table_lookup (project->open_files, path) != NULL)
+		return;
+
+	job = g_slice_new0 (ReadJob);
+	job->path = g_strdup (path);
+	job->serial = file->serial;
+
+	project->n_jobs++;
+	g_thread_pool_push (project->pool, job, NULL);
+
+	if (project->drain_id == 0)
+	{
+		project->drain_id = g_timeout_add (DRAIN_INTERVAL,
+						   (GSourceFunc) drain_cb,
+						   project);
+	}
+}
+
+static void
+remove_dir (GscWordsProject *project,
+	    const gchar *dir)
+{
+	GHashTableIter iter;
+	const gchar *path;
+	FileWords *file;
+	gsize len = strlen (dir);
+
+	g_hash_table_iter_init (&iter, project->files);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &path, (gpointer *) &file))
+	{
+		if (strncmp (path, dir, len) != 0 || path[len] != G_DIR_SEPARATOR)
+			continue;
+
+		file_words_clear (project, file);
+		project->files_size -= file_words_get_size (path);
+		g_hash_table_iter_remove (&iter);
+	}
+}
+
+static void
+project_changed_cb (GscProjectCrawlerEvent event,
+		    const gchar *path,
+		    GscWordsProject *project)
+{
+	switch (event)
+	{
+		case GSC_PROJECT_CRAWLER_FILE_ADDED:
+		case GSC_PROJECT_CRAWLER_FILE_CHANGED:
+			read_file (project, path);
+			break;
+		case GSC_PROJECT_CRAWLER_FILE_REMOVED:
+			remove_file (project, path);
+			gsc_words_index_project_changed ();
+			break;
+		case GSC_PROJECT_CRAWLER_DIR_REMOVED:
+			remove_dir (project, path);
+			gsc_words_index_project_changed ();
+			break;
+	}
+}
+
+GscWordsProject *
+gsc_words_project_new (const gchar *root,
+		       guint max_files,
+		       guint max_threads,
+		       gsize max_size)
+{
+	GscWordsProject *project;
+
+	g_return_val_if_fail (root != NULL, NULL);
+
+	project = g_slice_new0 (GscWordsProject);
+	project->max_files = max_files;
+	project->max_size = max_size;
+	project->results = g_async_queue_new ();
+	project->files = g_hash_table_new_full (g_str_hash,
+						g_str_equal,
+						g_free,
+						(GDestroyNotify) file_words_free);
+	project->open_files = g_hash_table_new_full (g_str_hash,
+						     g_str_equal,
+						     g_free,
+						     NULL);
+	project->pool = g_thread_pool_new ((GFunc) read_job_run,
+					   project,
+					   MAX (max_threads, 1),
+					   FALSE,
+					   NULL);
+
+	/* The words of the previous project are not proposed any more */
+	gsc_words_index_clear_project ();
+
+	/* The crawler may already list the project for the quick open */
+	project->crawler = gsc_project_crawler_get_for_root (root, max_files);
+	gsc_project_crawler_add_func (project->crawler,
+				      (GscProjectCrawlerFunc) project_changed_cb,
+				      project);
+
+	return project;
+}
+
+void
+gsc_words_project_free (GscWordsProject *project)
+{
+	ReadJob *job;
+
+	gsc_project_crawler_remove_func (project->crawler,
+					 (GscProjectCrawlerFunc) project_changed_cb,
+					 project);
+	gsc_project_crawler_unref (project->crawler);
+
+	/* The queued jobs return at once */
+	g_atomic_int_set (&project->cancelled, TRUE);
+	g_thread_pool_free (project->pool, FALSE, TRUE);
+
+	while ((job = g_async_queue_try_pop (project->results)) != NULL)
+		read_job_free (job);
+
+	if (project->drain_id != 0)
+		g_source_remove (project->drain_id);
+
+	gsc_words_index_clear_project ();
+
+	g_async_queue_unref (project->results);
+	g_hash_table_destroy (project->files);
+	g_hash_table_destroy (project->open_files);
+	g_slice_free (GscWordsProject, project);
+}
+
+const gchar *
+gsc_words_project_get_root (GscWordsProject *project)
+{
+	return gsc_project_crawler_get_root (project->crawler);
+}
+
+void
+gsc_words_project_open_file (GscWordsProject *project,
+			     const gchar *path)
+{
+	FileWords *file;
+	guint count;
+
+	g_return_if_fail (project != NULL && path != NULL);
+
+	count = GPOINTER_TO_UINT (g_hash_table_lookup (project->open_files, path));
+	g_hash_table_replace (project->open_files,
+			      g_strdup (path),
+			      GUINT_TO_POINTER (count + 1));
+
+	file = g_hash_table_lookup (project->files, path);
+	if (count > 0 || file == NULL)
+		return;
+
+	/* The file may be being read */
+	file->serial = ++project->serial;
+	file_words_clear (project, file);
+	gsc_words_index_project_changed ();
+}
+
+void
+gsc_words_project_close_file (GscWordsProject *project,
+			      const gchar *path)
+{
+	guint count;
+
+	g_return_if_fail (project != NULL && path != NULL);
+
+	count = GPOINTER_TO_UINT (g_hash_table_lookup (project->open_files, path));
+	if (count == 0)
+		return;
+
+	if (count > 1)
+	{
+		g_hash_table_replace (project->open_files,
+				      g_strdup (path),
+				      GUINT_TO_POINTER (count - 1));
+		return;
+	}
+
+	g_hash_table_remove (project->open_files, path);
+
+	/* It may have been saved with other words */
+	if (g_hash_table_lookup (project->files, path) != NULL)
+		read_file (project, path);
+}
@@ -0,0 +1,76 @@
+/*
+ *  gsc-words-project.h - Indexes the words of the files of a project
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __WORDS_PROJECT_H__
+#define __WORDS_PROJECT_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GscWordsProject GscWordsProject;
+
+/**
+ * gsc_words_project_new:
+ * @root: The project directory
+ * @max_files: Files read at most
+ * @max_threads: Threads reading the files
+ * @max_size: Bytes the words of the project may use
+ *
+ * Lists the files under @root with the #GscProjectCrawler of @root,
+ * shared with the quick open, and reads their words in a thread pool. The
+ * words are counted with gsc_words_index_add_project_word, so every
+ * #GscProviderWords proposes them. The files are read again when they are
+ * written and their words are forgotten when they are deleted. No more
+ * files are read while the words use @max_size.
+ *
+ * The files open in gedit are not read: their words are in the indexes
+ * of their buffers. See gsc_words_project_open_file.
+ *
+ * Only one project is indexed at a time.
+ *
+ * Returns: A new #GscWordsProject
+ */
+GscWordsProject	*gsc_words_project_new		(const gchar *root,
+						 guint max_files,
+						 guint max_threads,
+						 gsize max_size);
+
+/* Stops reading the files and forgets the words of the project */
+void		 gsc_words_project_free		(GscWordsProject *project);
+
+const gchar	*gsc_words_project_get_root	(GscWordsProject *project);
+
+/**
+ * gsc_words_project_open_file:
+ * @project: The #GscWordsProject
+ * @path: A file open in a document
+ *
+ * Forgets the words of @path until gsc_words_project_close_file is called
+ * as many times, then reads the file again. @path may be out of the
+ * project.
+ */
+void		 gsc_words_project_open_file	(GscWordsProject *project,
+						 const gchar *path);
+
+void		 gsc_words_project_close_file	(GscWordsProject *project,
+						 const gchar *path);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ *  gsc-words-selector.c - Keeps the best completion candidates
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "gsc-words-selector.h"
+
+struct _GscWordsSelector
+{
+	GscWordsCandidateCompareFunc compare;
+	guint max_size;
+	guint size;
+	/* Max-heap: the worst kept candidate is the first one */
+	GscWordsCandidate *heap;
+};
+
+static void
+sift_up (GscWordsSelector *selector,
+	 guint i)
+{
+	GscWordsCandidate *heap = selector->heap;
+	GscWordsCandidate tmp = heap[i];
+	guint parent;
+
+	while (i > 0)
+	{
+		parent = (i - 1) / 2;
+		if (selector->compare (&heap[parent], &tmp) >= 0)
+			break;
+
+		heap[i] = heap[parent];
+		i = parent;
+	}
+
+	heap[i] = tmp;
+}
+
+static void
+sift_down (GscWordsSelector *selector,
+	   guint i)
+{
+	GscWordsCandidate *heap = selector->heap;
+	GscWordsCandidate tmp = heap[i];
+	guint child;
+
+	while ((child = 2 * i + 1) < selector->size)
+	{
+		if (child + 1 < selector->size &&
+		    selector->compare (&heap[child + 1], &heap[child]) > 0)
+			child++;
+
+		if (selector->compare (&heap[child], &tmp) <= 0)
+			break;
+
+		heap[i] = heap[child];
+		i = child;
+	}
+
+	heap[i] = tmp;
+}
+
+GscWordsSelector *
+gsc_words_selector_new (guint max_size,
+			GscWordsCandidateCompareFunc compare)
+{
+	GscWordsSelector *selector = g_slice_new (GscWordsSelector);
+
+	selector->compare = compare;
+	selector->max_size = max_size;
+	selector->size = 0;
+	selector->heap = g_new (GscWordsCandidate, max_size);
+
+	return selector;
+}
+
+void
+gsc_words_selector_free (GscWordsSelector *selector)
+{
+	guint i;
+
+	for (i = 0; i < selector->size; i++)
+		g_free ((gchar *) selector->heap[i].word);
+
+	g_free (selector->heap);
+	g_slice_free (GscWordsSelector, selector);
+}
+
+gboolean
+gsc_words_selector_add (GscWordsSelector *selector,
+			const gchar *word,
+			guint n_chars,
+			guint count,
+			guint distance)
+{
+	GscWordsCandidate candidate;
+
+	candidate.word = word;
+	candidate.n_chars = n_chars;
+	candidate.count = count;
+	candidate.distance = distance;
+
+	if (selector->size < selector->max_size)
+	{
+		candidate.word = g_strdup (word);
+		selector->heap[selector->size] = candidate;
+		sift_up (selector, selector->size++);
+		return TRUE;
+	}
+
+	if (selector->max_size == 0 ||
+	    selector->compare (&candidate, &selector->heap[0]) >= 0)
+		return FALSE;
+
+	/* The words given by the indexes do not outlive the walk */
+	g_free ((gchar *) selector->heap[0].word);
+	candidate.word = g_strdup (word);
+	selector->heap[0] = candidate;
+	sift_down (selector, 0);
+
+	return TRUE;
+}
+
+gboolean
+gsc_words_selector_is_full (GscWordsSelector *selector)
+{
+	return selector->size == selector->max_size;
+}
+
+const GscWordsCandidate *
+gsc_words_selector_finish (GscWordsSelector *selector,
+			   guint *n_candidates)
+{
+	qsort (selector->heap,
+	       selector->size,
+	       sizeof (GscWordsCandidate),
+	       (gint (*) (const void *, const void *)) selector->compare);
+
+	*n_candidates = selector->size;
+
+	return selector->heap;
+}
+
+gint
+gsc_words_candidate_compare_length (const GscWordsCandidate *a,
+				    const GscWordsCandidate *b)
+{
+	if (a->n_chars != b->n_chars)
+		return a->n_chars < b->n_chars ? -1 : 1;
+
+	return strcmp (a->word, b->word);
+}
+
+gint
+gsc_words_candidate_compare_count (const GscWordsCandidate *a,
+				   const GscWordsCandidate *b)
+{
+	if (a->count != b->count)
+		return a->count > b->count ? -1 : 1;
+
+	return gsc_words_candidate_compare_length (a, b);
+}
+
+gint
+gsc_words_candidate_compare_distance (const GscWordsCandidate *a,
+				      const GscWordsCandidate *b)
+{
+	if (a->distance != b->distance)
+		return a->distance < b->distance ? -1 : 1;
+
+	return gsc_words_candidate_compare_count (a, b);
+}
+
+gint
+gsc_words_candidate_compare_word (const GscWordsCandidate *a,
+				  const GscWordsCandidate *b)
+{
+	return strcmp (a->word, b->word);
+}
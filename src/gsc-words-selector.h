@@ -0,0 +1,114 @@
+/*
+ *  gsc-words-selector.h - Keeps the best completion candidates
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __WORDS_SELECTOR_H__
+#define __WORDS_SELECTOR_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GscWordsSelector GscWordsSelector;
+typedef struct _GscWordsCandidate GscWordsCandidate;
+
+struct _GscWordsCandidate
+{
+	const gchar *word;
+	guint n_chars;
+	guint count;
+	guint distance;
+};
+
+/**
+ * GscWordsCandidateCompareFunc:
+ * @a: A #GscWordsCandidate
+ * @b: A #GscWordsCandidate
+ *
+ * Returns: A negative value if @a is better than @b, a positive one if it
+ * is worse. It must only return 0 for the same word so the selection
+ * does not depend on the order the words are added.
+ */
+typedef gint (*GscWordsCandidateCompareFunc) (const GscWordsCandidate *a,
+					      const GscWordsCandidate *b);
+
+/**
+ * gsc_words_selector_new:
+ * @max_size: Number of candidates kept
+ * @compare: Orders the candidates, best first
+ *
+ * Creates a selector keeping the @max_size best candidates in a bounded
+ * heap: adding n candidates costs O(n log @max_size).
+ *
+ * Returns: A new #GscWordsSelector
+ */
+GscWordsSelector *gsc_words_selector_new	(guint max_size,
+						 GscWordsCandidateCompareFunc compare);
+
+void		 gsc_words_selector_free	(GscWordsSelector *selector);
+
+/**
+ * gsc_words_selector_add:
+ * @selector: The #GscWordsSelector
+ * @word: The word. It is copied if it is kept, so it only has to be
+ * valid during the call.
+ * @n_chars: Length of @word in characters
+ * @count: Number of occurrences of @word
+ * @distance: Lines from the cursor to the nearest occurrence of @word
+ *
+ * Returns: %TRUE if the word is one of the best ones so far
+ */
+gboolean	 gsc_words_selector_add		(GscWordsSelector *selector,
+						 const gchar *word,
+						 guint n_chars,
+						 guint count,
+						 guint distance);
+
+gboolean	 gsc_words_selector_is_full	(GscWordsSelector *selector);
+
+/**
+ * gsc_words_selector_finish:
+ * @selector: The #GscWordsSelector
+ * @n_candidates: Return location for the number of candidates
+ *
+ * Sorts the kept candidates, best first. No more words may be added.
+ *
+ * Returns: The candidates, owned by @selector. Their words are freed
+ * with @selector.
+ */
+const GscWordsCandidate *gsc_words_selector_finish (GscWordsSelector *selector,
+						   guint *n_candidates);
+
+/* Shortest words first, then in strcmp order */
+gint		 gsc_words_candidate_compare_length	(const GscWordsCandidate *a,
+							 const GscWordsCandidate *b);
+
+/* Most used words first, then shortest first, then in strcmp order */
+gint		 gsc_words_candidate_compare_count	(const GscWordsCandidate *a,
+							 const GscWordsCandidate *b);
+
+/* Nearest words first, then as gsc_words_candidate_compare_count */
+gint		 gsc_words_candidate_compare_distance	(const GscWordsCandidate *a,
+							 const GscWordsCandidate *b);
+
+/* strcmp order */
+gint		 gsc_words_candidate_compare_word	(const GscWordsCandidate *a,
+							 const GscWordsCandidate *b);
+
+G_END_DECLS
+
+#endif
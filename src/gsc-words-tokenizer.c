@@ -0,0 +1,301 @@
+/*
+ *  gsc-words-tokenizer.c - Splits raw UTF-8 text into words
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gsc-words-tokenizer.h"
+#include <gtksourcecompletion/gsc-utils.h>
+
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+typedef struct _TokenizerState TokenizerState;
+
+struct _TokenizerState
+{
+	const guchar *word_start;
+	GscWordsTokenFunc func;
+	gpointer user_data;
+};
+
+/*
+ * Classifies a block of bytes. Returns a bitmask with the ASCII word chars
+ * and sets in high the bytes >= 0x80 (non-ASCII).
+ */
+typedef guint32 (*ClassifyFunc) (const guchar *p, guint32 *high);
+
+/* gsc_utils_is_separator for every ASCII char */
+static gboolean ascii_separator[128];
+
+/* Kernel selected at run time and the size of the blocks it reads */
+static ClassifyFunc classify_block = NULL;
+static guint block_size = 0;
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ * ASCII word chars are [0-9A-Za-z_]. Or-ing 0x20 folds the upper case
+ * letters into the lower case ones without moving any other char into
+ * [a-z]. Bytes >= 0x80 are negative so they never match the signed
+ * compares.
+ */
+__attribute__ ((target ("sse2")))
+static guint32
+classify_sse2 (const guchar *p, guint32 *high)
+{
+	__m128i v = _mm_loadu_si128 ((const __m128i *) p);
+	__m128i lower = _mm_or_si128 (v, _mm_set1_epi8 (0x20));
+	__m128i digit = _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 ('0' - 1)),
+				       _mm_cmplt_epi8 (v, _mm_set1_epi8 ('9' + 1)));
+	__m128i alpha = _mm_and_si128 (_mm_cmpgt_epi8 (lower, _mm_set1_epi8 ('a' - 1)),
+				       _mm_cmplt_epi8 (lower, _mm_set1_epi8 ('z' + 1)));
+	__m128i under = _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('_'));
+
+	*high = (guint32) _mm_movemask_epi8 (v);
+	return (guint32) _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128 (digit, alpha),
+							 under));
+}
+
+__attribute__ ((target ("avx2")))
+static guint32
+classify_avx2 (const guchar *p, guint32 *high)
+{
+	__m256i v = _mm256_loadu_si256 ((const __m256i *) p);
+	__m256i lower = _mm256_or_si256 (v, _mm256_set1_epi8 (0x20));
+	__m256i digit = _mm256_andnot_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8 ('9')),
+					     _mm256_cmpgt_epi8 (v, _mm256_set1_epi8 ('0' - 1)));
+	__m256i alpha = _mm256_andnot_si256 (_mm256_cmpgt_epi8 (lower, _mm256_set1_epi8 ('z')),
+					     _mm256_cmpgt_epi8 (lower, _mm256_set1_epi8 ('a' - 1)));
+	__m256i under = _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('_'));
+
+	*high = (guint32) _mm256_movemask_epi8 (v);
+	return (guint32) _mm256_movemask_epi8 (_mm256_or_si256 (_mm256_or_si256 (digit, alpha),
+							       under));
+}
+
+#endif
+
+/*
+ * The kernels hardcode the ASCII word chars, so they are only used if
+ * gsc_utils_is_separator agrees with them.
+ */
+static gboolean
+kernels_match_table (void)
+{
+	guint ch;
+	gboolean word;
+
+	for (ch = 0; ch < 128; ch++)
+	{
+		word = (ch >= '0' && ch <= '9') ||
+		       (ch >= 'a' && ch <= 'z') ||
+		       (ch >= 'A' && ch <= 'Z') ||
+		       ch == '_';
+
+		if (word == ascii_separator[ch])
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+select_kernel (void)
+{
+	if (!kernels_match_table ())
+		return;
+
+#ifdef HAVE_X86_KERNELS
+	__builtin_cpu_init ();
+
+	if (__builtin_cpu_supports ("avx2"))
+	{
+		classify_block = classify_avx2;
+		block_size = 32;
+	}
+	else if (__builtin_cpu_supports ("sse2"))
+	{
+		classify_block = classify_sse2;
+		block_size = 16;
+	}
+#endif
+}
+
+static void
+init_tables (void)
+{
+	static gsize initialized = 0;
+	gunichar ch;
+
+	if (g_once_init_enter (&initialized))
+	{
+		for (ch = 0; ch < 128; ch++)
+			ascii_separator[ch] = gsc_utils_is_separator (ch);
+
+		select_kernel ();
+
+		g_once_init_leave (&initialized, 1);
+	}
+}
+
+static inline gboolean
+is_separator_at (const guchar *p)
+{
+	if (*p < 128)
+		return ascii_separator[*p];
+
+	/* Non ASCII, use the slow path */
+	return gsc_utils_is_separator (g_utf8_get_char ((const gchar *) p));
+}
+
+/*
+ * Classifies the char at p, updates the state and returns the next char
+ */
+static inline const guchar *
+scalar_step (const guchar *p,
+	     TokenizerState *state)
+{
+	if (is_separator_at (p))
+	{
+		if (state->word_start != NULL)
+		{
+			state->func ((const gchar *) state->word_start,
+				     p - state->word_start,
+				     state->user_data);
+			state->word_start = NULL;
+		}
+	}
+	else if (state->word_start == NULL)
+	{
+		state->word_start = p;
+	}
+
+	if (*p < 128)
+		return p + 1;
+
+	return (const guchar *) g_utf8_next_char (p);
+}
+
+/*
+ * Walks the word boundaries of the first n bytes of a classified block. A
+ * boundary is a byte whose class differs from the previous one.
+ */
+static inline void
+emit_boundaries (const guchar *p,
+		 guint32 word_mask,
+		 guint n,
+		 TokenizerState *state)
+{
+	guint32 valid = n >= 32 ? 0xffffffff : (1u << n) - 1;
+	guint32 prev = state->word_start != NULL ? 1 : 0;
+	guint32 boundaries;
+	guint pos;
+
+	word_mask &= valid;
+	boundaries = (word_mask ^ ((word_mask << 1) | prev)) & valid;
+
+	while (boundaries != 0)
+	{
+		pos = __builtin_ctz (boundaries);
+
+		if (state->word_start != NULL)
+		{
+			state->func ((const gchar *) state->word_start,
+				     p + pos - state->word_start,
+				     state->user_data);
+			state->word_start = NULL;
+		}
+		else
+		{
+			state->word_start = p + pos;
+		}
+
+		boundaries &= boundaries - 1;
+	}
+}
+
+void
+gsc_words_tokenize (const gchar *text,
+		    gsize len,
+		    GscWordsTokenFunc func,
+		    gpointer user_data)
+{
+	const guchar *p = (const guchar *) text;
+	const guchar *end = p + len;
+	TokenizerState state;
+	guint32 word_mask;
+	guint32 high;
+	guint ascii;
+
+	init_tables ();
+
+	state.word_start = NULL;
+	state.func = func;
+	state.user_data = user_data;
+
+	if (classify_block != NULL)
+	{
+		while ((gsize) (end - p) >= block_size)
+		{
+			word_mask = classify_block (p, &high);
+
+			if (high == 0)
+			{
+				emit_boundaries (p, word_mask, block_size, &state);
+				p += block_size;
+				continue;
+			}
+
+			/* ASCII head of the block, then the non-ASCII run
+			   goes through the Unicode slow path */
+			ascii = __builtin_ctz (high);
+			emit_boundaries (p, word_mask, ascii, &state);
+			p += ascii;
+
+			while (p < end && *p >= 128)
+				p = scalar_step (p, &state);
+		}
+	}
+
+	while (p < end)
+		p = scalar_step (p, &state);
+
+	if (state.word_start != NULL)
+	{
+		func ((const gchar *) state.word_start,
+		      end - state.word_start,
+		      user_data);
+	}
+}
+
+gsize
+gsc_words_tokenizer_next_boundary (const gchar *text,
+				   gsize len,
+				   gsize pos)
+{
+	const guchar *p = (const guchar *) text;
+
+	init_tables ();
+
+	while (pos < len && (p[pos] >= 128 || !ascii_separator[p[pos]]))
+		pos++;
+
+	return pos;
+}
@@ -0,0 +1,71 @@
+/*
+ *  gsc-words-tokenizer.h - Splits raw UTF-8 text into words
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __WORDS_TOKENIZER_H__
+#define __WORDS_TOKENIZER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GscWordsTokenFunc:
+ * @word: Start of the word inside the tokenized text. It is not
+ * nul-terminated.
+ * @len: Length of @word in bytes
+ * @user_data: The user data
+ */
+typedef void (*GscWordsTokenFunc) (const gchar *word,
+				   gsize len,
+				   gpointer user_data);
+
+/**
+ * gsc_words_tokenize:
+ * @text: Valid UTF-8 text
+ * @len: Length of @text in bytes
+ * @func: Called for every word found in @text
+ * @user_data: Data passed to @func
+ *
+ * Splits @text in place using the same word boundaries as
+ * gsc_utils_is_separator. Nothing is copied: @func receives pointers into
+ * @text.
+ */
+void		gsc_words_tokenize		(const gchar *text,
+						 gsize len,
+						 GscWordsTokenFunc func,
+						 gpointer user_data);
+
+/**
+ * gsc_words_tokenizer_next_boundary:
+ * @text: Valid UTF-8 text
+ * @len: Length of @text in bytes
+ * @pos: Offset where the search starts
+ *
+ * Looks for a place to split @text without cutting a word or a multibyte
+ * char.
+ *
+ * Returns: The offset of the first ASCII separator at or after @pos, or
+ * @len if there is none.
+ */
+gsize		gsc_words_tokenizer_next_boundary (const gchar *text,
+						   gsize len,
+						   gsize pos);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ *  test-path-index.c - Tests of the index of the paths
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include "gsc-path-index.h"
+
+#define N_PATHS 3000
+
+/*
+ * Most of the paths are removed, so the index is compacted, and the
+ * queries only find the paths left
+ */
+static void
+test_path_index_compact (void)
+{
+	GscPathIndex *index = gsc_path_index_new ();
+	GscPathMatch matches[10];
+	gchar path[64];
+	guint n_matches;
+	guint i;
+
+	for (i = 0; i < N_PATHS; i++)
+	{
+		g_snprintf (path, sizeof (path), "/project/src/name%04u.c", i);
+		gsc_path_index_add (index, path, GSC_PATH_SOURCE_PROJECT);
+	}
+
+	/* An open file stays when the project is forgotten */
+	gsc_path_index_add (index, "/project/src/name0001.c", GSC_PATH_SOURCE_OPEN);
+
+	for (i = 0; i < N_PATHS; i++)
+	{
+		if (i % 3 == 0)
+			continue;
+
+		g_snprintf (path, sizeof (path), "/project/src/name%04u.c", i);
+		gsc_path_index_remove (index, path, GSC_PATH_SOURCE_PROJECT);
+	}
+
+	g_assert_cmpuint (gsc_path_index_get_n_paths (index), ==, N_PATHS / 3 + 1);
+
+	n_matches = gsc_path_index_query (index, "name0003", matches, G_N_ELEMENTS (matches));
+	g_assert_cmpuint (n_matches, ==, 1);
+	g_assert_cmpstr (matches[0].path, ==, "/project/src/name0003.c");
+	g_assert_cmpuint (matches[0].sources, ==, GSC_PATH_SOURCE_PROJECT);
+
+	n_matches = gsc_path_index_query (index, "name0002", matches, G_N_ELEMENTS (matches));
+	g_assert_cmpuint (n_matches, ==, 0);
+
+	n_matches = gsc_path_index_query (index, "name0001", matches, G_N_ELEMENTS (matches));
+	g_assert_cmpuint (n_matches, ==, 1);
+	g_assert_cmpuint (matches[0].sources, ==, GSC_PATH_SOURCE_OPEN);
+
+	/* A removed path can be added again */
+	gsc_path_index_add (index, "/project/src/name0002.c", GSC_PATH_SOURCE_RECENT);
+	n_matches = gsc_path_index_query (index, "name0002", matches, G_N_ELEMENTS (matches));
+	g_assert_cmpuint (n_matches, ==, 1);
+	g_assert_cmpstr (matches[0].path, ==, "/project/src/name0002.c");
+
+	gsc_path_index_remove_dir (index, "/project", GSC_PATH_SOURCE_PROJECT);
+	g_assert_cmpuint (gsc_path_index_get_n_paths (index), ==, 2);
+
+	gsc_path_index_free (index);
+}
+
+/*
+ * Only the file name and its directory are indexed: a query naming an
+ * upper directory is matched by its last two components, then by the
+ * whole path
+ */
+static void
+test_path_index_upper_dirs (void)
+{
+	GscPathIndex *index = gsc_path_index_new ();
+	GscPathMatch matches[10];
+	guint n_matches;
+
+	gsc_path_index_add (index, "/home/user/gedit/src/gedit-window.c", GSC_PATH_SOURCE_PROJECT);
+	gsc_path_index_add (index, "/home/user/plugin/src/gedit-window.c", GSC_PATH_SOURCE_PROJECT);
+	gsc_path_index_add (index, "/home/user/gedit/src/gedit-view.c", GSC_PATH_SOURCE_PROJECT);
+
+	n_matches = gsc_path_index_query (index, "gedit/src/gedit-window", matches, G_N_ELEMENTS (matches));
+	g_assert_cmpuint (n_matches, ==, 1);
+	g_assert_cmpstr (matches[0].path, ==, "/home/user/gedit/src/gedit-window.c");
+
+	n_matches = gsc_path_index_query (index, "user/plugin/src/", matches, G_N_ELEMENTS (matches));
+	g_assert_cmpuint (n_matches, ==, 1);
+	g_assert_cmpstr (matches[0].path, ==, "/home/user/plugin/src/gedit-window.c");
+
+	n_matches = gsc_path_index_query (index, "src/gedit-window", matches, G_N_ELEMENTS (matches));
+	g_assert_cmpuint (n_matches, ==, 2);
+
+	gsc_path_index_free (index);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/path-index/compact", test_path_index_compact);
+	g_test_add_func ("/path-index/upper-dirs", test_path_index_upper_dirs);
+
+	return g_test_run ();
+}
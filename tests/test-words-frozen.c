@@ -0,0 +1,166 @@
+/*
+ *  test-words-frozen.c - Tests of the compressed words
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "gsc-words-frozen.h"
+
+/* Words of the tests, more than one block */
+#define N_FROZEN_WORDS 1000
+
+static GscWordsFrozen *
+new_frozen (void)
+{
+	GscWordsFrozen *frozen = gsc_words_frozen_new ();
+	guint32 lines[2];
+	gchar word[16];
+	guint i;
+
+	for (i = 0; i < N_FROZEN_WORDS; i++)
+	{
+		g_snprintf (word, sizeof (word), "word%04u", i);
+		lines[0] = i;
+		lines[1] = i + 1000;
+		gsc_words_frozen_append (frozen, word, i + 1, lines, 2);
+	}
+
+	gsc_words_frozen_append (frozen, "zeta", 1, NULL, 0);
+	gsc_words_frozen_finish (frozen);
+
+	return frozen;
+}
+
+/*
+ * Checks the words starting with "word01", which begin inside a block
+ */
+static void
+check_prefix (GscWordsFrozen *frozen)
+{
+	GscWordsFrozenIter iter;
+	GArray *values = g_array_new (FALSE, FALSE, sizeof (guint32));
+	gchar word[16];
+	guint i = 100;
+
+	g_assert (gsc_words_frozen_may_have_prefix (frozen, "word01"));
+	g_assert (!gsc_words_frozen_may_have_prefix (frozen, "alpha"));
+
+	g_assert (gsc_words_frozen_iter_init (&iter, frozen, "word01"));
+	do
+	{
+		if (!g_str_has_prefix (iter.word->str, "word01"))
+			break;
+
+		g_snprintf (word, sizeof (word), "word%04u", i);
+		g_assert_cmpstr (iter.word->str, ==, word);
+		g_assert_cmpuint (iter.count, ==, i + 1);
+
+		gsc_words_frozen_iter_get_lines (&iter, values);
+		g_assert_cmpuint (values->len, ==, 2);
+		g_assert_cmpuint (g_array_index (values, guint32, 0), ==, i);
+		g_assert_cmpuint (g_array_index (values, guint32, 1), ==, i + 1000);
+
+		i++;
+	}
+	while (gsc_words_frozen_iter_next (&iter));
+	gsc_words_frozen_iter_clear (&iter);
+
+	g_assert_cmpuint (i, ==, 200);
+
+	g_assert (gsc_words_frozen_iter_init (&iter, frozen, "word9"));
+	g_assert_cmpstr (iter.word->str, ==, "zeta");
+	g_assert (!gsc_words_frozen_iter_next (&iter));
+	gsc_words_frozen_iter_clear (&iter);
+
+	g_assert (!gsc_words_frozen_iter_init (&iter, frozen, "zz"));
+	gsc_words_frozen_iter_clear (&iter);
+
+	g_array_free (values, TRUE);
+}
+
+static void
+test_frozen_prefix (void)
+{
+	GscWordsFrozen *frozen = new_frozen ();
+
+	check_prefix (frozen);
+	gsc_words_frozen_free (frozen);
+}
+
+static void
+test_frozen_saved (void)
+{
+	GscWordsFrozen *frozen = new_frozen ();
+	GscWordsFrozenSource source;
+	GscWordsFrozenSource mapped_source;
+	GError *error = NULL;
+	gchar *filename;
+	gchar *contents;
+	gsize len;
+	gint fd;
+
+	memset (&source, 0, sizeof (source));
+	source.mtime = 1234;
+	source.size = 5678;
+	g_strlcpy (source.digest, "0123456789abcdef", sizeof (source.digest));
+
+	fd = g_file_open_tmp ("test-words-frozen-XXXXXX", &filename, &error);
+	g_assert_no_error (error);
+	close (fd);
+
+	g_assert (gsc_words_frozen_save (frozen, filename, &source, &error));
+	g_assert_no_error (error);
+	gsc_words_frozen_free (frozen);
+
+	frozen = gsc_words_frozen_map (filename, &mapped_source, &error);
+	g_assert_no_error (error);
+	g_assert (frozen != NULL);
+	g_assert_cmpuint (mapped_source.mtime, ==, source.mtime);
+	g_assert_cmpuint (mapped_source.size, ==, source.size);
+	g_assert_cmpstr (mapped_source.digest, ==, source.digest);
+	check_prefix (frozen);
+	gsc_words_frozen_free (frozen);
+
+	/* A flipped byte in the words does not match the checksum */
+	g_assert (g_file_get_contents (filename, &contents, &len, NULL));
+	contents[len - 10] ^= 0x01;
+	g_assert (g_file_set_contents (filename, contents, len, NULL));
+	g_free (contents);
+
+	frozen = gsc_words_frozen_map (filename, &mapped_source, &error);
+	g_assert (frozen == NULL);
+	g_assert (error != NULL);
+	g_clear_error (&error);
+
+	g_unlink (filename);
+	g_free (filename);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/frozen/prefix", test_frozen_prefix);
+	g_test_add_func ("/frozen/saved", test_frozen_saved);
+
+	return g_test_run ();
+}
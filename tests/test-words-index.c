@@ -0,0 +1,483 @@
+/*
+ *  test-words-index.c - Tests of the words index of the buffers
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <gtk/gtk.h>
+#include <gtksourcecompletion/gsc-utils.h>
+#include "gsc-words-index.h"
+
+/* Random edits of a buffer */
+#define N_EDITS 300
+
+/* Chars of the buffers scanned out of the main loop, more than
+   SYNC_SCAN_CHARS */
+#define BIG_CHARS (200 * 1024)
+
+/* Time given to a scan to finish */
+#define SCAN_TIMEOUT (30 * G_USEC_PER_SEC)
+
+static const gchar *words[] = {
+	"alpha", "beta", "gamma", "delta_2", "x", "x1", "_tmp", "déjà",
+	"中文", "naïve", "CamelCase", "snake_case_word"
+};
+
+static const gchar *separators[] = {
+	" ", " ", " ", "\n", "\n", "\t", ".", "(", ");\n", " = ", "\n\n", "\xc2\xa0"
+};
+
+static void
+append_random_text (GString *text,
+		    guint n_chars)
+{
+	const gchar *word;
+	const gchar *separator;
+	guint added = 0;
+
+	while (added < n_chars)
+	{
+		word = words[g_test_rand_int_range (0, G_N_ELEMENTS (words))];
+		separator = separators[g_test_rand_int_range (0, G_N_ELEMENTS (separators))];
+
+		g_string_append (text, word);
+		g_string_append (text, separator);
+		added += g_utf8_strlen (word, -1) + g_utf8_strlen (separator, -1);
+	}
+}
+
+static gchar *
+random_text (guint n_chars)
+{
+	GString *text = g_string_new (NULL);
+
+	append_random_text (text, n_chars);
+
+	return g_string_free (text, FALSE);
+}
+
+static gboolean
+add_word (const gchar *word,
+	  guint n_chars,
+	  guint count,
+	  GString *result)
+{
+	g_assert_cmpuint (n_chars, ==, g_utf8_strlen (word, -1));
+
+	g_string_append_printf (result, "%s %u\n", word, count);
+
+	return TRUE;
+}
+
+/*
+ * The words of the index with their counts, one per line in strcmp order
+ */
+static gchar *
+get_words (GscWordsIndex *index)
+{
+	GString *result = g_string_new (NULL);
+
+	gsc_words_index_foreach_prefix (index,
+					"",
+					(GscWordsIndexFunc) add_word,
+					result);
+
+	return g_string_free (result, FALSE);
+}
+
+static gchar *
+get_text (GtkTextBuffer *buffer)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+
+	gtk_text_buffer_get_bounds (buffer, &start, &end);
+
+	return gtk_text_iter_get_slice (&start, &end);
+}
+
+static void
+free_lines (GArray *lines)
+{
+	g_array_free (lines, TRUE);
+}
+
+/*
+ * Full scan of the text of the buffer: every word with the lines of its
+ * occurrences
+ */
+static GHashTable *
+scan_buffer (GtkTextBuffer *buffer)
+{
+	GHashTable *words;
+	GArray *lines;
+	gchar *text = get_text (buffer);
+	gchar *word;
+	const gchar *p = text;
+	const gchar *start = NULL;
+	guint line = 0;
+
+	words = g_hash_table_new_full (g_str_hash,
+				       g_str_equal,
+				       g_free,
+				       (GDestroyNotify) free_lines);
+
+	for (;; p = g_utf8_next_char (p))
+	{
+		if (*p != '\0' && !gsc_utils_is_separator (g_utf8_get_char (p)))
+		{
+			if (start == NULL)
+				start = p;
+			continue;
+		}
+
+		if (start != NULL)
+		{
+			word = g_strndup (start, p - start);
+			lines = g_hash_table_lookup (words, word);
+			if (lines == NULL)
+			{
+				lines = g_array_new (FALSE, FALSE, sizeof (guint));
+				g_hash_table_insert (words, word, lines);
+			}
+			else
+			{
+				g_free (word);
+			}
+
+			g_array_append_val (lines, line);
+			start = NULL;
+		}
+
+		if (*p == '\0')
+			break;
+		if (*p == '\n')
+			line++;
+	}
+
+	g_free (text);
+
+	return words;
+}
+
+static gint
+compare_words (gconstpointer a,
+	       gconstpointer b)
+{
+	return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+/*
+ * The words of a full scan of the buffer, formatted like get_words
+ */
+static gchar *
+get_scanned_words (GtkTextBuffer *buffer)
+{
+	GHashTable *words = scan_buffer (buffer);
+	GPtrArray *sorted = g_ptr_array_new ();
+	GString *result = g_string_new (NULL);
+	GHashTableIter iter;
+	gpointer word;
+	GArray *lines;
+	guint i;
+
+	g_hash_table_iter_init (&iter, words);
+	while (g_hash_table_iter_next (&iter, &word, NULL))
+		g_ptr_array_add (sorted, word);
+
+	g_ptr_array_sort (sorted, compare_words);
+
+	for (i = 0; i < sorted->len; i++)
+	{
+		lines = g_hash_table_lookup (words, g_ptr_array_index (sorted, i));
+		g_string_append_printf (result,
+					"%s %u\n",
+					(const gchar *) g_ptr_array_index (sorted, i),
+					lines->len);
+	}
+
+	g_ptr_array_free (sorted, TRUE);
+	g_hash_table_destroy (words);
+
+	return g_string_free (result, FALSE);
+}
+
+/*
+ * Compares the words of the index of buffer with a full scan of its text
+ */
+static void
+check_words (GtkTextBuffer *buffer,
+	     GscWordsIndex *index)
+{
+	gchar *expected = get_scanned_words (buffer);
+	gchar *result = get_words (index);
+
+	g_assert_cmpstr (result, ==, expected);
+
+	g_free (expected);
+	g_free (result);
+}
+
+/*
+ * Runs the main loop until the scans of the index have finished and its
+ * words are the ones of a full scan
+ */
+static void
+wait_words (GtkTextBuffer *buffer,
+	    GscWordsIndex *index)
+{
+	gint64 end_time = g_get_monotonic_time () + SCAN_TIMEOUT;
+	gchar *expected = get_scanned_words (buffer);
+	gchar *result = get_words (index);
+
+	while (strcmp (result, expected) != 0 &&
+	       g_get_monotonic_time () < end_time)
+	{
+		if (!g_main_context_iteration (NULL, FALSE))
+			g_usleep (1000);
+
+		g_free (result);
+		result = get_words (index);
+	}
+
+	g_assert_cmpstr (result, ==, expected);
+
+	g_free (expected);
+	g_free (result);
+}
+
+/*
+ * Inserts a random text or deletes a random range. The edits split and
+ * join words and add and remove lines.
+ */
+static void
+random_edit (GtkTextBuffer *buffer,
+	     guint max_chars)
+{
+	GtkTextIter start;
+	GtkTextIter end;
+	GString *text;
+	gint n_chars = gtk_text_buffer_get_char_count (buffer);
+	gint offset = g_test_rand_int_range (0, n_chars + 1);
+
+	gtk_text_buffer_get_iter_at_offset (buffer, &start, offset);
+
+	if (n_chars == 0 || g_test_rand_bit ())
+	{
+		text = g_string_new (NULL);
+		if (g_test_rand_bit ())
+			g_string_append_c (text, "abz_9 \n."[g_test_rand_int_range (0, 8)]);
+		else
+			append_random_text (text, g_test_rand_int_range (1, max_chars));
+
+		gtk_text_buffer_insert (buffer, &start, text->str, text->len);
+		g_string_free (text, TRUE);
+	}
+	else
+	{
+		gtk_text_buffer_get_iter_at_offset (buffer,
+						    &end,
+						    offset + g_test_rand_int_range (1, max_chars));
+		gtk_text_buffer_delete (buffer, &start, &end);
+	}
+}
+
+/*
+ * Every edit only scans the words it touches: the index must stay equal
+ * to a full scan
+ */
+static void
+test_edits (void)
+{
+	GtkTextBuffer *buffer = gtk_text_buffer_new (NULL);
+	GscWordsIndex *index;
+	gchar *text = random_text (2000);
+	guint i;
+
+	gtk_text_buffer_set_text (buffer, text, -1);
+	g_free (text);
+
+	index = gsc_words_index_get_for_buffer (buffer, NULL);
+	check_words (buffer, index);
+
+	for (i = 0; i < N_EDITS; i++)
+	{
+		random_edit (buffer, 40);
+		check_words (buffer, index);
+	}
+
+	/* Emptied and filled again */
+	gtk_text_buffer_set_text (buffer, "", -1);
+	check_words (buffer, index);
+	gtk_text_buffer_set_text (buffer, "one two\nthree one", -1);
+	check_words (buffer, index);
+
+	g_object_unref (buffer);
+}
+
+/*
+ * A big buffer is copied in idle slices and scanned in the pool. The edits
+ * done while it is copied or scanned are replayed on the result.
+ */
+static void
+test_edits_while_scanning (void)
+{
+	GThreadPool *pool = gsc_words_index_pool_new (2);
+	GtkTextBuffer *buffer = gtk_text_buffer_new (NULL);
+	GscWordsIndex *index;
+	GtkTextIter iter;
+	GtkTextIter end;
+	gchar *text = random_text (BIG_CHARS);
+	gchar *result;
+	guint i;
+
+	gtk_text_buffer_set_text (buffer, text, -1);
+	g_free (text);
+
+	/* Nothing is served until the first scan finishes */
+	index = gsc_words_index_get_for_buffer (buffer, pool);
+	result = get_words (index);
+	g_assert_cmpstr (result, ==, "");
+	g_free (result);
+
+	/* While the buffer is copied: the rest is copied before the edit */
+	random_edit (buffer, 40);
+	g_main_context_iteration (NULL, FALSE);
+	random_edit (buffer, 40);
+
+	/* While the copy is scanned in the pool */
+	for (i = 0; i < 50; i++)
+		random_edit (buffer, 40);
+
+	wait_words (buffer, index);
+
+	/* Small edits are applied in the main loop */
+	for (i = 0; i < 50; i++)
+	{
+		random_edit (buffer, 40);
+		check_words (buffer, index);
+	}
+
+	/* A big insertion is scanned again in the pool, with edits while
+	   it is scanned */
+	text = random_text (BIG_CHARS / 2);
+	gtk_text_buffer_get_iter_at_offset (buffer, &iter, 1000);
+	gtk_text_buffer_insert (buffer, &iter, text, -1);
+	g_free (text);
+
+	for (i = 0; i < 20; i++)
+		random_edit (buffer, 40);
+
+	wait_words (buffer, index);
+
+	/* And a big deletion */
+	gtk_text_buffer_get_iter_at_offset (buffer, &iter, 10);
+	gtk_text_buffer_get_iter_at_offset (buffer, &end, 10 + BIG_CHARS / 2);
+	gtk_text_buffer_delete (buffer, &iter, &end);
+
+	for (i = 0; i < 20; i++)
+		random_edit (buffer, 40);
+
+	wait_words (buffer, index);
+
+	g_object_unref (buffer);
+
+	/* The running jobs finish before the pool is freed */
+	g_thread_pool_free (pool, FALSE, TRUE);
+	while (g_main_context_iteration (NULL, FALSE))
+		;
+}
+
+/*
+ * The nearest line of the word in the full scan
+ */
+static guint
+get_scanned_distance (GHashTable *words,
+		      const gchar *word,
+		      guint line)
+{
+	GArray *lines = g_hash_table_lookup (words, word);
+	guint distance = G_MAXUINT;
+	guint word_line;
+	guint i;
+
+	if (lines == NULL)
+		return G_MAXUINT;
+
+	for (i = 0; i < lines->len; i++)
+	{
+		word_line = g_array_index (lines, guint, i);
+		distance = MIN (distance, word_line > line ? word_line - line : line - word_line);
+	}
+
+	return distance;
+}
+
+/*
+ * The lines of the words are moved by the edits: the distances must be
+ * the ones of a full scan
+ */
+static void
+test_lines (void)
+{
+	GtkTextBuffer *buffer = gtk_text_buffer_new (NULL);
+	GscWordsIndex *index;
+	GHashTable *scanned;
+	gchar *text = random_text (3000);
+	gint n_lines;
+	guint line;
+	guint i;
+	guint j;
+
+	gtk_text_buffer_set_text (buffer, text, -1);
+	g_free (text);
+
+	index = gsc_words_index_get_for_buffer (buffer, NULL);
+
+	for (i = 0; i < N_EDITS; i++)
+	{
+		random_edit (buffer, 60);
+
+		scanned = scan_buffer (buffer);
+		n_lines = gtk_text_buffer_get_line_count (buffer);
+
+		for (j = 0; j < G_N_ELEMENTS (words); j++)
+		{
+			line = g_test_rand_int_range (0, n_lines + 1);
+			g_assert_cmpuint (gsc_words_index_get_distance (index, words[j], line),
+					  ==,
+					  get_scanned_distance (scanned, words[j], line));
+		}
+
+		g_hash_table_destroy (scanned);
+	}
+
+	g_object_unref (buffer);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/words-index/edits", test_edits);
+	g_test_add_func ("/words-index/edits-while-scanning", test_edits_while_scanning);
+	g_test_add_func ("/words-index/lines", test_lines);
+
+	return g_test_run ();
+}
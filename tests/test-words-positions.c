@@ -0,0 +1,189 @@
+/*
+ *  test-words-positions.c - Tests of the lines of the words
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include "gsc-words-positions.h"
+
+/* Lists moved by the shifts */
+#define N_LISTS 8
+
+/* Random edits applied to them */
+#define N_EDITS 500
+
+static void
+test_positions_varints (void)
+{
+	static const guint32 values[] = {
+		0, 1, 127, 128, 300, 16383, 16384, 2097151, 2097152,
+		268435455, 268435456, G_MAXUINT32 - 1, G_MAXUINT32
+	};
+	GscWordsPositions *positions = gsc_words_positions_new ();
+	GscWordsLines lines = { 0, 0, 0 };
+	const guint32 *result;
+	guint n_values;
+	guint i;
+
+	gsc_words_positions_set (positions, &lines, values, G_N_ELEMENTS (values));
+	result = gsc_words_positions_get (positions, &lines, &n_values);
+
+	g_assert_cmpuint (n_values, ==, G_N_ELEMENTS (values));
+	for (i = 0; i < n_values; i++)
+		g_assert_cmpuint (result[i], ==, values[i]);
+
+	g_assert_cmpuint (gsc_words_positions_get_distance (positions, &lines, 200), ==, 72);
+
+	gsc_words_positions_free (positions);
+}
+
+/*
+ * Removes the lines of the model in (after, after + n]
+ */
+static void
+remove_range (GscWordsPositions *positions,
+	      GscWordsLines *lines,
+	      GArray *model,
+	      guint after,
+	      guint n)
+{
+	guint32 value;
+	guint i = 0;
+
+	while (i < model->len)
+	{
+		value = g_array_index (model, guint32, i);
+		if (value > after && value <= after + n)
+		{
+			gsc_words_positions_remove (positions, lines, value);
+			g_array_remove_index (model, i);
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+static void
+check_list (GscWordsPositions *positions,
+	    GscWordsLines *lines,
+	    GArray *model)
+{
+	const guint32 *values;
+	guint n_values;
+	guint i;
+
+	values = gsc_words_positions_get (positions, lines, &n_values);
+
+	g_assert_cmpuint (n_values, ==, model->len);
+	for (i = 0; i < n_values; i++)
+		g_assert_cmpuint (values[i], ==, g_array_index (model, guint32, i));
+}
+
+/*
+ * The shifts are composed lazily: every list is compared with a model
+ * shifted at once
+ */
+static void
+test_positions_shifts (void)
+{
+	GscWordsPositions *positions = gsc_words_positions_new ();
+	GscWordsPositions *rebuilt;
+	GscWordsLines lines[N_LISTS];
+	GArray *models[N_LISTS];
+	guint32 value;
+	guint after;
+	gint delta;
+	guint i;
+	guint j;
+	guint k;
+
+	memset (lines, 0, sizeof (lines));
+
+	for (i = 0; i < N_LISTS; i++)
+	{
+		models[i] = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+		for (value = g_test_rand_int_range (0, 10);
+		     value < 5000;
+		     value += g_test_rand_int_range (1, 200))
+			g_array_append_val (models[i], value);
+
+		gsc_words_positions_set (positions,
+					 &lines[i],
+					 (guint32 *) models[i]->data,
+					 models[i]->len);
+	}
+
+	for (k = 0; k < N_EDITS; k++)
+	{
+		after = g_test_rand_int_range (0, 6000);
+		delta = g_test_rand_int_range (-50, 50);
+
+		if (delta < 0)
+		{
+			for (i = 0; i < N_LISTS; i++)
+				remove_range (positions, &lines[i], models[i], after, -delta);
+		}
+
+		gsc_words_positions_shift (positions, after, delta);
+
+		for (i = 0; i < N_LISTS; i++)
+		{
+			for (j = 0; j < models[i]->len; j++)
+			{
+				if (g_array_index (models[i], guint32, j) > after)
+					g_array_index (models[i], guint32, j) += delta;
+			}
+		}
+
+		/* Some lists are only read after many shifts */
+		i = g_test_rand_int_range (0, N_LISTS);
+		check_list (positions, &lines[i], models[i]);
+
+		if (gsc_words_positions_needs_rebuild (positions))
+		{
+			rebuilt = gsc_words_positions_new ();
+			for (i = 0; i < N_LISTS; i++)
+				gsc_words_positions_move (rebuilt, positions, &lines[i]);
+			gsc_words_positions_free (positions);
+			positions = rebuilt;
+		}
+	}
+
+	for (i = 0; i < N_LISTS; i++)
+	{
+		check_list (positions, &lines[i], models[i]);
+		g_array_free (models[i], TRUE);
+	}
+
+	gsc_words_positions_free (positions);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/positions/varints", test_positions_varints);
+	g_test_add_func ("/positions/shifts", test_positions_shifts);
+
+	return g_test_run ();
+}
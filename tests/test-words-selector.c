@@ -0,0 +1,92 @@
+/*
+ *  test-words-selector.c - Tests of the selection of the best words
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "gsc-words-selector.h"
+
+#define N_CANDIDATES 2000
+#define MAX_SELECTED 10
+
+static gint
+compare_candidates (gconstpointer a,
+		    gconstpointer b)
+{
+	return gsc_words_candidate_compare_count (a, b);
+}
+
+/*
+ * The bounded heap keeps the same words, in the same order, as a sort of
+ * all of them
+ */
+static void
+test_selector_top (void)
+{
+	GscWordsSelector *selector;
+	GscWordsCandidate *all;
+	const GscWordsCandidate *selected;
+	guint n_selected;
+	gchar **words;
+	guint i;
+
+	selector = gsc_words_selector_new (MAX_SELECTED, gsc_words_candidate_compare_count);
+	all = g_new0 (GscWordsCandidate, N_CANDIDATES);
+	words = g_new0 (gchar *, N_CANDIDATES + 1);
+
+	for (i = 0; i < N_CANDIDATES; i++)
+	{
+		words[i] = g_strdup_printf ("w%u", g_test_rand_int_range (0, 1000000) * N_CANDIDATES + i);
+		all[i].word = words[i];
+		all[i].n_chars = strlen (words[i]);
+		all[i].count = g_test_rand_int_range (1, 50);
+
+		gsc_words_selector_add (selector,
+					words[i],
+					all[i].n_chars,
+					all[i].count,
+					0);
+	}
+
+	qsort (all, N_CANDIDATES, sizeof (GscWordsCandidate), compare_candidates);
+
+	selected = gsc_words_selector_finish (selector, &n_selected);
+	g_assert_cmpuint (n_selected, ==, MAX_SELECTED);
+
+	for (i = 0; i < n_selected; i++)
+	{
+		g_assert_cmpstr (selected[i].word, ==, all[i].word);
+		g_assert_cmpuint (selected[i].count, ==, all[i].count);
+	}
+
+	gsc_words_selector_free (selector);
+	g_strfreev (words);
+	g_free (all);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/selector/top", test_selector_top);
+
+	return g_test_run ();
+}
@@ -0,0 +1,159 @@
+/*
+ *  test-words-tokenizer.c - Tests of the tokenizer kernels
+ *
+ *  Copyright (C) 2009 - perriman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+/* The kernels are static, the tokenizer is built in the test to switch
+   between them */
+#include "gsc-words-tokenizer.c"
+
+/* Random texts given to every tokenizer kernel */
+#define N_TEXTS 200
+
+static void
+append_token (const gchar *word,
+	      gsize len,
+	      GString *tokens)
+{
+	g_string_append_len (tokens, word, len);
+	g_string_append_c (tokens, '\n');
+}
+
+static gchar *
+tokenize (const gchar *text,
+	  gsize len)
+{
+	GString *tokens = g_string_new (NULL);
+
+	gsc_words_tokenize (text, len, (GscWordsTokenFunc) append_token, tokens);
+
+	return g_string_free (tokens, FALSE);
+}
+
+/*
+ * ASCII word chars and separators, Latin letters, CJK, symbols and
+ * Unicode spaces
+ */
+static gchar *
+random_text (gsize *len)
+{
+	static const gunichar pool[] = {
+		'a', 'Z', '0', '9', '_', ' ', '\n', '\t', '.', '-', '(', '@',
+		0xe9, 0xf1, 0xdf, 0x3b1, 0x430, 0xa0, 0x2003, 0x3000,
+		0x4e2d, 0x6587, 0x2192, 0x1f600
+	};
+	GString *text = g_string_new (NULL);
+	guint n = g_test_rand_int_range (0, 300);
+	guint i;
+
+	for (i = 0; i < n; i++)
+	{
+		/* Mostly ASCII, as in code */
+		if (g_test_rand_int_range (0, 4) > 0)
+			g_string_append_c (text, g_test_rand_int_range (0x20, 0x7f));
+		else
+			g_string_append_unichar (text, pool[g_test_rand_int_range (0, G_N_ELEMENTS (pool))]);
+	}
+
+	*len = text->len;
+
+	return g_string_free (text, FALSE);
+}
+
+/*
+ * Every kernel finds the same words as the scalar loop
+ */
+static void
+test_tokenizer_kernels (void)
+{
+	ClassifyFunc kernels[3];
+	guint sizes[3];
+	guint n_kernels = 0;
+	gchar *text;
+	gchar *expected;
+	gchar *tokens;
+	gsize len;
+	guint i;
+	guint k;
+
+	init_tables ();
+
+	if (classify_block != NULL)
+	{
+		kernels[n_kernels] = classify_block;
+		sizes[n_kernels++] = block_size;
+	}
+
+#ifdef HAVE_X86_KERNELS
+	if (kernels_match_table ())
+	{
+		if (__builtin_cpu_supports ("sse2"))
+		{
+			kernels[n_kernels] = classify_sse2;
+			sizes[n_kernels++] = 16;
+		}
+		if (__builtin_cpu_supports ("avx2"))
+		{
+			kernels[n_kernels] = classify_avx2;
+			sizes[n_kernels++] = 32;
+		}
+	}
+#endif
+
+	if (n_kernels == 0)
+	{
+		g_test_message ("No tokenizer kernel for this CPU");
+		return;
+	}
+
+	for (i = 0; i < N_TEXTS; i++)
+	{
+		text = random_text (&len);
+
+		classify_block = NULL;
+		block_size = 0;
+		expected = tokenize (text, len);
+
+		for (k = 0; k < n_kernels; k++)
+		{
+			classify_block = kernels[k];
+			block_size = sizes[k];
+			tokens = tokenize (text, len);
+			g_assert_cmpstr (tokens, ==, expected);
+			g_free (tokens);
+		}
+
+		g_free (expected);
+		g_free (text);
+	}
+
+	classify_block = kernels[0];
+	block_size = sizes[0];
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/tokenizer/kernels", test_tokenizer_kernels);
+
+	return g_test_run ();
+}